@@ -1,7 +1,34 @@
 #pragma once
 
+#include "numtypes.hpp"
+
+inline constexpr bool enable_ee_jit_asm_dispatcher = true;
+// Blocks emitted by asmjit's Assembler, not its Compiler; the Compiler in builds that define
+// NANOSTATION_EE_JIT_COMPILER_BACKEND, such as the benchmark of compiling through it
+#ifdef NANOSTATION_EE_JIT_COMPILER_BACKEND
+inline constexpr bool enable_ee_jit_assembler_backend = false;
+#else
+inline constexpr bool enable_ee_jit_assembler_backend = true;
+#endif
+inline constexpr bool enable_ee_jit_block_linking = true;
+inline constexpr bool enable_ee_jit_code_cache_dual_mapping = false; // W^X; writes go through a second view
 inline constexpr bool enable_ee_jit_error_handler = false;
+inline constexpr bool enable_ee_jit_fastmem = true; // guest memory accesses through a host mirror of the address space
+inline constexpr bool enable_ee_jit_idle_loop_skipping = true; // polling loops skip to the next scheduler event
+inline constexpr bool enable_ee_jit_native_loops = true; // branches back to the start of a block stay in the block
+inline constexpr bool enable_ee_jit_out_of_line_exits = true; // slow paths and exception exits past the code of a block
+inline constexpr bool enable_ee_jit_rdram_write_tracking = true;
+inline constexpr bool enable_ee_jit_return_stack = true; // returns jump straight to the block after their call
+inline constexpr bool enable_ee_jit_static_delay_slots = true; // delay slots of branches decided at run time inline
+inline constexpr bool enable_ee_jit_superblocks = true; // blocks go on at the target of forward unconditional jumps
 inline constexpr bool enable_file_logging = false;
 inline constexpr bool log_ee_branches = false;
 inline constexpr bool log_ee_jit_blocks = false;
+inline constexpr bool log_ee_jit_ir = false; // the IR of every block compiled, after the passes
 inline constexpr bool log_ee_jit_register_status = false;
+
+inline constexpr size_t ee_jit_code_cache_size = 64_MiB;
+inline constexpr u32 ee_jit_code_cache_generations = 4; // the oldest is evicted when full; 1 means a full flush
+inline constexpr u32 ee_jit_compile_threshold = 3; // runs in the interpreter before a block is compiled; 0: none
+inline constexpr u32 ee_jit_compile_workers = 1; // threads compiling hot blocks; 0: compile on the EE thread
+inline constexpr u32 ee_jit_max_block_span = 1_KiB; // of guest code, from the start of a block, jumps followed included
@@ -1,42 +1,49 @@
 #pragma once
 
-#include <algorithm>
 #include <cassert>
 #include <type_traits>
 #include <utility>
-#include <vector>
 
+#include "host_memory.hpp"
 #include "log.hpp"
 #include "numtypes.hpp"
 
+// The storage is reserved up front, but only takes up physical memory as objects are acquired from it.
 class BumpAllocator {
-    std::vector<u8> storage_;
+    u8* storage_;
+    size_t size_;
     size_t index_;
     bool out_of_memory_;
 
 public:
     BumpAllocator(size_t size = 0)
       : storage_{},
+        size_{},
         index_{},
         out_of_memory_{}
     {
         allocate(size);
     }
 
+    BumpAllocator(BumpAllocator const&) = delete;
+    BumpAllocator& operator=(BumpAllocator const&) = delete;
+
+    ~BumpAllocator() { deallocate(); }
+
     template<typename T>
     T* acquire()
         requires(std::is_default_constructible_v<T> && std::is_trivially_destructible_v<T>)
     {
-        assert(!storage_.empty());
+        assert(storage_);
         if constexpr (alignof(T) > 1) {
             size_t align_rem = index_ % alignof(T);
             if (align_rem) {
                 index_ += alignof(T) - align_rem;
             }
         }
-        if (index_ + sizeof(T) > storage_.size()) [[unlikely]] {
+        if (index_ + sizeof(T) > size_) [[unlikely]] {
             if (!std::exchange(out_of_memory_, true)) {
-                log_warn("Bump allocator ran out of memory ({} bytes)", storage_.size());
+                log_warn("Bump allocator ran out of memory ({} bytes)", size_);
             }
             return nullptr;
         }
@@ -47,15 +54,20 @@ public:
 
     void allocate(size_t size)
     {
-        storage_.resize(size, 0);
-        index_ = 0;
-        out_of_memory_ = false;
+        deallocate();
+        if (size > 0) {
+            storage_ = static_cast<u8*>(host_memory::allocate(size));
+            size_ = storage_ ? size : 0;
+        }
     }
 
     void deallocate()
     {
-        storage_ = {};
-        index_ = 0;
+        if (storage_) {
+            host_memory::free(storage_, size_);
+        }
+        storage_ = nullptr;
+        size_ = index_ = 0;
         out_of_memory_ = false;
     }
 
@@ -64,9 +76,12 @@ public:
         return out_of_memory_;
     }
 
+    // Only the part of the storage handed out so far needs to be zeroed, which is done by returning it to the OS.
     void reset()
     {
-        std::ranges::fill(storage_, 0);
+        if (index_ > 0) {
+            host_memory::decommit(storage_, index_);
+        }
         index_ = 0;
         out_of_memory_ = false;
     }
@@ -0,0 +1,139 @@
+#include "code_cache.hpp"
+#include "asmjit/core/virtmem.h"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace asmjit;
+
+void* CodeCache::Add(CodeHolder& code)
+{
+    Error err = code.flatten();
+    if (!err) {
+        err = code.resolveUnresolvedLinks();
+    }
+    if (err) {
+        log_error("Failed to prepare code for the code cache; returned {}", DebugUtils::errorAsString(err));
+        return nullptr;
+    }
+    // The size before relocation is an upper bound; entries of the address table may turn out to be unneeded.
+    size_t estimated_size = code.codeSize();
+    if (estimated_size > generation_size_) {
+        log_error("Code of {} bytes does not fit in the code cache", estimated_size);
+        return nullptr;
+    }
+    size_t offset = (generations_[current_generation_].used + 15) & ~size_t(15);
+    if (offset + estimated_size > generation_size_) {
+        current_generation_ = (current_generation_ + 1) % u32(generations_.size());
+        Evict(current_generation_);
+        offset = 0;
+    }
+    Generation& generation = generations_[current_generation_];
+    u8* code_rx = rx_ + current_generation_ * generation_size_ + offset;
+    err = code.relocateToBase(reinterpret_cast<uintptr_t>(code_rx));
+    if (err) {
+        log_error("Failed to relocate code in the code cache; returned {}", DebugUtils::errorAsString(err));
+        return nullptr;
+    }
+    size_t code_size = code.codeSize();
+    {
+        VirtMem::ProtectJitReadWriteScope write_scope(code_rx, code_size);
+        code.copyFlattenedData(Writable(code_rx), code_size, CopySectionFlags::kPadTargetBuffer);
+    }
+    VirtMem::flushInstructionCache(code_rx, code_size);
+    generation.used = offset + code_size;
+    generation.block_count++;
+    return code_rx;
+}
+
+bool CodeCache::Contains(void const* ptr) const
+{
+    return ptr >= rx_ && ptr < rx_ + size_;
+}
+
+void CodeCache::Evict(u32 generation_index)
+{
+    Generation& generation = generations_[generation_index];
+    if (generation.block_count > 0) {
+        u8 const* begin = rx_ + generation_index * generation_size_;
+        on_evict_(begin, begin + generation_size_);
+        flushes_++;
+    }
+    generation = {};
+}
+
+void CodeCache::Flush()
+{
+    on_evict_(rx_, rx_ + size_);
+    flushes_++;
+    std::ranges::fill(generations_, Generation{});
+    current_generation_ = 0;
+}
+
+CodeCache::Stats CodeCache::GetStats() const
+{
+    Stats stats{ .bytes_used = 0, .capacity = size_, .block_count = 0, .flushes = flushes_ };
+    for (Generation const& generation : generations_) {
+        stats.bytes_used += generation.used;
+        stats.block_count += generation.block_count;
+    }
+    return stats;
+}
+
+Status CodeCache::Init(size_t size, u32 num_generations, bool dual_mapped, EvictCallback on_evict)
+{
+    assert(num_generations > 0 && size % num_generations == 0);
+    assert(on_evict);
+    if (dual_mapped) {
+        VirtMem::DualMapping mapping{};
+        Error err = VirtMem::allocDualMapping(&mapping, size, VirtMem::MemoryFlags::kAccessRWX);
+        if (err) {
+            return FailureStatus("Failed to allocate dual-mapped code cache of {} bytes; returned {}", size,
+              DebugUtils::errorAsString(err));
+        }
+        rx_ = static_cast<u8*>(mapping.rx);
+        rw_ = static_cast<u8*>(mapping.rw);
+    } else {
+        void* mapping{};
+        Error err =
+          VirtMem::alloc(&mapping, size, VirtMem::MemoryFlags::kAccessRWX | VirtMem::MemoryFlags::kMMapEnableMapJit);
+        if (err) {
+            return FailureStatus("Failed to allocate code cache of {} bytes; returned {}", size,
+              DebugUtils::errorAsString(err));
+        }
+        rx_ = rw_ = static_cast<u8*>(mapping);
+    }
+    rw_offset_ = reinterpret_cast<uintptr_t>(rw_) - reinterpret_cast<uintptr_t>(rx_);
+    size_ = size;
+    generation_size_ = size / num_generations;
+    generations_.assign(num_generations, Generation{});
+    current_generation_ = 0;
+    flushes_ = 0;
+    on_evict_ = on_evict;
+    return OkStatus();
+}
+
+void CodeCache::TearDown()
+{
+    if (!rx_) {
+        return;
+    }
+    if (rx_ != rw_) {
+        VirtMem::DualMapping mapping{ .rx = rx_, .rw = rw_ };
+        VirtMem::releaseDualMapping(&mapping, size_);
+    } else {
+        VirtMem::release(rx_, size_);
+    }
+    rx_ = rw_ = nullptr;
+    rw_offset_ = size_ = generation_size_ = 0;
+    generations_.clear();
+}
+
+void CodeCache::Write(void* dst, void const* src, size_t size)
+{
+    assert(Contains(dst));
+    VirtMem::ProtectJitReadWriteScope write_scope(dst, size);
+    std::memcpy(Writable(dst), src, size);
+}
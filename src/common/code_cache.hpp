@@ -0,0 +1,61 @@
+#pragma once
+
+#include "asmjit/core/codeholder.h"
+#include "numtypes.hpp"
+#include "status.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A fixed-size arena for JIT code, into which blocks are bump-allocated. The arena is split into generations that are
+// filled one after the other; once the last one is full, allocation wraps around and the oldest generation is evicted
+// as a whole. With a single generation, this amounts to flushing the whole cache whenever it is full.
+class CodeCache {
+public:
+    // Called before a range of the arena is reused. The owner must drop every reference into [begin, end).
+    using EvictCallback = void (*)(u8 const* begin, u8 const* end);
+
+    struct Stats {
+        size_t bytes_used;
+        size_t capacity;
+        size_t block_count;
+        u64 flushes;
+    };
+
+    // Copies the code in 'code' into the cache, and returns its executable address; null if it cannot be added.
+    void* Add(asmjit::CodeHolder& code);
+    bool Contains(void const* ptr) const;
+    void Flush();
+    Stats GetStats() const;
+    Status Init(size_t size, u32 num_generations, bool dual_mapped, EvictCallback on_evict);
+    void TearDown();
+
+    // Writes through a pointer into the executable view, e.g. to patch data that was embedded in a block.
+    template<typename T> void Write(T* ptr, T const& value) { Write(ptr, &value, sizeof(T)); }
+
+private:
+    struct Generation {
+        size_t used;
+        size_t block_count;
+    };
+
+    void Evict(u32 generation_index);
+    void Write(void* dst, void const* src, size_t size);
+
+    // Returns the writable alias of a pointer into the executable view. The two differ only when dual-mapped.
+    template<typename T> T* Writable(T* ptr) const
+    {
+        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(ptr) + rw_offset_);
+    }
+
+    u8* rx_{};
+    u8* rw_{};
+    uintptr_t rw_offset_{};
+    size_t size_{};
+    size_t generation_size_{};
+    std::vector<Generation> generations_;
+    u32 current_generation_{};
+    u64 flushes_{};
+    EvictCallback on_evict_{};
+};
@@ -0,0 +1,394 @@
+#include "host_memory.hpp"
+#include "log.hpp"
+#include "platform.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <format>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace host_memory {
+
+static bool dispatch_fault(void* fault_addr, void* host_context);
+static Status install_os_fault_handler();
+
+// Read from within the OS fault handler; kept as a plain array so that no allocation or locking happens there.
+static std::array<FaultHandler, 4> fault_handlers;
+static size_t num_fault_handlers;
+static bool os_fault_handler_installed;
+
+#ifdef _WIN32
+static LONG CALLBACK on_exception(EXCEPTION_POINTERS* info)
+{
+    EXCEPTION_RECORD const* record = info->ExceptionRecord;
+    if (record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || record->NumberParameters < 2) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+    void* fault_addr = reinterpret_cast<void*>(record->ExceptionInformation[1]);
+    return dispatch_fault(fault_addr, info->ContextRecord) ? EXCEPTION_CONTINUE_EXECUTION : EXCEPTION_CONTINUE_SEARCH;
+}
+#else
+static struct sigaction prev_sigbus_action, prev_sigsegv_action;
+
+static void on_signal(int sig, siginfo_t* info, void* host_context)
+{
+    if (dispatch_fault(info->si_addr, host_context)) {
+        return;
+    }
+    // Not ours; hand the fault to whoever was installed before us, or let the default action take place.
+    struct sigaction const& prev = sig == SIGSEGV ? prev_sigsegv_action : prev_sigbus_action;
+    if (prev.sa_flags & SA_SIGINFO) {
+        prev.sa_sigaction(sig, info, host_context);
+    } else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN) {
+        prev.sa_handler(sig);
+    } else {
+        sigaction(sig, &prev, nullptr); // the faulting instruction is retried and fails again, this time fatally
+    }
+}
+#endif
+
+Status add_fault_handler(FaultHandler handler)
+{
+    assert(handler);
+    if (!os_fault_handler_installed) {
+        Status status = install_os_fault_handler();
+        if (!status.Ok()) {
+            return status;
+        }
+        os_fault_handler_installed = true;
+    }
+    if (num_fault_handlers == fault_handlers.size()) {
+        return FailureStatus("Cannot register more than {} host memory fault handlers", fault_handlers.size());
+    }
+    fault_handlers[num_fault_handlers++] = handler;
+    return OkStatus();
+}
+
+void* allocate(size_t size)
+{
+#ifdef _WIN32
+    void* addr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+        addr = nullptr;
+    }
+#endif
+    if (!addr) {
+        log_error("Failed to allocate 0x{:X} bytes of host memory", size);
+    }
+    return addr;
+}
+
+Status create_shared_memory(SharedMemory& shm, size_t size)
+{
+#ifdef _WIN32
+    (void)shm;
+    (void)size;
+    return UnimplementedStatus("Shared memory views are not implemented on Windows");
+#else
+#ifdef __linux__
+    int fd = memfd_create("NanoStation", 0);
+#else
+    std::string name = std::format("/NanoStation-{}", getpid());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd != -1) {
+        shm_unlink(name.c_str()); // the descriptor keeps the memory alive
+    }
+#endif
+    if (fd == -1) {
+        return FailureStatus("Failed to create 0x{:X} bytes of shared memory", size);
+    }
+    if (ftruncate(fd, off_t(size)) != 0) {
+        close(fd);
+        return FailureStatus("Failed to size shared memory to 0x{:X} bytes", size);
+    }
+    shm = { .handle = fd, .size = size };
+    return OkStatus();
+#endif
+}
+
+void decommit(void* addr, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(addr, size, MEM_DECOMMIT);
+    VirtualAlloc(addr, size, MEM_COMMIT, PAGE_READWRITE);
+#else
+    madvise(addr, size, MADV_DONTNEED); // private anonymous mappings read back as zero afterwards
+#endif
+}
+
+void destroy_shared_memory(SharedMemory& shm)
+{
+#ifndef _WIN32
+    if (shm.handle != -1) {
+        close(int(shm.handle));
+    }
+#endif
+    shm = {};
+}
+
+bool dispatch_fault(void* fault_addr, void* host_context)
+{
+    for (size_t i = 0; i < num_fault_handlers; ++i) {
+        if (fault_handlers[i](fault_addr, host_context)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Status install_os_fault_handler()
+{
+#ifdef _WIN32
+    if (!AddVectoredExceptionHandler(1, on_exception)) {
+        return FailureStatus("AddVectoredExceptionHandler failed with error {}", GetLastError());
+    }
+#else
+    struct sigaction action {};
+    action.sa_sigaction = on_signal;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &prev_sigsegv_action) != 0) {
+        return FailureStatus("Failed to install SIGSEGV handler");
+    }
+    if (sigaction(SIGBUS, &action, &prev_sigbus_action) != 0) { // raised instead of SIGSEGV on macOS
+        return FailureStatus("Failed to install SIGBUS handler");
+    }
+#endif
+    return OkStatus();
+}
+
+void free(void* addr, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(addr, 0, MEM_RELEASE);
+#else
+    munmap(addr, size);
+#endif
+}
+
+uintptr_t get_fault_pc(void const* host_context)
+{
+#if defined _WIN32 && PLATFORM_X64
+    return static_cast<CONTEXT const*>(host_context)->Rip;
+#elif defined _WIN32
+    return static_cast<CONTEXT const*>(host_context)->Pc;
+#elif defined __APPLE__
+    return static_cast<ucontext_t const*>(host_context)->uc_mcontext->__ss.__pc;
+#elif PLATFORM_X64
+    return uintptr_t(static_cast<ucontext_t const*>(host_context)->uc_mcontext.gregs[REG_RIP]);
+#else
+    return uintptr_t(static_cast<ucontext_t const*>(host_context)->uc_mcontext.pc);
+#endif
+}
+
+bool map_shared_memory(SharedMemory const& shm, size_t offset, void* addr, size_t size)
+{
+    assert(offset + size <= shm.size);
+#ifdef _WIN32
+    (void)shm;
+    (void)offset;
+    bool success = false;
+#else
+    void* view = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, int(shm.handle), off_t(offset));
+    bool success = view == addr;
+#endif
+    if (!success) {
+        log_error("Failed to map shared memory at {}+0x{:X}", addr, size);
+    }
+    return success;
+}
+
+void const* module_base(void const* addr)
+{
+#ifdef _WIN32
+    HMODULE module{};
+    DWORD flags = GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT;
+    if (!GetModuleHandleExW(flags, static_cast<LPCWSTR>(addr), &module)) {
+        return nullptr;
+    }
+    return module;
+#else
+    Dl_info info{};
+    if (!dladdr(addr, &info)) {
+        return nullptr;
+    }
+    return info.dli_fbase;
+#endif
+}
+
+std::vector<std::span<uint8_t const>> module_code(void const* addr)
+{
+    std::vector<std::span<uint8_t const>> code;
+    uint8_t const* base = static_cast<uint8_t const*>(module_base(addr));
+    if (!base) {
+        return code;
+    }
+#ifdef _WIN32
+    auto const* dos_header = reinterpret_cast<IMAGE_DOS_HEADER const*>(base);
+    auto const* nt_headers = reinterpret_cast<IMAGE_NT_HEADERS const*>(base + dos_header->e_lfanew);
+    IMAGE_SECTION_HEADER const* sections = IMAGE_FIRST_SECTION(nt_headers);
+    for (WORD i = 0; i < nt_headers->FileHeader.NumberOfSections; ++i) {
+        if (sections[i].Characteristics & IMAGE_SCN_MEM_EXECUTE) {
+            code.emplace_back(base + sections[i].VirtualAddress, sections[i].Misc.VirtualSize);
+        }
+    }
+#else
+    struct Search {
+        uint8_t const* base;
+        std::vector<std::span<uint8_t const>>* code;
+    } search = { base, &code };
+    dl_iterate_phdr(
+      [](dl_phdr_info* info, size_t, void* data) {
+          Search& search = *static_cast<Search*>(data);
+          std::vector<std::span<uint8_t const>> segments;
+          bool contains_base = false;
+          for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+              ElfW(Phdr) const& phdr = info->dlpi_phdr[i];
+              if (phdr.p_type != PT_LOAD) continue;
+              uint8_t const* begin = reinterpret_cast<uint8_t const*>(info->dlpi_addr + phdr.p_vaddr);
+              contains_base |= search.base >= begin && search.base < begin + phdr.p_memsz;
+              if (phdr.p_flags & PF_X) {
+                  segments.emplace_back(begin, phdr.p_memsz);
+              }
+          }
+          if (!contains_base) {
+              return 0;
+          }
+          *search.code = std::move(segments);
+          return 1;
+      },
+      &search);
+#endif
+    return code;
+}
+
+size_t page_size()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+bool protect(void* addr, size_t size, Protection protection)
+{
+#ifdef _WIN32
+    DWORD new_protect = [protection] {
+        switch (protection) {
+        case Protection::NoAccess: return PAGE_NOACCESS;
+        case Protection::ReadOnly: return PAGE_READONLY;
+        case Protection::ReadWrite: return PAGE_READWRITE;
+        }
+        return PAGE_NOACCESS;
+    }();
+    DWORD old_protect;
+    bool success = VirtualProtect(addr, size, new_protect, &old_protect);
+#else
+    int prot = [protection] {
+        switch (protection) {
+        case Protection::NoAccess: return PROT_NONE;
+        case Protection::ReadOnly: return PROT_READ;
+        case Protection::ReadWrite: return PROT_READ | PROT_WRITE;
+        }
+        return PROT_NONE;
+    }();
+    bool success = mprotect(addr, size, prot) == 0;
+#endif
+    if (!success) {
+        log_error("Failed to change the protection of host memory range {}+0x{:X}", addr, size);
+    }
+    return success;
+}
+
+void remove_fault_handler(FaultHandler handler)
+{
+    auto handlers_end = fault_handlers.begin() + num_fault_handlers;
+    auto it = std::find(fault_handlers.begin(), handlers_end, handler);
+    if (it != handlers_end) {
+        std::copy(it + 1, handlers_end, it);
+        --num_fault_handlers;
+    }
+}
+
+void* reserve(size_t size, size_t alignment)
+{
+    assert(std::has_single_bit(alignment));
+#ifdef _WIN32
+    // Windows cannot trim a reservation; find a suitable address with an oversized one, then reserve exactly there.
+    // Another thread may take the address in between, so try a few times.
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        void* probe = VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+        if (!probe) break;
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(probe) + alignment - 1) & ~(alignment - 1);
+        VirtualFree(probe, 0, MEM_RELEASE);
+        if (void* addr = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE, PAGE_NOACCESS)) {
+            return addr;
+        }
+    }
+#else
+    void* probe = mmap(nullptr, size + alignment, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (probe != MAP_FAILED) {
+        // Over-reserve, then give back what lies outside of the aligned range
+        uintptr_t begin = reinterpret_cast<uintptr_t>(probe);
+        uintptr_t aligned = (begin + alignment - 1) & ~(alignment - 1);
+        if (aligned > begin) {
+            munmap(probe, aligned - begin);
+        }
+        if (size_t tail = begin + alignment - aligned) {
+            munmap(reinterpret_cast<void*>(aligned + size), tail);
+        }
+        return reinterpret_cast<void*>(aligned);
+    }
+#endif
+    log_error("Failed to reserve 0x{:X} bytes of host address space", size);
+    return nullptr;
+}
+
+void set_fault_pc(void* host_context, uintptr_t pc)
+{
+#if defined _WIN32 && PLATFORM_X64
+    static_cast<CONTEXT*>(host_context)->Rip = pc;
+#elif defined _WIN32
+    static_cast<CONTEXT*>(host_context)->Pc = pc;
+#elif defined __APPLE__
+    static_cast<ucontext_t*>(host_context)->uc_mcontext->__ss.__pc = pc;
+#elif PLATFORM_X64
+    static_cast<ucontext_t*>(host_context)->uc_mcontext.gregs[REG_RIP] = greg_t(pc);
+#else
+    static_cast<ucontext_t*>(host_context)->uc_mcontext.pc = pc;
+#endif
+}
+
+void unmap_shared_memory(void* addr, size_t size)
+{
+#ifdef _WIN32
+    (void)addr;
+    (void)size;
+#else
+    mmap(addr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+}
+
+} // namespace host_memory
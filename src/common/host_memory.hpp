@@ -0,0 +1,57 @@
+#pragma once
+
+#include "status.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace host_memory {
+
+// Called on a host memory access fault, with the faulting data address and the host thread context at the time of
+// the fault (ucontext_t* on POSIX, CONTEXT* on Windows). Returns true if the fault was resolved and the faulting
+// instruction should be retried; otherwise, the next handler gets to see the fault.
+using FaultHandler = bool (*)(void* fault_addr, void* host_context);
+
+enum class Protection {
+    NoAccess,
+    ReadOnly,
+    ReadWrite,
+};
+
+// Memory that can be mapped at several addresses at once, all views sharing the same physical pages.
+struct SharedMemory {
+    intptr_t handle = -1;
+    size_t size = 0;
+};
+
+Status add_fault_handler(FaultHandler handler);
+// Returns zeroed, read-write memory whose pages take up physical memory only once first written to; null on failure.
+void* allocate(size_t size);
+Status create_shared_memory(SharedMemory& shm, size_t size);
+// Zeroes a range of memory from allocate and hands its physical pages back to the OS.
+void decommit(void* addr, size_t size);
+// Views that are still mapped stay valid.
+void destroy_shared_memory(SharedMemory& shm);
+void free(void* addr, size_t size);
+// The instruction pointer in a host thread context handed to a FaultHandler, and changing it to resume elsewhere.
+uintptr_t get_fault_pc(void const* host_context);
+// Maps shm[offset, offset + size) read-write over the pages at addr, which must be reserved or allocated memory.
+bool map_shared_memory(SharedMemory const& shm, size_t offset, void* addr, size_t size);
+// Returns the load address of the executable or shared library that contains addr; null if there is none.
+void const* module_base(void const* addr);
+// Returns the executable segments (sections on Windows) of the executable or shared library that contains addr, as
+// loaded; empty if there is none.
+std::vector<std::span<uint8_t const>> module_code(void const* addr);
+size_t page_size();
+bool protect(void* addr, size_t size, Protection protection);
+void remove_fault_handler(FaultHandler handler);
+// Returns an inaccessible range of address space, aligned to alignment (a power of two); null on failure. Pages of it
+// are made usable with map_shared_memory. Release it with free.
+void* reserve(size_t size, size_t alignment);
+void set_fault_pc(void* host_context, uintptr_t pc);
+// Replaces a view made by map_shared_memory with inaccessible pages, which stay reserved.
+void unmap_shared_memory(void* addr, size_t size);
+
+} // namespace host_memory
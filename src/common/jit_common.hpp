@@ -2,6 +2,7 @@
 
 #include "asmjit/a64.h"
 #include "asmjit/x86.h"
+#include "build_options.hpp"
 #include "numtypes.hpp"
 #include "platform.hpp"
 
@@ -12,12 +13,12 @@
 using HostGpr32 = std::conditional_t<platform.x64, asmjit::x86::Gpd, asmjit::a64::GpW>;
 using HostGpr64 = std::conditional_t<platform.x64, asmjit::x86::Gpq, asmjit::a64::GpX>;
 using HostGpr128 = std::conditional_t<platform.x64, asmjit::x86::Xmm, asmjit::a64::VecV>;
-using JitCompiler = std::conditional_t<platform.x64, asmjit::x86::Compiler, asmjit::a64::Compiler>;
-
-using HostGpr32 = std::conditional_t<platform.x64, asmjit::x86::Gpd, asmjit::a64::GpW>;
-using HostGpr64 = std::conditional_t<platform.x64, asmjit::x86::Gpq, asmjit::a64::GpX>;
-using HostGpr128 = std::conditional_t<platform.x64, asmjit::x86::Xmm, asmjit::a64::VecV>;
-using JitCompiler = std::conditional_t<platform.x64, asmjit::x86::Compiler, asmjit::a64::Compiler>;
+// The emitter of JIT blocks. The register allocator of the EE JIT already picks every host register, so the Assembler
+// can emit the code as it goes; the Compiler builds a node graph of each block first, and runs asmjit's own register
+// allocation and passes over it, which only adds to the compile time.
+using JitCompiler = std::conditional_t<platform.x64,
+  std::conditional_t<enable_ee_jit_assembler_backend, asmjit::x86::Assembler, asmjit::x86::Compiler>,
+  asmjit::a64::Compiler>;
 
 struct AsmjitLogErrorHandler : public asmjit::ErrorHandler {
     void handleError(asmjit::Error err, char const* message, asmjit::BaseEmitter* /*origin*/) override;
@@ -39,8 +40,8 @@ inline constexpr std::array host_gpr_arg = [] {
     }
 }();
 
-inline void jit_call_no_stack_alignment(asmjit::x86::Compiler& c, auto func);
-inline void jit_call_with_stack_alignment(asmjit::x86::Compiler& c, auto func);
+inline void jit_call_no_stack_alignment(JitCompiler& c, auto func);
+inline void jit_call_with_stack_alignment(JitCompiler& c, auto func);
 [[gnu::const]] std::string HostRegToStr(HostGpr64 reg);
 [[gnu::const]] std::string HostRegToStr(HostGpr128 reg);
 [[gnu::const]] constexpr bool IsVolatile(asmjit::a64::Gp reg);
@@ -48,7 +49,7 @@ inline void jit_call_with_stack_alignment(asmjit::x86::Compiler& c, auto func);
 [[gnu::const]] constexpr bool IsVolatile(asmjit::a64::Vec reg);
 [[gnu::const]] constexpr bool IsVolatile(asmjit::x86::Vec reg);
 
-inline void jit_call_no_stack_alignment(asmjit::x86::Compiler& c, auto func)
+inline void jit_call_no_stack_alignment(JitCompiler& c, auto func)
 {
     using namespace asmjit::x86;
     if constexpr (platform.abi.systemv) {
@@ -61,7 +62,7 @@ inline void jit_call_no_stack_alignment(asmjit::x86::Compiler& c, auto func)
     }
 }
 
-inline void jit_call_with_stack_alignment(asmjit::x86::Compiler& c, auto func)
+inline void jit_call_with_stack_alignment(JitCompiler& c, auto func)
 {
     using namespace asmjit::x86;
     if constexpr (platform.abi.systemv) {
@@ -0,0 +1,182 @@
+#include "jit_perf.hpp"
+#include "numtypes.hpp"
+#include "platform.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// reference: tools/perf/Documentation/jit-interface.txt and jitdump-specification.txt in the Linux kernel tree
+
+namespace jit_perf {
+
+struct JitdumpHeader {
+    u32 magic;
+    u32 version;
+    u32 total_size;
+    u32 elf_mach;
+    u32 pad1;
+    u32 pid;
+    u64 timestamp;
+    u64 flags;
+};
+
+struct JitdumpRecordHeader {
+    u32 id;
+    u32 total_size;
+    u64 timestamp;
+};
+
+struct JitdumpCodeLoad {
+    u32 pid;
+    u32 tid;
+    u64 vma;
+    u64 code_addr;
+    u64 code_size;
+    u64 code_index;
+    // followed by the null-terminated name and the code
+};
+
+static u64 monotonic_time_ns();
+
+constexpr u32 jitdump_magic = 0x4A69'5444;
+constexpr u32 jitdump_version = 1;
+constexpr u32 jitdump_record_code_load = 0;
+constexpr u32 jitdump_record_code_close = 3;
+constexpr u32 elf_machine = platform.x64 ? 62 : 183; // EM_X86_64, EM_AARCH64
+
+static std::FILE* perf_map_file;
+static std::FILE* jitdump_file;
+static void* jitdump_marker; // mapping of the jitdump file, which is how perf finds the file in a recording
+static u64 code_index;
+
+void close()
+{
+#ifdef __linux__
+    if (perf_map_file) {
+        std::fclose(perf_map_file);
+        perf_map_file = nullptr;
+    }
+    if (jitdump_file) {
+        JitdumpRecordHeader record = {
+            .id = jitdump_record_code_close,
+            .total_size = sizeof(JitdumpRecordHeader),
+            .timestamp = monotonic_time_ns(),
+        };
+        std::fwrite(&record, sizeof(record), 1, jitdump_file);
+        munmap(jitdump_marker, size_t(sysconf(_SC_PAGESIZE)));
+        std::fclose(jitdump_file);
+        jitdump_file = nullptr;
+        jitdump_marker = nullptr;
+    }
+#endif
+}
+
+bool is_open()
+{
+    return perf_map_file || jitdump_file;
+}
+
+u64 monotonic_time_ns()
+{
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts); // the clock 'perf record -k mono' samples with
+    return u64(ts.tv_sec) * 1'000'000'000 + u64(ts.tv_nsec);
+#else
+    return 0;
+#endif
+}
+
+Status open(bool perf_map, bool jitdump)
+{
+#ifdef __linux__
+    close();
+    pid_t pid = getpid();
+    if (perf_map) {
+        std::string path = std::format("/tmp/perf-{}.map", pid);
+        perf_map_file = std::fopen(path.c_str(), "w");
+        if (!perf_map_file) {
+            return FailureStatus("Failed to open perf map {}", path);
+        }
+    }
+    if (jitdump) {
+        std::string path = std::format("/tmp/jit-{}.dump", pid);
+        jitdump_file = std::fopen(path.c_str(), "w+");
+        if (!jitdump_file) {
+            close();
+            return FailureStatus("Failed to open jitdump file {}", path);
+        }
+        jitdump_marker =
+          mmap(nullptr, size_t(sysconf(_SC_PAGESIZE)), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(jitdump_file), 0);
+        if (jitdump_marker == MAP_FAILED) {
+            jitdump_marker = nullptr;
+            close();
+            return FailureStatus("Failed to map jitdump file {}", path);
+        }
+        JitdumpHeader header = {
+            .magic = jitdump_magic,
+            .version = jitdump_version,
+            .total_size = sizeof(JitdumpHeader),
+            .elf_mach = elf_machine,
+            .pad1 = 0,
+            .pid = u32(pid),
+            .timestamp = monotonic_time_ns(),
+            .flags = 0,
+        };
+        std::fwrite(&header, sizeof(header), 1, jitdump_file);
+        std::fflush(jitdump_file);
+    }
+    code_index = 0;
+    return OkStatus();
+#else
+    (void)perf_map;
+    (void)jitdump;
+    return UnimplementedStatus("perf integration is only available on Linux");
+#endif
+}
+
+void record_code(void const* code, size_t size, std::string_view name)
+{
+#ifdef __linux__
+    if (perf_map_file) {
+        std::string line = std::format("{:x} {:x} {}\n", reinterpret_cast<uintptr_t>(code), size, name);
+        std::fwrite(line.data(), 1, line.size(), perf_map_file);
+        std::fflush(perf_map_file); // perf may read the map while the emulator is still running
+    }
+    if (jitdump_file) {
+        JitdumpRecordHeader record = {
+            .id = jitdump_record_code_load,
+            .total_size = u32(sizeof(JitdumpRecordHeader) + sizeof(JitdumpCodeLoad) + name.size() + 1 + size),
+            .timestamp = monotonic_time_ns(),
+        };
+        JitdumpCodeLoad load = {
+            .pid = u32(getpid()),
+            .tid = u32(syscall(SYS_gettid)),
+            .vma = reinterpret_cast<uintptr_t>(code),
+            .code_addr = reinterpret_cast<uintptr_t>(code),
+            .code_size = size,
+            .code_index = code_index++,
+        };
+        std::fwrite(&record, sizeof(record), 1, jitdump_file);
+        std::fwrite(&load, sizeof(load), 1, jitdump_file);
+        std::fwrite(name.data(), 1, name.size(), jitdump_file);
+        std::fputc('\0', jitdump_file);
+        std::fwrite(code, 1, size, jitdump_file);
+    }
+#else
+    (void)code;
+    (void)size;
+    (void)name;
+#endif
+}
+
+} // namespace jit_perf
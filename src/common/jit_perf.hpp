@@ -0,0 +1,20 @@
+#pragma once
+
+#include "status.hpp"
+
+#include <cstddef>
+#include <string_view>
+
+// Tells the Linux perf tool about JIT code, which it would otherwise only see as anonymous addresses. A perf map
+// (/tmp/perf-<pid>.map) gives names to code ranges, and is picked up by perf report directly. A jitdump file
+// (/tmp/jit-<pid>.dump) also carries the code itself, for perf annotate; it is merged into a recording made with
+// 'perf record -k mono' by 'perf inject --jit'. Code that is overwritten later is simply recorded again.
+namespace jit_perf {
+
+void close();
+bool is_open();
+Status open(bool perf_map, bool jitdump);
+// Call once the code is at its final, executable address.
+void record_code(void const* code, size_t size, std::string_view name);
+
+} // namespace jit_perf
@@ -78,6 +78,14 @@ void check_events(s64 ee_cycles_elapsed)
     }
 }
 
+std::optional<s64> get_ee_cycles_until_next_event()
+{
+    if (events.empty()) {
+        return {};
+    }
+    return events.front().ee_cycles_until_fire;
+}
+
 void init()
 {
     events.clear();
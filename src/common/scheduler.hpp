@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <thread>
 
 #include "inplace_function.hpp"
@@ -26,6 +27,8 @@ enum class EventType : u8 {
 void add_event(EventType event, s64 ee_cycles_until_fire, EventCallback callback);
 void add_event_or_change_time(EventType event_type, s64 ee_cycles_until_fire, EventCallback callback);
 void change_event_time(EventType event, s64 ee_cycles_until_fire);
+// Relative to the start of the current EE step, as the events are kept; none if no event is pending
+std::optional<s64> get_ee_cycles_until_next_event();
 void init();
 void remove_event(EventType event);
 void run(std::stop_token stop_token);
@@ -1,7 +1,9 @@
 #include "cop0.hpp"
 #include "ee.hpp"
 #include "exceptions.hpp"
+#include "fastmem.hpp"
 #include "intc.hpp"
+#include "jit.hpp"
 #include "mmu.hpp"
 #include "scheduler.hpp"
 
@@ -95,12 +97,18 @@ void tlbr()
 
 void tlbwi()
 {
-    tlb_entries[cop0.index.value % tlb_entries.size()].write();
+    u32 index = cop0.index.value % tlb_entries.size();
+    tlb_entries[index].write();
+    UpdateFastmemTlbMapping(index);
+    InvalidateReturnStack();
 }
 
 void tlbwr()
 {
-    tlb_entries[cop0.random % tlb_entries.size()].write();
+    u32 index = cop0.random % tlb_entries.size();
+    tlb_entries[index].write();
+    UpdateFastmemTlbMapping(index);
+    InvalidateReturnStack();
 }
 
 template<bool initial_add> void reload_count_compare_event()
@@ -199,6 +207,7 @@ template<bool raw> void Cop0Registers::set(int reg, u32 value)
     case 10:
         if constexpr (raw) write(entry_hi);
         else write_masked(entry_hi, 0xFFFF'E0FF);
+        on_write_to_entry_hi();
         break;
 
     case 11:
@@ -274,6 +283,11 @@ void Cop0Registers::on_write_to_count()
 {
 }
 
+void Cop0Registers::on_write_to_entry_hi()
+{
+    sync_vtlb_asid();
+}
+
 void Cop0Registers::on_write_to_status()
 {
 }
@@ -242,6 +242,7 @@ struct Cop0Registers {
     void on_write_to_cause();
     void on_write_to_compare();
     void on_write_to_count();
+    void on_write_to_entry_hi();
     void on_write_to_status();
     void update_random();
 } inline cop0;
@@ -1,215 +1,358 @@
 #include "cop1.hpp"
+#include "asmjit/x86.h"
+#include "jit.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+// FPRs stay in memory: each instruction loads its operands into xmm0 and xmm1, and stores its result from xmm0
+
+using namespace asmjit;
+using namespace asmjit::x86;
 
 namespace ee {
 
-void abs_s(u32 fd, u32 fs)
+static constexpr std::array fpu_clamp_mode_names = { "none", "results", "full" };
+
+static FpuClampMode fpu_clamp_mode = FpuClampMode::Results;
+
+alignas(16) static constexpr u32 exponent_mask[4] = { 0x7F80'0000, 0x7F80'0000, 0x7F80'0000, 0x7F80'0000 };
+alignas(16) static constexpr u32 magnitude_mask[4] = { 0x7FFF'FFFF, 0x7FFF'FFFF, 0x7FFF'FFFF, 0x7FFF'FFFF };
+alignas(16) static constexpr u32 max_magnitude[4] = { 0x7F7F'FFFF, 0x7F7F'FFFF, 0x7F7F'FFFF, 0x7F7F'FFFF };
+alignas(16) static constexpr u32 sign_mask[4] = { 0x8000'0000, 0x8000'0000, 0x8000'0000, 0x8000'0000 };
+
+// As EeF32: an exponent of 255 turns into the largest magnitude, and one of 0 into zero, keeping the sign. xmm2 and xmm3
+// are used as temporaries.
+static void emit_clamp(Xmm x)
+{
+    c.vpand(xmm2, x, JitPtr(exponent_mask));
+    c.vpxor(xmm3, xmm3, xmm3);
+    c.vpcmpeqd(xmm3, xmm2, xmm3);
+    c.vpand(xmm3, xmm3, JitPtr(magnitude_mask));
+    c.vpandn(x, xmm3, x); // exponent 0: zero
+    c.vpcmpeqd(xmm2, xmm2, JitPtr(exponent_mask));
+    c.vpand(xmm3, x, JitPtr(sign_mask));
+    c.vpor(xmm3, xmm3, JitPtr(max_magnitude));
+    c.vblendvps(x, x, xmm3, xmm2); // exponent 255: the largest magnitude
+}
+
+static void emit_clamp_operand(Xmm x)
+{
+    if (fpu_clamp_mode == FpuClampMode::Full) {
+        emit_clamp(x);
+    }
+}
+
+static void emit_clamp_result(Xmm x)
+{
+    if (fpu_clamp_mode != FpuClampMode::None) {
+        emit_clamp(x);
+    }
+}
+
+static void emit_load_operand(Xmm dst, u32 const& src)
+{
+    c.vmovd(dst, JitPtr(src));
+    emit_clamp_operand(dst);
+}
+
+// fs in xmm0 and ft in xmm1
+static void emit_load_operands(u32 fs, u32 ft)
+{
+    emit_load_operand(xmm0, fpr[fs]);
+    emit_load_operand(xmm1, fpr[ft]);
+}
+
+static void emit_store_result(u32& dst)
+{
+    emit_clamp_result(xmm0);
+    c.vmovd(JitPtr(dst), xmm0);
+}
+
+// ADD.S, SUB.S, MUL.S and DIV.S, and their forms that write ACC: dst = fs op ft
+static void emit_arithmetic(u32& dst, u32 fs, u32 ft, auto op)
+{
+    emit_load_operands(fs, ft);
+    op(xmm0, xmm0, xmm1);
+    emit_store_result(dst);
+}
+
+// MADD.S and MSUB.S, and their forms that write ACC: dst = ACC op fs * ft, rounded after the multiply as on the PS2
+static void emit_multiply_accumulate(u32& dst, u32 fs, u32 ft, auto op)
+{
+    emit_load_operands(fs, ft);
+    c.vmulss(xmm1, xmm0, xmm1);
+    emit_clamp_operand(xmm1);
+    emit_load_operand(xmm0, fpr_acc);
+    op(xmm0, xmm0, xmm1);
+    emit_store_result(dst);
+}
+
+// C.EQ.S, C.LT.S and C.LE.S: the condition bit of FCR31 is set to the outcome of fs predicate ft
+static void emit_compare(u32 fs, u32 ft, CmpImm predicate)
+{
+    emit_load_operands(fs, ft);
+    c.vcmpss(xmm0, xmm0, xmm1, std::to_underlying(predicate));
+    c.vmovd(eax, xmm0);
+    c.and_(eax, fcr31_c_mask);
+    c.and_(JitPtr(fcr31), ~fcr31_c_mask);
+    c.or_(JitPtr(fcr31), eax);
+}
+
+// BC1F, BC1T, BC1FL and BC1TL: branches on the condition bit of FCR31; like the branches that the IR resolves itself
+static void emit_branch(s16 imm, bool if_set, bool likely)
+{
+    Label l_taken = c.newLabel(), l_done = c.newLabel();
+    c.test(JitPtr(fcr31), fcr31_c_mask);
+    c.j(if_set ? CondCode::kNotZero : CondCode::kZero, l_taken);
+    if (likely) {
+        DiscardBranch(); // skips the delay slot
+    } else {
+        OnBranchNotTaken();
+        c.jmp(l_done);
+    }
+    c.bind(l_taken);
+    TakeBranch(jit_pc + 4 + (u32(s32(imm)) << 2));
+    c.bind(l_done);
+}
+
+std::string_view FpuClampModeName(FpuClampMode mode)
+{
+    return fpu_clamp_mode_names[std::to_underlying(mode)];
+}
+
+FpuClampMode GetFpuClampMode()
+{
+    return fpu_clamp_mode;
+}
+
+std::optional<FpuClampMode> ParseFpuClampMode(std::string_view name)
+{
+    auto it = std::ranges::find(fpu_clamp_mode_names, name);
+    if (it == fpu_clamp_mode_names.end()) {
+        return {};
+    }
+    return FpuClampMode(it - fpu_clamp_mode_names.begin());
+}
+
+void SetFpuClampMode(FpuClampMode mode)
+{
+    fpu_clamp_mode = mode;
+    log_info("EE JIT: FPU clamp mode: {}", FpuClampModeName(mode));
+}
+
+void abs_s(u32 fd, u32 fs) // Floating-point Absolute Value
 {
-    (void)fd;
-    (void)fs;
+    c.mov(eax, JitPtr(fpr[fs]));
+    c.and_(eax, 0x7FFF'FFFF);
+    c.mov(JitPtr(fpr[fd]), eax);
 }
 
-void add_s(u32 fd, u32 fs, u32 ft)
+void add_s(u32 fd, u32 fs, u32 ft) // Floating-point Add
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr[fd], fs, ft, [](auto... ops) { c.vaddss(ops...); });
 }
 
-void adda_s(u32 fs, u32 ft)
+void adda_s(u32 fs, u32 ft) // Floating-point Add to Accumulator
 {
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr_acc, fs, ft, [](auto... ops) { c.vaddss(ops...); });
 }
 
-void bc1f(s16 imm)
+void bc1f(s16 imm) // Branch on FPU False
 {
-    (void)imm;
+    emit_branch(imm, false, false);
 }
 
-void bc1fl(s16 imm)
+void bc1fl(s16 imm) // Branch on FPU False Likely
 {
-    (void)imm;
+    emit_branch(imm, false, true);
 }
 
-void bc1t(s16 imm)
+void bc1t(s16 imm) // Branch on FPU True
 {
-    (void)imm;
+    emit_branch(imm, true, false);
 }
 
-void bc1tl(s16 imm)
+void bc1tl(s16 imm) // Branch on FPU True Likely
 {
-    (void)imm;
+    emit_branch(imm, true, true);
 }
 
-void c_eq(u32 fs, u32 ft)
+void c_eq(u32 fs, u32 ft) // Floating-point Compare Equal
 {
-    (void)fs;
-    (void)ft;
+    emit_compare(fs, ft, CmpImm::kEQ);
 }
 
-void c_f(u32 fs, u32 ft)
+void c_f(u32, u32) // Floating-point Compare False
 {
-    (void)fs;
-    (void)ft;
+    c.and_(JitPtr(fcr31), ~fcr31_c_mask);
 }
 
-void c_le(u32 fs, u32 ft)
+void c_le(u32 fs, u32 ft) // Floating-point Compare Less Than or Equal
 {
-    (void)fs;
-    (void)ft;
+    emit_compare(fs, ft, CmpImm::kLE);
 }
 
-void c_lt(u32 fs, u32 ft)
+void c_lt(u32 fs, u32 ft) // Floating-point Compare Less Than
 {
-    (void)fs;
-    (void)ft;
+    emit_compare(fs, ft, CmpImm::kLT);
 }
 
-void cfc1(u32 fs, u32 rt)
+void cfc1(u32 fs, u32 rt) // Move Control Word from Floating-point
 {
-    (void)fs;
-    (void)rt;
+    if (!rt) return;
+    if (fs == 31) {
+        c.movsxd(reg_alloc.GetDirtyGpr(rt), JitPtr(fcr31));
+    } else {
+        reg_alloc.SetConst(rt, fs ? 0 : fcr0);
+    }
 }
 
-void ctc1(u32 fs, u32 rt)
+void ctc1(u32 fs, u32 rt) // Move Control Word to Floating-point
 {
-    (void)fs;
-    (void)rt;
+    if (fs == 31) {
+        c.mov(JitPtr(fcr31), reg_alloc.GetGpr(rt).r32());
+    }
 }
 
-void cvt_s(u32 fd, u32 fs)
+void cvt_s(u32 fd, u32 fs) // Fixed-point Convert to Single Floating-point
 {
-    (void)fd;
-    (void)fs;
+    c.vcvtsi2ss(xmm0, xmm0, JitPtr(fpr[fs]));
+    c.vmovd(JitPtr(fpr[fd]), xmm0);
 }
 
-void cvt_w(u32 fd, u32 fs)
+void cvt_w(u32 fd, u32 fs) // Floating-point Convert to Word Fixed-point
 {
-    (void)fd;
-    (void)fs;
+    // Out of range, the host returns INT_MIN, where the PS2 saturates to INT_MAX for positive values. The host's
+    // Infinities and NaNs are such large values on the PS2, and so the operand needs no clamping.
+    Label l_done = c.newLabel();
+    c.vcvttss2si(eax, JitPtr(fpr[fs]));
+    c.cmp(eax, 0x8000'0000);
+    c.jne(l_done);
+    c.cmp(JitPtr(fpr[fs]), 0);
+    c.jl(l_done);
+    c.mov(eax, 0x7FFF'FFFF);
+    c.bind(l_done);
+    c.mov(JitPtr(fpr[fd]), eax);
 }
 
-void div_s(u32 fd, u32 fs, u32 ft)
+void div_s(u32 fd, u32 fs, u32 ft) // Floating-point Divide
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr[fd], fs, ft, [](auto... ops) { c.vdivss(ops...); });
 }
 
-void lwc1(u32 ft, u32 base, u32 imm)
+void lwc1(u32 ft, u32 base, u32 imm) // Load Word to Floating-point
 {
-    (void)ft;
-    (void)base;
-    (void)imm;
+    EmitLoadWordToMem(base, s16(imm), JitPtr(fpr[ft]));
 }
 
-void madd_s(u32 fd, u32 fs, u32 ft)
+void madd_s(u32 fd, u32 fs, u32 ft) // Floating-point Multiply-Add
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_multiply_accumulate(fpr[fd], fs, ft, [](auto... ops) { c.vaddss(ops...); });
 }
 
-void madda_s(u32 fs, u32 ft)
+void madda_s(u32 fs, u32 ft) // Floating-point Multiply-Add to Accumulator
 {
-    (void)fs;
-    (void)ft;
+    emit_multiply_accumulate(fpr_acc, fs, ft, [](auto... ops) { c.vaddss(ops...); });
 }
 
-void max_s(u32 fd, u32 fs, u32 ft)
+void max_s(u32 fd, u32 fs, u32 ft) // Floating-point Maximum
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_load_operands(fs, ft);
+    c.vmaxss(xmm0, xmm0, xmm1);
+    c.vmovd(JitPtr(fpr[fd]), xmm0); // one of the operands; clamped already, if at all
 }
 
-void mfc1(u32 fs, u32 rt)
+void mfc1(u32 fs, u32 rt) // Move Word from Floating-point
 {
-    (void)fs;
-    (void)rt;
+    if (rt) {
+        c.movsxd(reg_alloc.GetDirtyGpr(rt), JitPtr(fpr[fs]));
+    }
 }
 
-void min_s(u32 fd, u32 fs, u32 ft)
+void min_s(u32 fd, u32 fs, u32 ft) // Floating-point Minimum
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_load_operands(fs, ft);
+    c.vminss(xmm0, xmm0, xmm1);
+    c.vmovd(JitPtr(fpr[fd]), xmm0);
 }
 
-void mov_s(u32 fd, u32 fs)
+void mov_s(u32 fd, u32 fs) // Floating-point Move
 {
-    (void)fd;
-    (void)fs;
+    if (fd != fs) {
+        c.mov(eax, JitPtr(fpr[fs]));
+        c.mov(JitPtr(fpr[fd]), eax);
+    }
 }
 
-void msub_s(u32 fd, u32 fs, u32 ft)
+void msub_s(u32 fd, u32 fs, u32 ft) // Floating-point Multiply-Subtract
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_multiply_accumulate(fpr[fd], fs, ft, [](auto... ops) { c.vsubss(ops...); });
 }
 
-void msuba_s(u32 fs, u32 ft)
+void msuba_s(u32 fs, u32 ft) // Floating-point Multiply-Subtract from Accumulator
 {
-    (void)fs;
-    (void)ft;
+    emit_multiply_accumulate(fpr_acc, fs, ft, [](auto... ops) { c.vsubss(ops...); });
 }
 
-void mtc1(u32 fs, u32 rt)
+void mtc1(u32 fs, u32 rt) // Move Word to Floating-point
 {
-    (void)fs;
-    (void)rt;
+    if (std::optional<u64> value = reg_alloc.GetConst(rt)) {
+        c.mov(JitPtr(fpr[fs]), u32(*value));
+    } else {
+        c.mov(JitPtr(fpr[fs]), reg_alloc.GetGpr(rt).r32());
+    }
 }
 
-void mul_s(u32 fd, u32 fs, u32 ft)
+void mul_s(u32 fd, u32 fs, u32 ft) // Floating-point Multiply
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr[fd], fs, ft, [](auto... ops) { c.vmulss(ops...); });
 }
 
-void mula_s(u32 fs, u32 ft)
+void mula_s(u32 fs, u32 ft) // Floating-point Multiply to Accumulator
 {
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr_acc, fs, ft, [](auto... ops) { c.vmulss(ops...); });
 }
 
-void neg_s(u32 fd, u32 fs)
+void neg_s(u32 fd, u32 fs) // Floating-point Negate
 {
-    (void)fd;
-    (void)fs;
+    c.mov(eax, JitPtr(fpr[fs]));
+    c.xor_(eax, 0x8000'0000);
+    c.mov(JitPtr(fpr[fd]), eax);
 }
 
-void rsqrt_s(u32 fd, u32 fs)
+void rsqrt_s(u32 fd, u32 fs, u32 ft) // Floating-point Reciprocal Square Root
 {
-    (void)fd;
-    (void)fs;
+    emit_load_operands(fs, ft);
+    c.vandps(xmm1, xmm1, JitPtr(magnitude_mask)); // the PS2 takes the root of the absolute value
+    c.vsqrtss(xmm1, xmm1, xmm1);
+    c.vdivss(xmm0, xmm0, xmm1);
+    emit_store_result(fpr[fd]);
 }
 
-void sqrt_s(u32 fd, u32 fs)
+void sqrt_s(u32 fd, u32 ft) // Floating-point Square Root
 {
-    (void)fd;
-    (void)fs;
+    emit_load_operand(xmm0, fpr[ft]);
+    c.vandps(xmm0, xmm0, JitPtr(magnitude_mask));
+    c.vsqrtss(xmm0, xmm0, xmm0);
+    c.vmovd(JitPtr(fpr[fd]), xmm0); // can neither overflow nor underflow
 }
 
-void sub_s(u32 fd, u32 fs, u32 ft)
+void sub_s(u32 fd, u32 fs, u32 ft) // Floating-point Subtract
 {
-    (void)fd;
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr[fd], fs, ft, [](auto... ops) { c.vsubss(ops...); });
 }
 
-void suba_s(u32 fs, u32 ft)
+void suba_s(u32 fs, u32 ft) // Floating-point Subtract to Accumulator
 {
-    (void)fs;
-    (void)ft;
+    emit_arithmetic(fpr_acc, fs, ft, [](auto... ops) { c.vsubss(ops...); });
 }
 
-void swc1(u32 ft, u32 base, u32 imm)
+void swc1(u32 ft, u32 base, u32 imm) // Store Word from Floating-point
 {
-    (void)ft;
-    (void)base;
-    (void)imm;
+    EmitStoreWordFromMem(base, s16(imm), JitPtr(fpr[ft]));
 }
 
 } // namespace ee
@@ -2,7 +2,34 @@
 
 #include "numtypes.hpp"
 
+#include <array>
+#include <optional>
+#include <string_view>
+
 namespace ee {
+
+// How closely compiled FPU instructions follow the PS2 float format (see eef32.hpp), where the host's Infinities and
+// NaNs are the largest normal values, and denormals are zero: not at all; on the results of arithmetic, which turns the
+// host's overflows and underflows into the PS2's; or also on the operands, for FPRs written with raw bit patterns
+enum class FpuClampMode {
+    None,
+    Results,
+    Full,
+};
+
+FpuClampMode GetFpuClampMode();
+std::string_view FpuClampModeName(FpuClampMode mode);
+std::optional<FpuClampMode> ParseFpuClampMode(std::string_view name);
+// Applies to blocks compiled from then on
+void SetFpuClampMode(FpuClampMode mode);
+
+inline constexpr u32 fcr0 = 0x2E30; // implementation and revision
+inline constexpr u32 fcr31_c_mask = 1 << 23; // the condition bit, set by C.cond.S and tested by BC1
+
+inline std::array<u32, 32> fpr; // raw bits, read and written by the JIT as floats
+inline u32 fpr_acc; // the accumulator of ADDA.S, MADD.S etc.
+inline u32 fcr31;
+
 void abs_s(u32 fd, u32 fs);
 void add_s(u32 fd, u32 fs, u32 ft);
 void adda_s(u32 fs, u32 ft);
@@ -32,8 +59,8 @@ void mtc1(u32 fs, u32 rt);
 void mul_s(u32 fd, u32 fs, u32 ft);
 void mula_s(u32 fs, u32 ft);
 void neg_s(u32 fd, u32 fs);
-void rsqrt_s(u32 fd, u32 fs);
-void sqrt_s(u32 fd, u32 fs);
+void rsqrt_s(u32 fd, u32 fs, u32 ft);
+void sqrt_s(u32 fd, u32 ft);
 void sub_s(u32 fd, u32 fs, u32 ft);
 void suba_s(u32 fs, u32 ft);
 void swc1(u32 ft, u32 base, u32 imm);
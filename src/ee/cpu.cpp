@@ -5,14 +5,13 @@
 #include "jit.hpp"
 #include "mmu.hpp"
 #include <bit>
+#include <optional>
 
 using namespace asmjit;
 using namespace asmjit::x86;
 
 namespace ee {
 
-asmjit::Label l_early_block_epilogue;
-
 asmjit::x86::Gpq get_gpr(u32 index)
 {
     (void)index;
@@ -21,7 +20,7 @@ asmjit::x86::Gpq get_gpr(u32 index)
 
 asmjit::x86::Gpq get_dirty_gpr(u32 index)
 {
-    (void)index;
+    reg_alloc.ClearConst(index);
     return rax;
 }
 
@@ -44,17 +43,6 @@ asmjit::x86::Mem jit_ptr(auto...)
     return {};
 }
 
-template<u32 size> void emit_store(u32 rs, u32 rt, s16 imm)
-{
-    static_assert(std::has_single_bit(size));
-    Gpq hs = get_gpr(rs), ht = get_gpr(rt);
-    c.lea(eax, ptr(hs, imm));
-    if constexpr (size > 1) {
-        c.test(al, size - 1);
-        c.jnz(l_early_block_epilogue);
-    }
-}
-
 void add(u32 rs, u32 rt, u32 rd)
 {
     Label l_noexception = c.newLabel();
@@ -88,9 +76,13 @@ void addi(u32 rs, u32 rt, s16 imm)
 void addiu(u32 rs, u32 rt, s16 imm)
 {
     if (!rt) return;
-    Gpd ht = get_dirty_gpr(rt).r32(), hs = get_gpr(rs).r32();
+    if (std::optional<u64> s = reg_alloc.GetConst(rs)) {
+        reg_alloc.SetConst(rt, u64(s32(u32(*s) + imm)));
+        return;
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetDirtyGpr(rt);
     c.lea(eax, ptr(hs, imm));
-    c.movsxd(ht.r64(), eax);
+    c.movsxd(ht, eax);
 }
 
 void addu(u32 rs, u32 rt, u32 rd)
@@ -106,8 +98,18 @@ void and_(u32 rs, u32 rt, u32 rd)
     Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
 }
 
-void andi(u32, u32, u16)
+void andi(u32 rs, u32 rt, u16 imm)
 {
+    if (!rt) return;
+    if (std::optional<u64> s = reg_alloc.GetConst(rs)) {
+        reg_alloc.SetConst(rt, *s & imm);
+        return;
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetDirtyGpr(rt);
+    if (rt != rs) {
+        c.mov(ht.r32(), hs.r32());
+    }
+    c.and_(ht.r32(), imm); // also clears the upper half
 }
 
 void beq(u32, u32, s16)
@@ -201,8 +203,15 @@ void daddi(u32, u32, s16)
 {
 }
 
-void daddiu(u32, u32, s16)
+void daddiu(u32 rs, u32 rt, s16 imm)
 {
+    if (!rt) return;
+    if (std::optional<u64> s = reg_alloc.GetConst(rs)) {
+        reg_alloc.SetConst(rt, *s + u64(s64(imm)));
+        return;
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetDirtyGpr(rt);
+    c.lea(ht, ptr(hs, imm));
 }
 
 void daddu(u32 rs, u32 rt, u32 rd)
@@ -349,16 +358,19 @@ void jr(u32)
 {
 }
 
-void lb(u32, u32, s16)
+void lb(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<s8>(rs, rt, imm);
 }
 
-void lbu(u32, u32, s16)
+void lbu(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<u8>(rs, rt, imm);
 }
 
-void ld(u32, u32, s16)
+void ld(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<u64>(rs, rt, imm);
 }
 
 void ldl(u32, u32, s16)
@@ -369,24 +381,29 @@ void ldr(u32, u32, s16)
 {
 }
 
-void lh(u32, u32, s16)
+void lh(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<s16>(rs, rt, imm);
 }
 
-void lhu(u32, u32, s16)
+void lhu(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<u16>(rs, rt, imm);
 }
 
-void lq(u32, u32, s16)
+void lq(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoadQuad(rs, rt, imm);
 }
 
-void lui(u32, s16)
+void lui(u32 rt, s16 imm)
 {
+    reg_alloc.SetConst(rt, u64(s64(imm) << 16));
 }
 
-void lw(u32, u32, s16)
+void lw(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<s32>(rs, rt, imm);
 }
 
 void lwl(u32, u32, s16)
@@ -397,8 +414,9 @@ void lwr(u32, u32, s16)
 {
 }
 
-void lwu(u32, u32, s16)
+void lwu(u32 rs, u32 rt, s16 imm)
 {
+    EmitLoad<u32>(rs, rt, imm);
 }
 
 void madd(u32 rs, u32 rt, u32 rd) // Multiply/Add
@@ -473,20 +491,36 @@ void maddu1(u32 rs, u32 rt, u32 rd) // Multiply-Add Unsigned Pipeline 1
     c.vpinsrq(hhi, hhi, rax, 1);
 }
 
-void mfhi(u32)
+void mfhi(u32 rd)
 {
+    if (!rd) return;
+    HostGpr128 hi = reg_alloc.GetHi();
+    HostGpr64 hd = reg_alloc.GetDirtyGpr(rd);
+    c.vmovq(hd, hi);
 }
 
-void mfhi1(u32)
+void mfhi1(u32 rd)
 {
+    if (!rd) return;
+    HostGpr128 hi = reg_alloc.GetHi();
+    HostGpr64 hd = reg_alloc.GetDirtyGpr(rd);
+    c.vpextrq(hd, hi, 1);
 }
 
-void mflo(u32)
+void mflo(u32 rd)
 {
+    if (!rd) return;
+    HostGpr128 lo = reg_alloc.GetLo();
+    HostGpr64 hd = reg_alloc.GetDirtyGpr(rd);
+    c.vmovq(hd, lo);
 }
 
-void mflo1(u32)
+void mflo1(u32 rd)
 {
+    if (!rd) return;
+    HostGpr128 lo = reg_alloc.GetLo();
+    HostGpr64 hd = reg_alloc.GetDirtyGpr(rd);
+    c.vpextrq(hd, lo, 1);
 }
 
 void mfsa(u32 rs)
@@ -505,20 +539,32 @@ void movz(u32 rs, u32 rt, u32 rd)
     Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
 }
 
-void mthi(u32)
+void mthi(u32 rs)
 {
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    HostGpr128 hi = reg_alloc.GetDirtyHi();
+    c.vpinsrq(hi, hi, hs, 0);
 }
 
-void mthi1(u32)
+void mthi1(u32 rs)
 {
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    HostGpr128 hi = reg_alloc.GetDirtyHi();
+    c.vpinsrq(hi, hi, hs, 1);
 }
 
-void mtlo(u32)
+void mtlo(u32 rs)
 {
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    HostGpr128 lo = reg_alloc.GetDirtyLo();
+    c.vpinsrq(lo, lo, hs, 0);
 }
 
-void mtlo1(u32)
+void mtlo1(u32 rs)
 {
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    HostGpr128 lo = reg_alloc.GetDirtyLo();
+    c.vpinsrq(lo, lo, hs, 1);
 }
 
 void mtsa(u32 rs)
@@ -546,52 +592,53 @@ void mtsah(u32 rs, s16 imm)
     c.mov(jit_ptr(sa), eax);
 }
 
+// MULT, MULTU and their pipeline 1 forms: the product of the lower words of rs and rt, its lower and upper words
+// sign-extended into the lower or upper doublewords of LO and HI, and into rd. Computed in vector registers, as the
+// widening multiplies of the host write rdx, which the register allocator hands out.
+static void emit_mult(u32 rs, u32 rt, u32 rd, bool is_signed, bool pipeline1)
+{
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetGpr(rt);
+    HostGpr128 hlo = reg_alloc.GetDirtyLo(), hhi = reg_alloc.GetDirtyHi();
+    c.vmovd(xmm0, hs.r32());
+    c.vmovd(xmm1, ht.r32());
+    if (is_signed) {
+        c.vpmuldq(xmm0, xmm0, xmm1);
+    } else {
+        c.vpmuludq(xmm0, xmm0, xmm1);
+    }
+    c.vpmovsxdq(xmm0, xmm0);
+    if (pipeline1) {
+        c.vpunpcklqdq(hlo, hlo, xmm0);
+        c.vpblendw(hhi, hhi, xmm0, 0xF0);
+    } else {
+        c.vpunpckhqdq(xmm1, xmm0, xmm0);
+        c.vpblendw(hlo, hlo, xmm0, 0x0F);
+        c.vpblendw(hhi, hhi, xmm1, 0x0F);
+    }
+    if (rd) {
+        HostGpr64 hd = reg_alloc.GetDirtyGpr(rd);
+        c.vmovq(hd, xmm0);
+    }
+}
+
 void mult(u32 rs, u32 rt, u32 rd)
 {
-    Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
-    Xmm hlo = get_dirty_lo(), hhi = get_dirty_hi();
-    c.mov(eax, hs.r32());
-    c.imul(eax, ht.r32());
-    c.movsxd(hd, eax);
-    c.movsxd(rdx, edx);
-    c.vmovq(hlo, hd);
-    c.vmovq(hhi, rdx);
+    emit_mult(rs, rt, rd, true, false);
 }
 
 void mult1(u32 rs, u32 rt, u32 rd)
 {
-    Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
-    Xmm hlo = get_dirty_lo(), hhi = get_dirty_hi();
-    c.mov(eax, hs.r32());
-    c.imul(eax, ht.r32());
-    c.movsxd(hd, eax);
-    c.movsxd(rdx, edx);
-    c.vpinsrq(hlo, hlo, hd, 1);
-    c.vpinsrq(hhi, hhi, rdx, 1);
+    emit_mult(rs, rt, rd, true, true);
 }
 
 void multu(u32 rs, u32 rt, u32 rd)
 {
-    Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
-    Xmm hlo = get_dirty_lo(), hhi = get_dirty_hi();
-    c.mov(eax, hs.r32());
-    c.mul(eax, ht.r32());
-    c.movsxd(hd, eax);
-    c.movsxd(rdx, edx);
-    c.vmovq(hlo, hd);
-    c.vmovq(hhi, rdx);
+    emit_mult(rs, rt, rd, false, false);
 }
 
 void multu1(u32 rs, u32 rt, u32 rd)
 {
-    Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
-    Xmm hlo = get_dirty_lo(), hhi = get_dirty_hi();
-    c.mov(eax, hs.r32());
-    c.mul(eax, ht.r32());
-    c.movsxd(hd, eax);
-    c.movsxd(rdx, edx);
-    c.vpinsrq(hlo, hlo, hd, 1);
-    c.vpinsrq(hhi, hhi, rdx, 1);
+    emit_mult(rs, rt, rd, false, true);
 }
 
 void nor(u32 rs, u32 rt, u32 rd)
@@ -613,8 +660,18 @@ void or_(u32 rs, u32 rt, u32 rd)
     c.or_(hd, ht);
 }
 
-void ori(u32, u32, u16)
+void ori(u32 rs, u32 rt, u16 imm)
 {
+    if (!rt) return;
+    if (std::optional<u64> s = reg_alloc.GetConst(rs)) {
+        reg_alloc.SetConst(rt, *s | imm);
+        return;
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetDirtyGpr(rt);
+    if (rt != rs) {
+        c.mov(ht, hs);
+    }
+    c.or_(ht, imm);
 }
 
 void pref()
@@ -623,11 +680,12 @@ void pref()
 
 void sb(u32 rs, u32 rt, s16 imm)
 {
-    emit_store<1>(rs, rt, imm);
+    EmitStore<u8>(rs, rt, imm);
 }
 
-void sd(u32, u32, s16)
+void sd(u32 rs, u32 rt, s16 imm)
 {
+    EmitStore<u64>(rs, rt, imm);
 }
 
 void sdl(u32, u32, s16)
@@ -638,8 +696,9 @@ void sdr(u32, u32, s16)
 {
 }
 
-void sh(u32, u32, s16)
+void sh(u32 rs, u32 rt, s16 imm)
 {
+    EmitStore<u16>(rs, rt, imm);
 }
 
 void sll(u32 rs, u32 rt, u32 rd)
@@ -676,8 +735,9 @@ void sltu(u32 rs, u32 rt, u32 rd)
     c.and_(hd.r32(), 1);
 }
 
-void sq(u32, u32, s16)
+void sq(u32 rs, u32 rt, s16 imm)
 {
+    EmitStoreQuad(rs, rt, imm);
 }
 
 void sra(u32 rs, u32 rt, u32 rd)
@@ -710,8 +770,9 @@ void subu(u32 rs, u32 rt, u32 rd)
     Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
 }
 
-void sw(u32, u32, s16)
+void sw(u32 rs, u32 rt, s16 imm)
 {
+    EmitStore<u32>(rs, rt, imm);
 }
 
 void swl(u32, u32, s16)
@@ -783,8 +844,18 @@ void xor_(u32 rs, u32 rt, u32 rd)
     Gpq hd = get_dirty_gpr(rd), hs = get_gpr(rs), ht = get_gpr(rt);
 }
 
-void xori(u32, u32, u16)
+void xori(u32 rs, u32 rt, u16 imm)
 {
+    if (!rt) return;
+    if (std::optional<u64> s = reg_alloc.GetConst(rs)) {
+        reg_alloc.SetConst(rt, *s ^ imm);
+        return;
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetDirtyGpr(rt);
+    if (rt != rs) {
+        c.mov(ht, hs);
+    }
+    c.xor_(ht, imm);
 }
 
 } // namespace ee
@@ -1,5 +1,6 @@
 #include "ee.hpp"
 #include "cop0.hpp"
+#include "cop1.hpp"
 #include "exceptions.hpp"
 #include "frontend/message.hpp"
 #include "jit.hpp"
@@ -38,11 +39,15 @@ void init()
     gpr = {};
     lo = {};
     hi = {};
+    fpr = {};
+    fpr_acc = fcr31 = 0;
     jump_addr = pc = 0;
     in_branch_delay_slot_taken = false;
     in_branch_delay_slot_not_taken = false;
 
     reset_exception();
+    init_memory_map();
+    rebuild_vtlb();
 }
 
 bool load_bios(std::filesystem::path const& path)
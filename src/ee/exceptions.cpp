@@ -61,8 +61,10 @@ u32 get_common_vector()
     return cop0.status.bev ? 0xBFC0'0380 : 0x8000'0180;
 }
 
+// Every exception is raised through one of these two; accesses and instructions check exception_occurred to stop short
 void handle_lvl1_exception()
 {
+    exception_occurred = true;
     if (!cop0.status.exl) {
         cop0.status.exl = 1;
         bool in_delay_slot = in_branch_delay_slot_taken | in_branch_delay_slot_not_taken;
@@ -73,6 +75,7 @@ void handle_lvl1_exception()
 
 void handle_lvl2_exception()
 {
+    exception_occurred = true;
     cop0.status.erl = 1;
     bool in_delay_slot = in_branch_delay_slot_taken | in_branch_delay_slot_not_taken;
     cop0.cause.bd2 = in_delay_slot;
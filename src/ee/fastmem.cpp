@@ -0,0 +1,208 @@
+#include "fastmem.hpp"
+#include "mmu.hpp"
+#include "platform.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstring>
+
+namespace ee {
+
+using host_memory::Protection;
+
+struct TlbView {
+    u32 vaddr;
+    u32 size;
+    u32 shm_offset;
+};
+
+static bool MapView(u32 vaddr, u32 shm_offset, u32 size);
+static bool ProtectView(u32 vaddr, u32 shm_offset, u32 size, u32 paddr_lo, u32 paddr_hi, Protection protection);
+static std::optional<u32> ShmOffsetOfPaddr(u32 paddr, u32 size);
+
+constexpr u32 kseg0 = 0x8000'0000;
+constexpr u32 kseg1 = 0xA000'0000;
+constexpr u32 bios_paddr = 0x1FC0'0000;
+constexpr u32 shm_bios_offset = u32(rdram.size()); // RDRAM is at offset 0
+constexpr size_t shm_size = rdram.size() + bios.size();
+constexpr size_t arena_size = 4_GiB;
+constexpr u32 guest_page_size = 0x1000;
+
+static host_memory::SharedMemory guest_memory;
+// Views made for the two pages of each TLB entry. Overlapping entries are undefined behaviour on the guest; here, the
+// entry written last wins, until either entry is rewritten.
+static std::array<std::array<std::optional<TlbView>, 2>, tlb_entries.size()> tlb_views;
+static std::bitset<rdram.size() / guest_page_size> read_only_rdram_pages; // to protect views made later likewise
+
+bool FastmemContains(void const* host_addr)
+{
+    return fastmem_base && size_t(static_cast<u8 const*>(host_addr) - fastmem_base) < arena_size;
+}
+
+bool FastmemIsEnabled()
+{
+    return fastmem_base != nullptr;
+}
+
+Status InitFastmem()
+{
+    if constexpr (!platform.x64) {
+        return UnimplementedStatus("Fastmem is only implemented for x64 hosts");
+    }
+    if (host_memory::page_size() > guest_page_size) {
+        return UnimplementedStatus("Fastmem needs host pages no larger than 0x{:X} bytes", guest_page_size);
+    }
+    Status status = host_memory::create_shared_memory(guest_memory, shm_size);
+    if (!status.Ok()) {
+        return status;
+    }
+    fastmem_base = static_cast<u8*>(host_memory::reserve(arena_size, arena_size));
+    if (!fastmem_base) {
+        host_memory::destroy_shared_memory(guest_memory);
+        return FailureStatus("Failed to reserve the fastmem arena");
+    }
+    // The arrays may already hold guest state (e.g. a loaded BIOS); carry it over before they become views themselves
+    bool success = MapView(kseg0, 0, u32(rdram.size())) && MapView(kseg0 | bios_paddr, shm_bios_offset, bios_size);
+    if (success) {
+        std::memcpy(fastmem_base + kseg0, rdram.data(), rdram.size());
+        std::memcpy(fastmem_base + (kseg0 | bios_paddr), bios.data(), bios.size());
+        success = MapView(kseg1, 0, u32(rdram.size())) && MapView(kseg1 | bios_paddr, shm_bios_offset, bios_size)
+               && host_memory::map_shared_memory(guest_memory, 0, rdram.data(), rdram.size())
+               && host_memory::map_shared_memory(guest_memory, shm_bios_offset, bios.data(), bios.size());
+    }
+    if (!success) {
+        TearDownFastmem();
+        return FailureStatus("Failed to map guest memory into the fastmem arena");
+    }
+    // The BIOS is ROM; stores to it fault, and go through the MMU
+    host_memory::protect(fastmem_base + (kseg0 | bios_paddr), bios_size, Protection::ReadOnly);
+    host_memory::protect(fastmem_base + (kseg1 | bios_paddr), bios_size, Protection::ReadOnly);
+    return OkStatus();
+}
+
+bool MapView(u32 vaddr, u32 shm_offset, u32 size)
+{
+    return host_memory::map_shared_memory(guest_memory, shm_offset, fastmem_base + vaddr, size);
+}
+
+bool ProtectRdram(u32 paddr, u32 size, Protection protection)
+{
+    bool success = host_memory::protect(&rdram[paddr], size, protection);
+    if (!fastmem_base) {
+        return success;
+    }
+    u32 paddr_hi = paddr + size;
+    success &= ProtectView(kseg0, 0, u32(rdram.size()), paddr, paddr_hi, protection);
+    success &= ProtectView(kseg1, 0, u32(rdram.size()), paddr, paddr_hi, protection);
+    for (auto const& entry_views : tlb_views) {
+        for (std::optional<TlbView> const& view : entry_views) {
+            if (view) {
+                success &= ProtectView(view->vaddr, view->shm_offset, view->size, paddr, paddr_hi, protection);
+            }
+        }
+    }
+    for (u32 page = paddr / guest_page_size; page < paddr_hi / guest_page_size; ++page) {
+        read_only_rdram_pages[page] = protection == Protection::ReadOnly;
+    }
+    return success;
+}
+
+// Protects the part of [paddr_lo, paddr_hi) that the view of shm[shm_offset, shm_offset + size) at vaddr shows
+bool ProtectView(u32 vaddr, u32 shm_offset, u32 size, u32 paddr_lo, u32 paddr_hi, Protection protection)
+{
+    u32 lo = std::max(paddr_lo, shm_offset);
+    u32 hi = std::min({ paddr_hi, shm_offset + size, shm_bios_offset });
+    return lo >= hi || host_memory::protect(fastmem_base + vaddr + (lo - shm_offset), hi - lo, protection);
+}
+
+std::optional<u32> RdramOffsetOfHostAddress(void const* host_addr)
+{
+    u8 const* addr = static_cast<u8 const*>(host_addr);
+    if (addr >= rdram.data() && addr < rdram.data() + rdram.size()) {
+        return u32(addr - rdram.data());
+    }
+    if (!FastmemContains(addr)) {
+        return {};
+    }
+    u32 vaddr = u32(addr - fastmem_base);
+    if (vaddr >= kseg0 && vaddr < kseg1 + 0x2000'0000) {
+        u32 paddr = vaddr & 0x1FFF'FFFF;
+        return paddr < rdram.size() ? std::optional<u32>(paddr) : std::nullopt;
+    }
+    for (auto const& entry_views : tlb_views) {
+        for (std::optional<TlbView> const& view : entry_views) {
+            if (view && vaddr - view->vaddr < view->size && view->shm_offset < shm_bios_offset) {
+                return view->shm_offset + (vaddr - view->vaddr);
+            }
+        }
+    }
+    return {};
+}
+
+std::optional<u32> ShmOffsetOfPaddr(u32 paddr, u32 size)
+{
+    if (paddr + size <= rdram.size()) {
+        return paddr;
+    }
+    if (paddr >= bios_paddr && paddr + size <= bios_paddr + bios_size) {
+        return shm_bios_offset + (paddr - bios_paddr);
+    }
+    return {};
+}
+
+void TearDownFastmem()
+{
+    if (fastmem_base) {
+        host_memory::free(fastmem_base, arena_size);
+        fastmem_base = nullptr;
+    }
+    host_memory::destroy_shared_memory(guest_memory);
+    for (auto& entry_views : tlb_views) {
+        entry_views = {};
+    }
+    read_only_rdram_pages.reset();
+}
+
+void UpdateFastmemTlbMapping(u32 index)
+{
+    if (!fastmem_base) {
+        return;
+    }
+    TlbEntry const& entry = tlb_entries[index];
+    for (std::optional<TlbView>& view : tlb_views[index]) {
+        if (view) {
+            host_memory::unmap_shared_memory(fastmem_base + view->vaddr, view->size);
+            view.reset();
+        }
+    }
+    // Entries that are not global translate differently per ASID; those stay with the MMU, as do pages that are
+    // invalid, not writable (stores must raise TLB modification exceptions) or on the scratchpad.
+    if (!entry.hi.g) {
+        return;
+    }
+    u32 page_size = entry.offset_addr_mask + 1;
+    for (u32 i = 0; i < 2; ++i) {
+        auto entry_lo = entry.lo[i];
+        u32 vaddr = entry.vpn2_compare + i * page_size;
+        if (!entry_lo.v || !entry_lo.d || entry_lo.s || (vaddr >= kseg0 && vaddr < kseg1 + 0x2000'0000)) {
+            continue;
+        }
+        std::optional<u32> shm_offset = ShmOffsetOfPaddr(entry_lo.pfn << 12 & ~entry.offset_addr_mask, page_size);
+        if (!shm_offset || !MapView(vaddr, *shm_offset, page_size)) {
+            continue;
+        }
+        tlb_views[index][i] = TlbView{ .vaddr = vaddr, .size = page_size, .shm_offset = *shm_offset };
+        if (*shm_offset >= shm_bios_offset) {
+            host_memory::protect(fastmem_base + vaddr, page_size, Protection::ReadOnly);
+            continue;
+        }
+        for (u32 offset = 0; offset < page_size; offset += guest_page_size) {
+            if (read_only_rdram_pages[(*shm_offset + offset) / guest_page_size]) {
+                host_memory::protect(fastmem_base + vaddr + offset, guest_page_size, Protection::ReadOnly);
+            }
+        }
+    }
+}
+
+} // namespace ee
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "host_memory.hpp"
+#include "numtypes.hpp"
+#include "status.hpp"
+
+#include <optional>
+
+namespace ee {
+
+// Fastmem mirrors the 32-bit guest virtual address space into 4 GiB of host address space, aligned to 4 GiB, so that
+// JIT code reaches guest memory at fastmem_base + vaddr with a single host instruction. RDRAM and the BIOS live in
+// shared memory, which also backs the rdram and bios arrays, and are mapped into the arena at kseg0 and kseg1, and
+// wherever a global TLB entry maps them. Everything else (IO, the scratchpad, pages that only the MMU can translate
+// correctly) is left inaccessible; accesses there fault, and the JIT turns them into calls to the MMU.
+inline u8* fastmem_base; // null if fastmem is not in use
+
+bool FastmemContains(void const* host_addr);
+bool FastmemIsEnabled();
+Status InitFastmem();
+// Changes the protection of an RDRAM range in every view of it, or only in the rdram array if fastmem is not in use.
+// The range must be aligned to the host page size. Returns false if any view could not be changed.
+bool ProtectRdram(u32 paddr, u32 size, host_memory::Protection protection);
+// The RDRAM offset that a host address within any view of RDRAM refers to. Safe to call from a fault handler.
+std::optional<u32> RdramOffsetOfHostAddress(void const* host_addr);
+// The arrays keep their contents, and stay usable.
+void TearDownFastmem();
+// Call after TLB entry 'index' has been written.
+void UpdateFastmemTlbMapping(u32 index);
+
+} // namespace ee
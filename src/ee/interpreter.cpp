@@ -0,0 +1,878 @@
+#include "interpreter.hpp"
+#include "cop0.hpp"
+#include "ee.hpp"
+#include "exceptions.hpp"
+#include "jit.hpp"
+#include "mips/decoder.hpp"
+#include "mmu.hpp"
+
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace ee::interpreter {
+
+enum class Branch {
+    None,
+    Taken,
+    NotTaken,
+    LikelyNotTaken, // the delay slot is skipped
+};
+
+static void branch(bool cond, s16 imm);
+static void branch_likely(bool cond, s16 imm);
+static u32 effective_address(u32 rs, s16 imm);
+static bool exception_raised();
+static u64 get_gpr(u32 idx);
+static void jump(u32 target);
+template<typename Int> static void load(u32 rs, u32 rt, s16 imm);
+static void set_gpr(u32 idx, u64 value);
+static void set_lo_hi(s64 lo_value, s64 hi_value);
+template<typename UInt> static void store(u32 addr, UInt value);
+
+static Branch branch_taken;
+static u32 instr_pc;
+static bool jit_only_instruction_reached;
+
+void add(u32 rs, u32 rt, u32 rd)
+{
+    s64 sum = s64(s32(get_gpr(rs))) + s32(get_gpr(rt));
+    if (sum != s32(sum)) {
+        integer_overflow_exception();
+    } else {
+        set_gpr(rd, sum);
+    }
+}
+
+void addi(u32 rs, u32 rt, s16 imm)
+{
+    s64 sum = s64(s32(get_gpr(rs))) + imm;
+    if (sum != s32(sum)) {
+        integer_overflow_exception();
+    } else {
+        set_gpr(rt, sum);
+    }
+}
+
+void addiu(u32 rs, u32 rt, s16 imm)
+{
+    set_gpr(rt, s32(u32(get_gpr(rs)) + imm));
+}
+
+void addu(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s32(u32(get_gpr(rs)) + u32(get_gpr(rt))));
+}
+
+void and_(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rs) & get_gpr(rt));
+}
+
+void andi(u32 rs, u32 rt, u16 imm)
+{
+    set_gpr(rt, get_gpr(rs) & imm);
+}
+
+void beq(u32 rs, u32 rt, s16 imm)
+{
+    branch(get_gpr(rs) == get_gpr(rt), imm);
+}
+
+void beql(u32 rs, u32 rt, s16 imm)
+{
+    branch_likely(get_gpr(rs) == get_gpr(rt), imm);
+}
+
+void bgez(u32 rs, s16 imm)
+{
+    branch(s64(get_gpr(rs)) >= 0, imm);
+}
+
+void bgezal(u32 rs, s16 imm)
+{
+    bool cond = s64(get_gpr(rs)) >= 0;
+    set_gpr(31, pc + 4);
+    branch(cond, imm);
+}
+
+void bgezall(u32 rs, s16 imm)
+{
+    bool cond = s64(get_gpr(rs)) >= 0;
+    set_gpr(31, pc + 4);
+    branch_likely(cond, imm);
+}
+
+void bgezl(u32 rs, s16 imm)
+{
+    branch_likely(s64(get_gpr(rs)) >= 0, imm);
+}
+
+void bgtz(u32 rs, s16 imm)
+{
+    branch(s64(get_gpr(rs)) > 0, imm);
+}
+
+void bgtzl(u32 rs, s16 imm)
+{
+    branch_likely(s64(get_gpr(rs)) > 0, imm);
+}
+
+void blez(u32 rs, s16 imm)
+{
+    branch(s64(get_gpr(rs)) <= 0, imm);
+}
+
+void blezl(u32 rs, s16 imm)
+{
+    branch_likely(s64(get_gpr(rs)) <= 0, imm);
+}
+
+void bltz(u32 rs, s16 imm)
+{
+    branch(s64(get_gpr(rs)) < 0, imm);
+}
+
+void bltzal(u32 rs, s16 imm)
+{
+    bool cond = s64(get_gpr(rs)) < 0;
+    set_gpr(31, pc + 4);
+    branch(cond, imm);
+}
+
+void bltzall(u32 rs, s16 imm)
+{
+    bool cond = s64(get_gpr(rs)) < 0;
+    set_gpr(31, pc + 4);
+    branch_likely(cond, imm);
+}
+
+void bltzl(u32 rs, s16 imm)
+{
+    branch_likely(s64(get_gpr(rs)) < 0, imm);
+}
+
+void bne(u32 rs, u32 rt, s16 imm)
+{
+    branch(get_gpr(rs) != get_gpr(rt), imm);
+}
+
+void bnel(u32 rs, u32 rt, s16 imm)
+{
+    branch_likely(get_gpr(rs) != get_gpr(rt), imm);
+}
+
+// pc points to the delay slot when a branch is executed
+void branch(bool cond, s16 imm)
+{
+    if (cond) {
+        jump(pc + (s32(imm) << 2));
+    } else {
+        branch_taken = Branch::NotTaken;
+    }
+}
+
+void branch_likely(bool cond, s16 imm)
+{
+    if (cond) {
+        jump(pc + (s32(imm) << 2));
+    } else {
+        branch_taken = Branch::LikelyNotTaken;
+    }
+}
+
+void break_()
+{
+    breakpoint_exception();
+}
+
+void cache()
+{
+}
+
+void dadd(u32 rs, u32 rt, u32 rd)
+{
+    u64 a = get_gpr(rs), b = get_gpr(rt), sum = a + b;
+    if ((~(a ^ b) & (a ^ sum)) >> 63) {
+        integer_overflow_exception();
+    } else {
+        set_gpr(rd, sum);
+    }
+}
+
+void daddi(u32 rs, u32 rt, s16 imm)
+{
+    u64 a = get_gpr(rs), b = u64(s64(imm)), sum = a + b;
+    if ((~(a ^ b) & (a ^ sum)) >> 63) {
+        integer_overflow_exception();
+    } else {
+        set_gpr(rt, sum);
+    }
+}
+
+void daddiu(u32 rs, u32 rt, s16 imm)
+{
+    set_gpr(rt, get_gpr(rs) + s64(imm));
+}
+
+void daddu(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rs) + get_gpr(rt));
+}
+
+void di()
+{
+    ee::di();
+}
+
+void div(u32 rs, u32 rt)
+{
+    s32 dividend = s32(get_gpr(rs)), divisor = s32(get_gpr(rt));
+    if (divisor == 0) {
+        set_lo_hi(dividend < 0 ? 1 : -1, dividend);
+    } else if (dividend == std::numeric_limits<s32>::min() && divisor == -1) {
+        set_lo_hi(dividend, 0);
+    } else {
+        set_lo_hi(dividend / divisor, dividend % divisor);
+    }
+}
+
+void divu(u32 rs, u32 rt)
+{
+    u32 dividend = u32(get_gpr(rs)), divisor = u32(get_gpr(rt));
+    if (divisor == 0) {
+        set_lo_hi(-1, s32(dividend));
+    } else {
+        set_lo_hi(s32(dividend / divisor), s32(dividend % divisor));
+    }
+}
+
+void dsll(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, get_gpr(rt) << sa);
+}
+
+void dsll32(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, get_gpr(rt) << (sa + 32));
+}
+
+void dsllv(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rt) << (get_gpr(rs) & 63));
+}
+
+void dsra(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, s64(get_gpr(rt)) >> sa);
+}
+
+void dsra32(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, s64(get_gpr(rt)) >> (sa + 32));
+}
+
+void dsrav(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s64(get_gpr(rt)) >> (get_gpr(rs) & 63));
+}
+
+void dsrl(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, get_gpr(rt) >> sa);
+}
+
+void dsrl32(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, get_gpr(rt) >> (sa + 32));
+}
+
+void dsrlv(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rt) >> (get_gpr(rs) & 63));
+}
+
+void dsub(u32 rs, u32 rt, u32 rd)
+{
+    u64 a = get_gpr(rs), b = get_gpr(rt), diff = a - b;
+    if (((a ^ b) & (a ^ diff)) >> 63) {
+        integer_overflow_exception();
+    } else {
+        set_gpr(rd, diff);
+    }
+}
+
+void dsubu(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rs) - get_gpr(rt));
+}
+
+u32 effective_address(u32 rs, s16 imm)
+{
+    return u32(get_gpr(rs)) + imm;
+}
+
+void ei()
+{
+    ee::ei();
+}
+
+void eret()
+{
+    ee::eret(); // changes pc, which ends the block
+}
+
+// The exception handlers redirect pc to the exception vector
+bool exception_raised()
+{
+    return exception_occurred || pc != instr_pc + 4;
+}
+
+u64 get_gpr(u32 idx)
+{
+    u64 value;
+    std::memcpy(&value, &gpr[idx], sizeof(value));
+    return value;
+}
+
+void j(u32 imm26)
+{
+    jump((pc & 0xF000'0000) | imm26 << 2);
+}
+
+void jal(u32 imm26)
+{
+    set_gpr(31, pc + 4);
+    j(imm26);
+}
+
+void jalr(u32 rs, u32 rd)
+{
+    u32 target = u32(get_gpr(rs));
+    set_gpr(rd, pc + 4);
+    jump(target);
+}
+
+void jit_only_instruction()
+{
+    jit_only_instruction_reached = true;
+}
+
+void jr(u32 rs)
+{
+    jump(u32(get_gpr(rs)));
+}
+
+void jump(u32 target)
+{
+    jump_addr = target;
+    branch_taken = Branch::Taken;
+}
+
+void lb(u32 rs, u32 rt, s16 imm)
+{
+    load<s8>(rs, rt, imm);
+}
+
+void lbu(u32 rs, u32 rt, s16 imm)
+{
+    load<u8>(rs, rt, imm);
+}
+
+void ld(u32 rs, u32 rt, s16 imm)
+{
+    load<u64>(rs, rt, imm);
+}
+
+void ldl(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 7) * 8;
+    u64 dword = virtual_read<u64>(addr & ~7);
+    if (!exception_raised()) {
+        set_gpr(rt, (get_gpr(rt) & 0x00FF'FFFF'FFFF'FFFF >> shift) | dword << (56 - shift));
+    }
+}
+
+void ldr(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 7) * 8;
+    u64 dword = virtual_read<u64>(addr & ~7);
+    if (!exception_raised()) {
+        set_gpr(rt, (get_gpr(rt) & ~(~u64(0) >> shift)) | dword >> shift);
+    }
+}
+
+void lh(u32 rs, u32 rt, s16 imm)
+{
+    load<s16>(rs, rt, imm);
+}
+
+void lhu(u32 rs, u32 rt, s16 imm)
+{
+    load<u16>(rs, rt, imm);
+}
+
+template<typename Int> void load(u32 rs, u32 rt, s16 imm)
+{
+    auto value = virtual_read<std::make_unsigned_t<Int>>(effective_address(rs, imm));
+    if (!exception_raised()) {
+        set_gpr(rt, s64(Int(value)));
+    }
+}
+
+void lq(u32 rs, u32 rt, s16 imm)
+{
+    u128 value = virtual_read<u128>(effective_address(rs, imm) & ~15);
+    if (!exception_raised() && rt) {
+        gpr[rt] = value;
+    }
+}
+
+void lui(u32 rt, s16 imm)
+{
+    set_gpr(rt, s32(u32(u16(imm)) << 16));
+}
+
+void lw(u32 rs, u32 rt, s16 imm)
+{
+    load<s32>(rs, rt, imm);
+}
+
+void lwl(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 3) * 8;
+    u32 word = virtual_read<u32>(addr & ~3);
+    if (!exception_raised()) {
+        set_gpr(rt, s32((u32(get_gpr(rt)) & 0x00FF'FFFF >> shift) | word << (24 - shift)));
+    }
+}
+
+void lwr(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 3) * 8;
+    u32 word = virtual_read<u32>(addr & ~3);
+    if (!exception_raised()) {
+        u32 merged = (u32(get_gpr(rt)) & ~(0xFFFF'FFFF >> shift)) | word >> shift;
+        if (shift == 0) {
+            set_gpr(rt, s32(merged));
+        } else {
+            set_gpr(rt, (get_gpr(rt) & 0xFFFF'FFFF'0000'0000) | merged); // the upper word is left as is
+        }
+    }
+}
+
+void lwu(u32 rs, u32 rt, s16 imm)
+{
+    load<u32>(rs, rt, imm);
+}
+
+void mfc0(u32 rd, u32 rt)
+{
+    set_gpr(rt, s32(cop0.get(int(rd))));
+}
+
+void mfhi(u32 rd)
+{
+    u64 value;
+    std::memcpy(&value, &hi, sizeof(value));
+    set_gpr(rd, value);
+}
+
+void mflo(u32 rd)
+{
+    u64 value;
+    std::memcpy(&value, &lo, sizeof(value));
+    set_gpr(rd, value);
+}
+
+void mfsa(u32 rd)
+{
+    set_gpr(rd, sa);
+}
+
+void movn(u32 rs, u32 rt, u32 rd)
+{
+    if (get_gpr(rt) != 0) {
+        set_gpr(rd, get_gpr(rs));
+    }
+}
+
+void movz(u32 rs, u32 rt, u32 rd)
+{
+    if (get_gpr(rt) == 0) {
+        set_gpr(rd, get_gpr(rs));
+    }
+}
+
+void mtc0(u32 rd, u32 rt)
+{
+    cop0.set(int(rd), u32(get_gpr(rt)));
+}
+
+void mthi(u32 rs)
+{
+    u64 value = get_gpr(rs);
+    std::memcpy(&hi, &value, sizeof(value));
+}
+
+void mtlo(u32 rs)
+{
+    u64 value = get_gpr(rs);
+    std::memcpy(&lo, &value, sizeof(value));
+}
+
+void mtsa(u32 rs)
+{
+    sa = u32(get_gpr(rs));
+}
+
+void mtsab(u32 rs, s16 imm)
+{
+    sa = ((u32(get_gpr(rs)) ^ u32(imm)) & 15) << 3;
+}
+
+void mtsah(u32 rs, s16 imm)
+{
+    sa = ((u32(get_gpr(rs)) ^ u32(imm)) & 7) << 4;
+}
+
+void mult(u32 rs, u32 rt, u32 rd)
+{
+    s64 product = s64(s32(get_gpr(rs))) * s32(get_gpr(rt));
+    set_lo_hi(s32(product), s32(product >> 32));
+    set_gpr(rd, s32(product));
+}
+
+void multu(u32 rs, u32 rt, u32 rd)
+{
+    u64 product = u64(u32(get_gpr(rs))) * u32(get_gpr(rt));
+    set_lo_hi(s32(product), s32(product >> 32));
+    set_gpr(rd, s32(product));
+}
+
+void nor(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, ~(get_gpr(rs) | get_gpr(rt)));
+}
+
+void or_(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rs) | get_gpr(rt));
+}
+
+void ori(u32 rs, u32 rt, u16 imm)
+{
+    set_gpr(rt, get_gpr(rs) | imm);
+}
+
+void pref()
+{
+}
+
+BlockRun run_block()
+{
+    BlockRun run{};
+    bool in_delay_slot = false, delay_slot_taken = false;
+    if (branch_state == mips::BranchState::Perform) {
+        // The block before was compiled, and ended on a taken branch whose delay slot did not fit in it
+        branch_state = mips::BranchState::NoBranch;
+        in_delay_slot = delay_slot_taken = true;
+    }
+    do {
+        branch_taken = Branch::None;
+        jit_only_instruction_reached = exception_occurred = false;
+        in_branch_delay_slot_taken = in_delay_slot && delay_slot_taken;
+        in_branch_delay_slot_not_taken = in_delay_slot && !delay_slot_taken;
+        instr_pc = pc;
+        u32 instr = virtual_read<u32, Alignment::Aligned, MemOp::InstrFetch>(pc);
+        if (exception_occurred || pc != instr_pc) {
+            break;
+        }
+        pc += 4;
+        mips::decode_ee_interpreter(instr);
+        if (jit_only_instruction_reached) {
+            // Leave the branch state as the JIT would have when ending a block right before this instruction
+            pc = instr_pc;
+            if (in_delay_slot && delay_slot_taken) {
+                branch_state = mips::BranchState::Perform;
+            }
+            run.reached_jit_only_instruction = true;
+            return run;
+        }
+        run.instructions++;
+        advance_pipeline(1);
+        if (exception_raised()) {
+            break;
+        }
+        if (in_delay_slot) {
+            if (delay_slot_taken) {
+                pc = jump_addr;
+                if (pc & 3) {
+                    address_error_exception(pc, MemOp::InstrFetch);
+                }
+            }
+            break;
+        }
+        if (branch_taken == Branch::LikelyNotTaken) {
+            pc += 4;
+            break;
+        }
+        in_delay_slot = branch_taken != Branch::None;
+        delay_slot_taken = branch_taken == Branch::Taken;
+    } while (in_delay_slot || (pc & 255));
+    in_branch_delay_slot_taken = in_branch_delay_slot_not_taken = false;
+    return run;
+}
+
+void sb(u32 rs, u32 rt, s16 imm)
+{
+    store(effective_address(rs, imm), u8(get_gpr(rt)));
+}
+
+void sd(u32 rs, u32 rt, s16 imm)
+{
+    store(effective_address(rs, imm), get_gpr(rt));
+}
+
+void sdl(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 7) * 8;
+    u64 dword = virtual_read<u64>(addr & ~7);
+    if (!exception_raised()) {
+        store(addr & ~7, get_gpr(rt) >> (56 - shift) | (dword & ~(~u64(0) >> (56 - shift))));
+    }
+}
+
+void sdr(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 7) * 8;
+    u64 dword = virtual_read<u64>(addr & ~7);
+    if (!exception_raised()) {
+        store(addr & ~7, get_gpr(rt) << shift | (dword & ~(~u64(0) << shift)));
+    }
+}
+
+void set_gpr(u32 idx, u64 value)
+{
+    if (idx) {
+        std::memcpy(&gpr[idx], &value, sizeof(value)); // the upper doubleword is left as is
+    }
+}
+
+void set_lo_hi(s64 lo_value, s64 hi_value)
+{
+    std::memcpy(&lo, &lo_value, sizeof(lo_value));
+    std::memcpy(&hi, &hi_value, sizeof(hi_value));
+}
+
+void sh(u32 rs, u32 rt, s16 imm)
+{
+    store(effective_address(rs, imm), u16(get_gpr(rt)));
+}
+
+void sll(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, s32(u32(get_gpr(rt)) << sa));
+}
+
+void sllv(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s32(u32(get_gpr(rt)) << (get_gpr(rs) & 31)));
+}
+
+void slt(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s64(get_gpr(rs)) < s64(get_gpr(rt)));
+}
+
+void slti(u32 rs, u32 rt, s16 imm)
+{
+    set_gpr(rt, s64(get_gpr(rs)) < imm);
+}
+
+void sltiu(u32 rs, u32 rt, s16 imm)
+{
+    set_gpr(rt, get_gpr(rs) < u64(s64(imm)));
+}
+
+void sltu(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rs) < get_gpr(rt));
+}
+
+void sq(u32 rs, u32 rt, s16 imm)
+{
+    store(effective_address(rs, imm) & ~15, gpr[rt]);
+}
+
+void sra(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, s32(get_gpr(rt)) >> sa);
+}
+
+void srav(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s32(get_gpr(rt)) >> (get_gpr(rs) & 31));
+}
+
+void srl(u32 rt, u32 rd, u32 sa)
+{
+    set_gpr(rd, s32(u32(get_gpr(rt)) >> sa));
+}
+
+void srlv(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s32(u32(get_gpr(rt)) >> (get_gpr(rs) & 31)));
+}
+
+template<typename UInt> void store(u32 addr, UInt value)
+{
+    virtual_write(addr, value);
+}
+
+void sub(u32 rs, u32 rt, u32 rd)
+{
+    s64 diff = s64(s32(get_gpr(rs))) - s32(get_gpr(rt));
+    if (diff != s32(diff)) {
+        integer_overflow_exception();
+    } else {
+        set_gpr(rd, diff);
+    }
+}
+
+void subu(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, s32(u32(get_gpr(rs)) - u32(get_gpr(rt))));
+}
+
+void sw(u32 rs, u32 rt, s16 imm)
+{
+    store(effective_address(rs, imm), u32(get_gpr(rt)));
+}
+
+void swl(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 3) * 8;
+    u32 word = virtual_read<u32>(addr & ~3);
+    if (!exception_raised()) {
+        store(addr & ~3, u32(get_gpr(rt)) >> (24 - shift) | (word & ~(0xFFFF'FFFF >> (24 - shift))));
+    }
+}
+
+void swr(u32 rs, u32 rt, s16 imm)
+{
+    u32 addr = effective_address(rs, imm);
+    u32 shift = (addr & 3) * 8;
+    u32 word = virtual_read<u32>(addr & ~3);
+    if (!exception_raised()) {
+        store(addr & ~3, u32(get_gpr(rt)) << shift | (word & ~(0xFFFF'FFFF << shift)));
+    }
+}
+
+void sync()
+{
+}
+
+void syscall()
+{
+    syscall_exception();
+}
+
+void teq(u32 rs, u32 rt)
+{
+    if (get_gpr(rs) == get_gpr(rt)) trap_exception();
+}
+
+void teqi(u32 rs, s16 imm)
+{
+    if (s64(get_gpr(rs)) == imm) trap_exception();
+}
+
+void tge(u32 rs, u32 rt)
+{
+    if (s64(get_gpr(rs)) >= s64(get_gpr(rt))) trap_exception();
+}
+
+void tgei(u32 rs, s16 imm)
+{
+    if (s64(get_gpr(rs)) >= imm) trap_exception();
+}
+
+void tgeiu(u32 rs, s16 imm)
+{
+    if (get_gpr(rs) >= u64(s64(imm))) trap_exception();
+}
+
+void tgeu(u32 rs, u32 rt)
+{
+    if (get_gpr(rs) >= get_gpr(rt)) trap_exception();
+}
+
+void tlbp()
+{
+    ee::tlbp();
+}
+
+void tlbr()
+{
+    ee::tlbr();
+}
+
+void tlbwi()
+{
+    ee::tlbwi();
+}
+
+void tlbwr()
+{
+    ee::tlbwr();
+}
+
+void tlt(u32 rs, u32 rt)
+{
+    if (s64(get_gpr(rs)) < s64(get_gpr(rt))) trap_exception();
+}
+
+void tlti(u32 rs, s16 imm)
+{
+    if (s64(get_gpr(rs)) < imm) trap_exception();
+}
+
+void tltiu(u32 rs, s16 imm)
+{
+    if (get_gpr(rs) < u64(s64(imm))) trap_exception();
+}
+
+void tltu(u32 rs, u32 rt)
+{
+    if (get_gpr(rs) < get_gpr(rt)) trap_exception();
+}
+
+void tne(u32 rs, u32 rt)
+{
+    if (get_gpr(rs) != get_gpr(rt)) trap_exception();
+}
+
+void tnei(u32 rs, s16 imm)
+{
+    if (s64(get_gpr(rs)) != imm) trap_exception();
+}
+
+void xor_(u32 rs, u32 rt, u32 rd)
+{
+    set_gpr(rd, get_gpr(rs) ^ get_gpr(rt));
+}
+
+void xori(u32 rs, u32 rt, u16 imm)
+{
+    set_gpr(rt, get_gpr(rs) ^ imm);
+}
+
+} // namespace ee::interpreter
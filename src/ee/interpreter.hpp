@@ -0,0 +1,144 @@
+#pragma once
+
+#include "numtypes.hpp"
+
+// The cold tier of the EE: blocks run here until they have executed often enough to be worth compiling. Instructions
+// are decoded through mips::decode_ee_interpreter, which shares the decoder with the JIT. The interpreter covers the
+// integer instructions and COP0; a block that contains anything else (COP1, COP2, MMI) is handed over to the JIT.
+namespace ee::interpreter {
+
+struct BlockRun {
+    u32 instructions;
+    bool reached_jit_only_instruction; // pc points to it; the block from there on must be compiled
+};
+
+// Runs the block at pc: up to and including a branch delay slot, an exception, or the end of the 256-byte pool the
+// block starts in. A block compiled by the JIT from the same pc may go on past its pool, or past jumps (see
+// IsWithinBlockSpan), so the two tiers do not enter the same blocks; they leave the same state between blocks.
+BlockRun run_block();
+
+// Called by the decoder for instructions that only the JIT implements. Has no effect on the guest.
+void jit_only_instruction();
+
+void add(u32 rs, u32 rt, u32 rd);
+void addi(u32 rs, u32 rt, s16 imm);
+void addiu(u32 rs, u32 rt, s16 imm);
+void addu(u32 rs, u32 rt, u32 rd);
+void and_(u32 rs, u32 rt, u32 rd);
+void andi(u32 rs, u32 rt, u16 imm);
+void beq(u32 rs, u32 rt, s16 imm);
+void beql(u32 rs, u32 rt, s16 imm);
+void bgez(u32 rs, s16 imm);
+void bgezal(u32 rs, s16 imm);
+void bgezall(u32 rs, s16 imm);
+void bgezl(u32 rs, s16 imm);
+void bgtz(u32 rs, s16 imm);
+void bgtzl(u32 rs, s16 imm);
+void blez(u32 rs, s16 imm);
+void blezl(u32 rs, s16 imm);
+void bltz(u32 rs, s16 imm);
+void bltzal(u32 rs, s16 imm);
+void bltzall(u32 rs, s16 imm);
+void bltzl(u32 rs, s16 imm);
+void bne(u32 rs, u32 rt, s16 imm);
+void bnel(u32 rs, u32 rt, s16 imm);
+void break_();
+void cache();
+void dadd(u32 rs, u32 rt, u32 rd);
+void daddi(u32 rs, u32 rt, s16 imm);
+void daddiu(u32 rs, u32 rt, s16 imm);
+void daddu(u32 rs, u32 rt, u32 rd);
+void di();
+void div(u32 rs, u32 rt);
+void divu(u32 rs, u32 rt);
+void dsll(u32 rt, u32 rd, u32 sa);
+void dsll32(u32 rt, u32 rd, u32 sa);
+void dsllv(u32 rs, u32 rt, u32 rd);
+void dsra(u32 rt, u32 rd, u32 sa);
+void dsra32(u32 rt, u32 rd, u32 sa);
+void dsrav(u32 rs, u32 rt, u32 rd);
+void dsrl(u32 rt, u32 rd, u32 sa);
+void dsrl32(u32 rt, u32 rd, u32 sa);
+void dsrlv(u32 rs, u32 rt, u32 rd);
+void dsub(u32 rs, u32 rt, u32 rd);
+void dsubu(u32 rs, u32 rt, u32 rd);
+void ei();
+void eret();
+void j(u32 imm26);
+void jal(u32 imm26);
+void jalr(u32 rs, u32 rd);
+void jr(u32 rs);
+void lb(u32 rs, u32 rt, s16 imm);
+void lbu(u32 rs, u32 rt, s16 imm);
+void ld(u32 rs, u32 rt, s16 imm);
+void ldl(u32 rs, u32 rt, s16 imm);
+void ldr(u32 rs, u32 rt, s16 imm);
+void lh(u32 rs, u32 rt, s16 imm);
+void lhu(u32 rs, u32 rt, s16 imm);
+void lq(u32 rs, u32 rt, s16 imm);
+void lui(u32 rt, s16 imm);
+void lw(u32 rs, u32 rt, s16 imm);
+void lwl(u32 rs, u32 rt, s16 imm);
+void lwr(u32 rs, u32 rt, s16 imm);
+void lwu(u32 rs, u32 rt, s16 imm);
+void mfc0(u32 rd, u32 rt);
+void mfhi(u32 rd);
+void mflo(u32 rd);
+void mfsa(u32 rd);
+void movn(u32 rs, u32 rt, u32 rd);
+void movz(u32 rs, u32 rt, u32 rd);
+void mtc0(u32 rd, u32 rt);
+void mthi(u32 rs);
+void mtlo(u32 rs);
+void mtsa(u32 rs);
+void mtsab(u32 rs, s16 imm);
+void mtsah(u32 rs, s16 imm);
+void mult(u32 rs, u32 rt, u32 rd);
+void multu(u32 rs, u32 rt, u32 rd);
+void nor(u32 rs, u32 rt, u32 rd);
+void or_(u32 rs, u32 rt, u32 rd);
+void ori(u32 rs, u32 rt, u16 imm);
+void pref();
+void sb(u32 rs, u32 rt, s16 imm);
+void sd(u32 rs, u32 rt, s16 imm);
+void sdl(u32 rs, u32 rt, s16 imm);
+void sdr(u32 rs, u32 rt, s16 imm);
+void sh(u32 rs, u32 rt, s16 imm);
+void sll(u32 rt, u32 rd, u32 sa);
+void sllv(u32 rs, u32 rt, u32 rd);
+void slt(u32 rs, u32 rt, u32 rd);
+void slti(u32 rs, u32 rt, s16 imm);
+void sltiu(u32 rs, u32 rt, s16 imm);
+void sltu(u32 rs, u32 rt, u32 rd);
+void sq(u32 rs, u32 rt, s16 imm);
+void sra(u32 rt, u32 rd, u32 sa);
+void srav(u32 rs, u32 rt, u32 rd);
+void srl(u32 rt, u32 rd, u32 sa);
+void srlv(u32 rs, u32 rt, u32 rd);
+void sub(u32 rs, u32 rt, u32 rd);
+void subu(u32 rs, u32 rt, u32 rd);
+void sw(u32 rs, u32 rt, s16 imm);
+void swl(u32 rs, u32 rt, s16 imm);
+void swr(u32 rs, u32 rt, s16 imm);
+void sync();
+void syscall();
+void teq(u32 rs, u32 rt);
+void teqi(u32 rs, s16 imm);
+void tge(u32 rs, u32 rt);
+void tgei(u32 rs, s16 imm);
+void tgeiu(u32 rs, s16 imm);
+void tgeu(u32 rs, u32 rt);
+void tlbp();
+void tlbr();
+void tlbwi();
+void tlbwr();
+void tlt(u32 rs, u32 rt);
+void tlti(u32 rs, s16 imm);
+void tltiu(u32 rs, s16 imm);
+void tltu(u32 rs, u32 rt);
+void tne(u32 rs, u32 rt);
+void tnei(u32 rs, s16 imm);
+void xor_(u32 rs, u32 rt, u32 rd);
+void xori(u32 rs, u32 rt, u16 imm);
+
+} // namespace ee::interpreter
@@ -2,22 +2,51 @@
 #include "asmjit/arm/a64compiler.h"
 #include "asmjit/core/codeholder.h"
 #include "asmjit/core/jitruntime.h"
+#include "asmjit/x86/x86assembler.h"
 #include "asmjit/x86/x86compiler.h"
 #include "build_options.hpp"
 #include "bump_allocator.hpp"
+#include "code_cache.hpp"
 #include "cop0.hpp"
 #include "ee.hpp"
 #include "exceptions.hpp"
+#include "fastmem.hpp"
+#include "host_memory.hpp"
+#include "interpreter.hpp"
 #include "jit_common.hpp"
+#include "jit_disk_cache.hpp"
+#include "jit_ir.hpp"
+#include "jit_perf.hpp"
+#include "jit_profiler.hpp"
 #include "log.hpp"
 #include "mips/decoder.hpp"
 #include "mips/types.hpp"
+#include "mmi.hpp"
 #include "mmu.hpp"
+#include "scheduler.hpp"
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bit>
 #include <cassert>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -38,21 +67,199 @@ struct Pool {
     std::array<Block, instructions_per_pool> blocks;
 };
 
-static void compile(Block& block);
+// A block exit with a successor known at compile time jumps through one of these. While unlinked, host_target points
+// to LinkBlock, which looks up (or compiles) the successor and stores its entry here, so that later executions of the
+// exit jump straight into the successor without going through the dispatcher. Links are embedded in the code cache
+// right after the code of the block they belong to, so that they are evicted together with it.
+struct BlockLink {
+    Block host_target;
+    u32 guest_paddr;
+};
+
+struct CompiledBlock {
+    Block block;
+    u32 paddr;
+};
+
+// A block handed to a compile worker. The worker compiles it from a copy of the guest instructions taken when it was
+// queued, and the EE thread installs it only if the instructions are still the same by then.
+struct CompileJob {
+    asmjit::CodeHolder code;
+    std::vector<u32> instructions; // from paddr up to the furthest a block there may span
+    std::vector<u32> link_offsets;
+    std::vector<u32> fastmem_offsets;
+    u64 epoch; // InvalidateAll discards the jobs queued before it
+    u32 paddr;
+    u32 vaddr;
+    u32 num_instructions; // compiled
+    bool ok;
+};
+
+struct PendingLink {
+    Label label;
+    u32 guest_paddr;
+};
+
+// A guest memory access made directly through the fastmem arena, and the MMU call it is patched into should it fault
+struct FastmemAccess {
+    Label access;
+    Label slow_path;
+};
+
+// A call made by a block, which a return to guest_vaddr is predicted to go back from; see EmitReturnStackPush
+struct ReturnStackEntry {
+    BlockLink* link; // to the block at guest_vaddr, embedded with the calling block
+    u32 guest_vaddr;
+};
+
+// The state of the block at a guest memory access, which the code of its MMU call depends on; see EmitMemorySlowPath
+struct AccessSite {
+    Label exception_exit; // see NewExceptionExit
+    u32 pc;
+    bool may_raise_exception;
+    bool in_delay_slot;
+    bool stack_is_aligned_for_call;
+};
+
+// The code shared by the exits of a block for the exception handler that are taken with the same state of the register
+// allocator, emitted past the code of the block. Each entry passes the cycles to charge the block with in eax.
+struct ExceptionExitStub {
+    RegisterAllocator::ExitState state;
+    std::vector<std::pair<u32, Label>> entries; // block cycles => entry
+};
+
+template<typename Emitter> static void BeginBlockFunction(Emitter& emitter);
+static void BlockEpilogWithLink(u32 target, u32 dead_gprs = 0);
+static bool BranchDecidedAfterDelaySlot(IrInst const& branch);
+static bool CanLinkTo(u32 target);
+static Block compile(u32 paddr);
+static bool CompilesDelaySlotInPlace(size_t index);
+static AccessSite CurrentAccessSite(bool may_raise_exception);
+static void EmitBranchBookkeeping(IrInst const& branch);
+static x86::CondCode EmitBranchCompare(IrInst const& branch);
+static void EmitCallPreservingRegisters(auto func, auto emit_args, bool stack_is_aligned_for_call);
+static void EmitColdPaths();
+template<typename Int> static bool EmitConstAddressLoad(u32 vaddr, u32 rt);
+template<std::unsigned_integral UInt> static bool EmitConstAddressStore(u32 vaddr, u32 rt);
+static void EmitDirectBranchExit(u32 target, u32 dead_gprs);
+static Status EmitDispatcher();
+static void EmitDynamicBranch(IrInst const& branch);
+static void EmitDynamicBranchExit(IrInst const& branch);
+static void EmitFastmemAccess(u32 size, Label l_slow_path, Label l_done, auto emit_access);
 static void EmitInstruction();
+static void EmitIoHandlerCall(auto handler, u32 vaddr, HostGpr64 const* store_value);
+static void EmitMemoryAccessCall(auto func, HostGpr64 const* store_value, AccessSite const& site);
+static void EmitMemorySlowPath(Label l_slow_path, Label l_done, auto emit);
+static void EmitMove(u32 dst, u32 src);
+template<typename Int> static void EmitMoveExtended(HostGpr64 dst, auto src);
+static void EmitReturnStackExit();
+static void EmitReturnStackPush(IrInst const& branch);
+static void EmitStaticBranchExit(IrInst const& branch, u32 dead_gprs);
+template<typename Emitter> static void EndBlockFunction(Emitter& emitter);
+static u64 ExitLiveRegisters();
+static void FetchBlock();
 static u32 FetchInstruction(u32 vaddr);
-static void FinalizeBlock(Block& block);
+static u32 FetchSpanInstruction(u32 vaddr);
+static bool FinalizeBlock();
+template<typename Emitter> static asmjit::Error FinalizeBlockCode(Emitter& emitter);
 static Block& GetBlock(u32 paddr);
+static std::span<u8 const> GetGuestCode(u32 paddr);
+static bool GetLabelOffsets(std::vector<u32>& link_offsets, std::vector<u32>& fastmem_offsets);
+static Block InstallBlock(asmjit::CodeHolder& code, u32 paddr, u32 vaddr, u32 num_instructions,
+  std::span<u32 const> fastmem_offsets);
+static void InstallCompiledBlocks();
+static Block InterpretOrCompile(u32 paddr);
+static bool IsBranchToBlockStart(IrInst const& inst);
+static bool IsWithinBlockSpan(u32 vaddr);
+static void LinkBlock(BlockLink* link);
+static Block LoadCachedBlock(u32 paddr);
+static Block LookupBlock();
+static Label NewBlockLink(u32 target);
+static Label NewExceptionExit();
+static void OnCodeCacheEvict(u8 const* begin, u8 const* end);
+static bool OnFastmemFault(void* fault_addr, void* host_context);
+static bool OnRdramWriteFault(void* fault_addr, void* host_context);
 static void PerformBranch();
-static void ResetPool(Pool*& pool);
+static void ProtectRdramPage(u32 paddr);
+static bool QueueCompileJob(u32 paddr);
+static void RaiseInDelaySlot();
+static void ResetCodeHolder();
+static void ResetPool(u32 pool_index);
+static std::optional<PhysicalMapping> ResolveConstAddress(u32 vaddr, u32 size);
+static void RunCompileWorker(std::stop_token stop_token);
+static bool ShouldCompile(u32 paddr);
+static void SkipIdleLoop();
+static bool SlowPathsAreOutOfLine();
+template<typename Int> static u64 SlowRead(u32 vaddr);
+static void SlowReadQuad(u32 vaddr);
+template<std::unsigned_integral UInt> static void SlowWrite(u32 vaddr, u64 value);
+static void SlowWriteQuad(u32 vaddr);
+static void SlowWriteWordFromQuad(u32 vaddr);
+static bool* StaticBranchDelaySlotFlag(IrInst const& branch);
+static bool Translate(u32 paddr, u32 vaddr, bool profile);
+static void UnlinkPool(u32 pool_index);
 static void UpdateBranchState();
 
 static BumpAllocator allocator;
-static asmjit::CodeHolder code_holder;
+static asmjit::CodeHolder ee_thread_code_holder;
+static thread_local asmjit::CodeHolder* code_holder = &ee_thread_code_holder; // of the block being compiled
+static CodeCache code_cache;
 static asmjit::FileLogger jit_logger(stdout);
 static asmjit::JitRuntime jit_runtime;
-static std::vector<Pool*> pools;
-static bool block_has_branch_instr;
+static Block dispatcher;
+static Pool** pools; // num_pools entries, allocated lazily by the host
+static std::deque<CompiledBlock> compiled_blocks; // in the order of their code in the code cache
+static thread_local std::vector<PendingLink> pending_links;
+static thread_local std::vector<FastmemAccess> fastmem_accesses;
+static thread_local std::vector<std::function<void()>> cold_paths; // see EmitColdPaths
+static thread_local std::vector<ExceptionExitStub> exception_exit_stubs;
+static std::unordered_map<uintptr_t, uintptr_t> fastmem_slow_paths; // fastmem access => its slow path; read on faults
+static thread_local std::vector<u32> block_instructions; // guest code the block was compiled from; see FetchBlock
+static thread_local std::vector<u32> block_path_vaddrs; // of the instructions of the block, in the order they run
+static thread_local std::vector<u32> block_path_instructions;
+static thread_local IrBlock ir_block; // of block_path_instructions
+static thread_local std::span<u32 const> instruction_snapshot; // on a compile worker, the instructions of the job
+static u128 slow_path_quad; // the value of LQ and SQ on their slow path, too wide for a host GPR; also that of SWC1
+static u64 code_cache_evictions;
+static std::vector<bool> protected_rdram_pages; // one per host page
+static size_t rdram_page_size;
+static std::unordered_map<u32, std::vector<BlockLink*>> pool_links; // pool index => links into blocks of that pool
+static std::unordered_map<u32, std::vector<u32>> pool_spanning_blocks; // pool index => pools of blocks spanning it
+static std::array<ReturnStackEntry, 32> return_stack; // a ring buffer; the EE thread's, as filled by blocks
+static u32 return_stack_top; // byte offset of the top entry in return_stack
+static thread_local std::optional<u32> static_branch_target;
+static std::unordered_map<u32, u32> interpreted_block_counts; // paddr => runs in the interpreter, until compiled
+static u32 compile_threshold = ee_jit_compile_threshold;
+static TierStats tier_stats;
+static std::vector<std::jthread> compile_workers;
+static std::mutex compile_jobs_mutex; // guards the two queues below
+static std::condition_variable_any compile_jobs_cv;
+static std::deque<std::unique_ptr<CompileJob>> queued_compile_jobs;
+static std::vector<std::unique_ptr<CompileJob>> finished_compile_jobs;
+static std::atomic<bool> compile_jobs_finished; // finished_compile_jobs is not empty; polled without the lock
+static std::unordered_set<u32> pending_compile_jobs; // paddrs queued or being compiled; EE thread only
+static u64 compile_epoch;
+static thread_local BlockProfile* block_profile; // of the block being compiled, if profiling
+static thread_local u32 block_pc;
+static thread_local u32 block_paddr;
+static u32 cycle_budget;
+static thread_local bool block_has_branch_instr;
+static thread_local bool block_is_idle_loop; // see IsIdleLoop
+static thread_local u32 block_index; // in ir_block, of the instruction being emitted
+static thread_local Label block_loop_head; // valid if the block branches back to its start in place
+static thread_local bool block_in_delay_slot; // emitting a delay slot compiled in place; see RaiseInDelaySlot
+static thread_local IrInst const* block_dynamic_branch; // decided at run time, with its delay slot compiled in place
+static bool dynamic_branch_taken; // of a branch decided before its delay slot, which overwrites the branch operands
+static void (*delay_slot_exception)(); // raised by RaiseInDelaySlot
+
+// With the Compiler, the code of a block is a function, which only turns from nodes into code once finalized; the
+// Assembler emits the code as it goes
+template<typename Emitter> void BeginBlockFunction(Emitter& emitter)
+{
+    if constexpr (std::derived_from<Emitter, BaseCompiler>) {
+        emitter.addFunc(FuncSignature::build<void>());
+    }
+}
 
 void BlockEpilog()
 {
@@ -61,12 +268,50 @@ void BlockEpilog()
     c.ret();
 }
 
+// Exits from a delay slot compiled in place only ever raise exceptions, which need to know of the delay slot
 void BlockEpilogWithJmp(void (*func)())
 {
+    if (block_in_delay_slot) {
+        c.mov(rax, reinterpret_cast<u64>(func));
+        c.mov(JitPtr(&delay_slot_exception), rax);
+        func = RaiseInDelaySlot;
+    }
     RecordBlockCycles();
     reg_alloc.BlockEpilogWithJmp(func);
 }
 
+// dead_gprs: guest registers that the target overwrites before reading, and that need not be written back
+void BlockEpilogWithLink(u32 target, u32 dead_gprs)
+{
+    if (enable_ee_jit_idle_loop_skipping && block_is_idle_loop && target == block_pc) {
+        EmitCallPreservingRegisters(SkipIdleLoop, [] {}, reg_alloc.StackIsAlignedForCall());
+    }
+    if (target == block_pc && block_loop_head.isValid()) {
+        // Back to the start of the block, in place, for as long as the cycle budget lasts; pc is still block_pc
+        RecordBlockCycles();
+        c.mov(eax, JitPtr(cycle_counter));
+        c.cmp(eax, JitPtr(cycle_budget));
+        reg_alloc.LoopBackEdge(block_loop_head);
+        c.ret();
+        return;
+    }
+    if (!enable_ee_jit_block_linking || !CanLinkTo(target)) {
+        BlockEpilog();
+        return;
+    }
+    Label l_link = NewBlockLink(target);
+    RecordBlockCycles();
+    Label l_return = c.newLabel();
+    c.mov(eax, JitPtr(cycle_counter));
+    c.cmp(eax, JitPtr(cycle_budget));
+    reg_alloc.BlockEpilogWithoutRet(dead_gprs);
+    c.jae(l_return); // out of cycles; return to the dispatcher
+    c.lea(host_gpr_arg[0], ptr(l_link));
+    c.jmp(qword_ptr(host_gpr_arg[0], offsetof(BlockLink, host_target)));
+    c.bind(l_return);
+    c.ret();
+}
+
 void BlockEpilogWithPcFlushAndJmp(void (*func)(), int pc_offset)
 {
     FlushPc(pc_offset);
@@ -81,29 +326,28 @@ void BlockEpilogWithPcFlush(int pc_offset)
 
 void BlockProlog()
 {
-    code_holder.reset();
-    asmjit::Error err = code_holder.init(jit_runtime.environment(), jit_runtime.cpuFeatures());
-    if (err) [[unlikely]] {
-        log_fatal("Failed to init asmjit code holder; returned {}", asmjit::DebugUtils::errorAsString(err));
-    }
-    err = code_holder.attach(&c);
+    ResetCodeHolder();
+    asmjit::Error err = code_holder->attach(&c);
     if (err) [[unlikely]] {
         log_fatal("Failed to attach asmjit compiler to code holder; returned {}",
           asmjit::DebugUtils::errorAsString(err));
     }
-    if constexpr (enable_ee_jit_error_handler) {
-        static AsmjitLogErrorHandler asmjit_log_error_handler{};
-        code_holder.setErrorHandler(&asmjit_log_error_handler);
-    }
     if constexpr (log_ee_jit_blocks) {
         jit_logger.addFlags(FormatFlags::kMachineCode);
-        code_holder.setLogger(&jit_logger);
+        code_holder->setLogger(&jit_logger);
         jit_logger.log("======== CPU BLOCK BEGIN ========\n");
     }
-    c.addFunc(FuncSignature::build<void>());
+    BeginBlockFunction(c);
     reg_alloc.BlockProlog();
 }
 
+// Whether a branch whose delay slot is compiled in place can read its operands after the delay slot, rather than having
+// its outcome saved before it. Likely branches are decided before it, so as to skip it when not taken.
+bool BranchDecidedAfterDelaySlot(IrInst const& branch)
+{
+    return !branch.branch_likely && !(branch.reads & (&branch)[1].writes);
+}
+
 bool CheckDwordOpCondJit()
 {
     // if (can_execute_dword_instrs) {
@@ -116,45 +360,73 @@ bool CheckDwordOpCondJit()
     return true;
 }
 
-void compile(Block& block)
+bool CanLinkTo(u32 target)
 {
-    branched = block_has_branch_instr = false;
-    block_cycles = 0;
-    jit_pc = pc;
-
-    BlockProlog();
+    // The translation of kseg0/kseg1 addresses is fixed. Elsewhere, only link within the page of the block itself,
+    // which cannot be remapped without the block also being looked up anew.
+    bool unmapped_segment = target - 0x8000'0000 < 0x4000'0000;
+    bool same_page = (target ^ block_pc) < 0x1000;
+    return (unmapped_segment || same_page) && !(target & 3);
+}
 
-    EmitInstruction();
+Block compile(u32 paddr)
+{
+    CloseBlockProfilingInterval();
 
-    if (compiler_exception_occurred) {
-        BlockEpilog();
-        FinalizeBlock(block);
-        return;
+    // Blocks in the disk cache lack the profiling prolog, and profiled blocks embed the address of their profile
+    if (JitDiskCacheIsOpen() && !BlockProfilingEnabled()) {
+        if (Block block = LoadCachedBlock(paddr)) {
+            return block;
+        }
     }
 
-    // If the previously executed block ended with a branch instruction, meaning that the branch delay
-    // slot did not fit, execute only the first instruction in this block, before jumping.
-    // The jump can be cancelled if the first instruction is also a branch.
-    if (!branch_hit) {
-        UpdateBranchState();
+    Translate(paddr, pc, BlockProfilingEnabled());
+
+    std::vector<u32> link_offsets, fastmem_offsets;
+    bool offsets_known = GetLabelOffsets(link_offsets, fastmem_offsets);
+    // Blocks cut short by an exception while fetching depend on more than their guest instructions
+    if (block_profile) {
+        block_profile->num_instructions = block_index;
+        block_profile->cycles = block_cycles;
+    } else if (JitDiskCacheIsOpen() && !compiler_exception_occurred && offsets_known) {
+        StoreBlockToJitDiskCache(paddr, block_pc, block_instructions, *code_holder, link_offsets, fastmem_offsets);
     }
+    return InstallBlock(*code_holder, paddr, block_pc, u32(block_instructions.size()), fastmem_offsets);
+}
 
-    while (!branched && !compiler_exception_occurred && (jit_pc & 255)) {
-        branched |= branch_hit; // If the branch delay slot instruction fits within the block boundary,
-                                // include it before stopping
-        EmitInstruction();
+u32 CompileBlockAtPc()
+{
+    exception_occurred = false;
+    u32 paddr = devirtualize(pc);
+    if (exception_occurred) {
+        return 0;
     }
+    compile(paddr);
+    return block_index;
+}
 
-    if (compiler_exception_occurred) {
-        BlockEpilog();
-    } else {
-        if (!branch_hit && block_has_branch_instr) {
-            UpdateBranchState();
-        }
-        BlockEpilogWithPcFlush(0);
+// Whether the delay slot of the branch at ir_block.insts[index] is compiled in place, with the branch leaving the block
+// only after it, without going through branch_state. It always is for branches resolved at compile time; see
+// ResolveBranches, which leaves alone the same branches as here.
+bool CompilesDelaySlotInPlace(size_t index)
+{
+    IrInst const& branch = ir_block.insts[index];
+    if (branch.branch_outcome != IrBranchOutcome::Dynamic) {
+        return true;
     }
+    return enable_ee_jit_static_delay_slots && branch.branch_cond != IrBranchCond::Cop && index > 0
+        && index + 1 < ir_block.insts.size();
+}
 
-    FinalizeBlock(block);
+AccessSite CurrentAccessSite(bool may_raise_exception)
+{
+    return {
+        .exception_exit = may_raise_exception && enable_ee_jit_out_of_line_exits ? NewExceptionExit() : Label{},
+        .pc = jit_pc,
+        .may_raise_exception = may_raise_exception,
+        .in_delay_slot = block_in_delay_slot,
+        .stack_is_aligned_for_call = reg_alloc.StackIsAlignedForCall(),
+    };
 }
 
 void DiscardBranch()
@@ -165,171 +437,1652 @@ void DiscardBranch()
     BlockEpilogWithPcFlush(8);
 }
 
-void EmitInstruction()
+// A branch decided at run time whose delay slot is not compiled in place (see CompilesDelaySlotInPlace) goes through
+// branch_state, for UpdateBranchState to perform after the delay slot. The link is written first; the ISA leaves the
+// outcome of a branch whose link register is also its operand unpredictable.
+void EmitBranchBookkeeping(IrInst const& branch)
 {
-    block_cycles++;
-    branch_hit = compiler_exception_occurred = false;
-    u32 instr = FetchInstruction(jit_pc);
-    if (compiler_exception_occurred) {
-        return; // todo: handle this. need to compile exception handling
+    if (branch.dst) {
+        EmitLink(branch.dst);
     }
-    mips::decode_ee(instr);
-    if (compiler_exception_occurred) {
+    if (!branch.branch_direct) {
+        TakeBranch(reg_alloc.GetGpr(branch.srcs[0].guest).r32());
         return;
     }
-    jit_pc += 4;
-    block_has_branch_instr |= branch_hit;
-    if constexpr (log_ee_jit_register_status) {
-        jit_logger.log(reg_alloc.GetStatus().c_str());
+    if (branch.branch_cond == IrBranchCond::Always) {
+        TakeBranch(u32(branch.imm));
+        return;
     }
+    Label l_taken = c.newLabel(), l_done = c.newLabel();
+    c.j(EmitBranchCompare(branch), l_taken);
+    if (branch.branch_likely) {
+        DiscardBranch(); // skips the delay slot
+    } else {
+        OnBranchNotTaken();
+        c.jmp(l_done);
+    }
+    c.bind(l_taken);
+    TakeBranch(u32(branch.imm));
+    c.bind(l_done);
 }
 
-void EmitLink(u32 reg)
+// Compares the operands of a conditional direct branch; returns the condition that the branch is taken on
+x86::CondCode EmitBranchCompare(IrInst const& branch)
 {
-    c.mov(reg_alloc.GetDirtyGpr(reg), jit_pc + 8);
+    u32 rs = branch.srcs[0].guest, rt = branch.srcs[1].guest;
+    if (branch.num_srcs == 1) {
+        rt = 0;
+    } else if (reg_alloc.GetConst(rs) && !reg_alloc.GetConst(rt)) {
+        std::swap(rs, rt); // compare with the constant
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    if (std::optional<u64> value = reg_alloc.GetConst(rt); value == 0) {
+        c.test(hs, hs);
+    } else if (value && s64(*value) == s32(*value)) {
+        c.cmp(hs, s32(*value));
+    } else {
+        c.cmp(hs, reg_alloc.GetGpr(rt));
+    }
+    switch (branch.branch_cond) {
+    case IrBranchCond::Eq: return x86::CondCode::kE;
+    case IrBranchCond::Ne: return x86::CondCode::kNE;
+    case IrBranchCond::Lez: return x86::CondCode::kLE;
+    case IrBranchCond::Gtz: return x86::CondCode::kG;
+    case IrBranchCond::Ltz: return x86::CondCode::kS;
+    case IrBranchCond::Gez: return x86::CondCode::kNS;
+    default: std::unreachable();
+    }
 }
 
-u32 FetchInstruction(u32 vaddr)
+// A load from an address known at compile time, made directly from host memory, or with a call to the IO handler of
+// the address, as long as the MMU would not do anything else with it. Returns false for the general path otherwise.
+template<typename Int> bool EmitConstAddressLoad(u32 vaddr, u32 rt)
 {
-    return virtual_read<u32, Alignment::Aligned, MemOp::InstrFetch>(vaddr);
+    std::optional<PhysicalMapping> mapping = ResolveConstAddress(vaddr, sizeof(Int));
+    if (!mapping) {
+        return false;
+    }
+    if (mapping->host) {
+        if (rt) {
+            EmitMoveExtended<Int>(reg_alloc.GetDirtyGpr(rt), JitPtr(mapping->host, sizeof(Int)));
+        }
+        return true;
+    }
+    auto handler = mapping->io_handlers->read_handler<std::make_unsigned_t<Int>>();
+    if (!handler) {
+        return false; // the MMU reports the access
+    }
+    HostGpr64 ht = rt ? reg_alloc.GetDirtyGpr(rt) : rax; // IO reads to $zero are still made; they may have side effects
+    EmitIoHandlerCall(handler, vaddr, nullptr);
+    if (rt) {
+        if constexpr (sizeof(Int) == 8) EmitMoveExtended<Int>(ht, rax);
+        else if constexpr (sizeof(Int) == 4) EmitMoveExtended<Int>(ht, eax);
+        else if constexpr (sizeof(Int) == 2) EmitMoveExtended<Int>(ht, ax);
+        else EmitMoveExtended<Int>(ht, al);
+    }
+    return true;
 }
 
-void FinalizeBlock(Block& block)
+template<std::unsigned_integral UInt> bool EmitConstAddressStore(u32 vaddr, u32 rt)
 {
-    c.endFunc();
-    asmjit::Error err = c.finalize();
-    if (err) {
-        log_fatal("Failed to finalize code block; returned {}", asmjit::DebugUtils::errorAsString(err));
+    std::optional<PhysicalMapping> mapping = ResolveConstAddress(vaddr, sizeof(UInt));
+    if (!mapping) {
+        return false;
     }
-    err = jit_runtime.add(&block, &code_holder);
-    if (err) {
-        log_fatal("Failed to add code to asmjit runtime! Returned error code {}.", err);
+    if (mapping->host) {
+        if (mapping->read_only) {
+            return true; // writes to ROM are ignored
+        }
+        Mem dst = JitPtr(mapping->host, sizeof(UInt));
+        std::optional<u64> value = reg_alloc.GetConst(rt);
+        if (value && (sizeof(UInt) < 8 || s64(*value) == s32(*value))) {
+            c.mov(dst, sizeof(UInt) == 8 ? s64(*value) : s64(UInt(*value)));
+            return true;
+        }
+        HostGpr64 ht = reg_alloc.GetGpr(rt);
+        if constexpr (sizeof(UInt) == 8) c.mov(dst, ht);
+        else if constexpr (sizeof(UInt) == 4) c.mov(dst, ht.r32());
+        else if constexpr (sizeof(UInt) == 2) c.mov(dst, ht.r16());
+        else c.mov(dst, ht.r8());
+        return true;
     }
+    auto handler = mapping->io_handlers->write_handler<UInt>();
+    if (!handler) {
+        return false;
+    }
+    HostGpr64 ht = reg_alloc.GetGpr(rt);
+    EmitIoHandlerCall(handler, vaddr, &ht);
+    return true;
 }
 
-void FlushPc(int pc_offset)
+// The exit of a branch taken to a direct target, which is aligned
+void EmitDirectBranchExit(u32 target, u32 dead_gprs)
 {
-    u32 new_pc = jit_pc + pc_offset;
-    if (new_pc - pc < 128) {
-        c.add(JitPtr(pc), new_pc);
+    if constexpr (log_ee_branches) {
+        c.mov(JitPtr(jump_addr), target);
+        BlockEpilogWithJmp(PerformBranch);
     } else {
-        c.mov(JitPtr(pc), new_pc);
+        c.mov(JitPtr(pc), target);
+        BlockEpilogWithLink(target, dead_gprs);
     }
 }
 
-Block& GetBlock(u32 paddr)
+// Runs blocks until the cycle budget of RunJit has been used up. Blocks whose guest pc lies in kseg0/kseg1 and that
+// have already been compiled are looked up inline; anything else goes through LookupBlock.
+Status EmitDispatcher()
 {
-    static_assert(std::has_single_bit(num_pools));
-    Pool*& pool = pools[paddr >> 8 & (num_pools - 1)]; // each pool 6 bits, each instruction 2 bits
-    if (!pool) {
-        pool = allocator.acquire<Pool>(); // TODO: check if OOM
+    asmjit::CodeHolder holder;
+    asmjit::Error err = holder.init(jit_runtime.environment(), jit_runtime.cpuFeatures());
+    if (err) {
+        return FailureStatus("Failed to init asmjit code holder; returned {}", asmjit::DebugUtils::errorAsString(err));
     }
-    assert(pool);
-    return pool->blocks[paddr >> 2 & 63];
-}
+    x86::Assembler a(&holder);
+    Label l_loop = a.newLabel(), l_run = a.newLabel(), l_lookup = a.newLabel(), l_exit = a.newLabel();
+    constexpr s32 shadow_space = platform.abi.win64 ? 32 : 0;
 
-Status InitJit()
-{
-    allocator.allocate(64_MiB);
-    pools.resize(num_pools, nullptr);
+    a.push(guest_gpr_base_ptr_reg);
+    if constexpr (shadow_space > 0) {
+        a.sub(rsp, shadow_space);
+    }
+    a.mov(guest_gpr_base_ptr_reg, gpr.data() + gpr.size() / 2);
+
+    a.bind(l_loop);
+    a.mov(eax, JitPtr(cycle_counter));
+    a.cmp(eax, JitPtr(cycle_budget));
+    a.jae(l_exit);
+    a.mov(eax, JitPtr(pc));
+    a.mov(ecx, eax);
+    a.sub(ecx, 0x8000'0000);
+    a.cmp(ecx, 0x4000'0000);
+    a.jae(l_lookup); // not in kseg0/kseg1
+    a.and_(eax, 0x1FFF'FFFF);
+    a.mov(ecx, eax);
+    a.shr(ecx, 8); // pool index
+    a.mov(rdx, pools);
+    a.mov(rdx, qword_ptr(rdx, rcx, 3));
+    a.test(rdx, rdx);
+    a.jz(l_lookup);
+    a.shr(eax, 2);
+    a.and_(eax, instructions_per_pool - 1);
+    a.mov(rax, qword_ptr(rdx, rax, 3)); // pool->blocks[index]
+    a.test(rax, rax);
+    a.jz(l_lookup);
+    a.bind(l_run);
+    a.call(rax);
+    a.jmp(l_loop);
+
+    a.bind(l_lookup);
+    a.call(LookupBlock);
+    a.test(rax, rax);
+    a.jnz(l_run);
+    a.jmp(l_loop);
+
+    a.bind(l_exit);
+    if constexpr (shadow_space > 0) {
+        a.add(rsp, shadow_space);
+    }
+    a.pop(guest_gpr_base_ptr_reg);
+    a.ret();
+
+    err = jit_runtime.add(&dispatcher, &holder);
+    if (err) {
+        return FailureStatus("Failed to add dispatcher to asmjit runtime; returned {}",
+          asmjit::DebugUtils::errorAsString(err));
+    }
+    if (jit_perf::is_open()) {
+        jit_perf::record_code(reinterpret_cast<void const*>(dispatcher), holder.codeSize(), "ee_dispatcher");
+    }
     return OkStatus();
 }
 
-void Invalidate(u32 paddr)
+// A branch decided at run time, whose delay slot is compiled in place (see CompilesDelaySlotInPlace), at the branch. A
+// likely branch not taken leaves the block here, and any other is decided by EmitDynamicBranchExit, after the delay
+// slot, unless the delay slot overwrites its operands, and its outcome is saved here. The link is written first, as in
+// EmitBranchBookkeeping.
+void EmitDynamicBranch(IrInst const& branch)
 {
-    assert(paddr < pool_max_addr_excl);
-    Pool*& pool = pools[paddr >> 8 & (num_pools - 1)]; // each pool 6 bits, each instruction 2 bits
-    ResetPool(pool);
+    block_dynamic_branch = &branch;
+    if (branch.dst) {
+        EmitLink(branch.dst);
+        EmitReturnStackPush(branch);
+    }
+    if (branch.branch_likely) {
+        Label l_taken = c.newLabel();
+        c.j(EmitBranchCompare(branch), l_taken);
+        FlushPc(8);
+        BlockEpilogWithLink(jit_pc + 8);
+        c.bind(l_taken);
+    } else if (!BranchDecidedAfterDelaySlot(branch)) {
+        if (!branch.branch_direct) {
+            c.mov(JitPtr(jump_addr), reg_alloc.GetGpr(branch.srcs[0].guest).r32());
+        } else if (branch.branch_cond != IrBranchCond::Always) {
+            c.set(EmitBranchCompare(branch), JitPtr(dynamic_branch_taken));
+        }
+    }
 }
 
-void InvalidateRange(u32 paddr_lo, u32 paddr_hi)
+// The exit of a block that ends on a branch decided at run time, after its delay slot, which was compiled in place
+void EmitDynamicBranchExit(IrInst const& branch)
 {
-    assert(paddr_lo <= paddr_hi);
-    assert(paddr_hi < pool_max_addr_excl);
-    u32 pool_lo = paddr_lo >> 8;
-    u32 pool_hi = paddr_hi >> 8;
-    std::for_each(pools.begin() + pool_lo, pools.begin() + pool_hi + 1, [](Pool*& pool) { ResetPool(pool); });
+    bool decided_here = BranchDecidedAfterDelaySlot(branch);
+    if (branch.branch_direct) {
+        if (branch.branch_likely || branch.branch_cond == IrBranchCond::Always) {
+            EmitDirectBranchExit(u32(branch.imm), 0);
+            return;
+        }
+        Label l_not_taken = c.newLabel();
+        if (decided_here) {
+            c.j(x86::negateCond(EmitBranchCompare(branch)), l_not_taken);
+        } else {
+            c.cmp(JitPtr(dynamic_branch_taken), 0);
+            c.je(l_not_taken);
+        }
+        EmitDirectBranchExit(u32(branch.imm), 0);
+        c.bind(l_not_taken);
+        FlushPc();
+        BlockEpilogWithLink(jit_pc);
+        return;
+    }
+    u32 rs = branch.srcs[0].guest;
+    if (std::optional<u64> target = decided_here ? reg_alloc.GetConst(rs) : std::nullopt; target && !(*target & 3)) {
+        EmitDirectBranchExit(u32(*target), 0);
+        return;
+    }
+    if (decided_here) {
+        c.mov(eax, reg_alloc.GetGpr(rs).r32());
+    } else {
+        c.mov(eax, JitPtr(jump_addr));
+    }
+    if constexpr (log_ee_branches) {
+        c.mov(JitPtr(jump_addr), eax);
+        BlockEpilogWithJmp(PerformBranch);
+        return;
+    }
+    Label l_misaligned = c.newLabel();
+    c.mov(JitPtr(pc), eax);
+    c.test(al, 3);
+    c.jnz(l_misaligned);
+    if (enable_ee_jit_return_stack && guest_gpr_base_ptr_is_pinned && rs == 31 && !branch.dst) {
+        EmitReturnStackExit();
+    } else {
+        BlockEpilog(); // the dispatcher looks the target up
+    }
+    c.bind(l_misaligned);
+    c.mov(JitPtr(jump_addr), eax);
+    BlockEpilogWithJmp(PerformBranch); // which raises the address error
 }
 
-void OnBranchNotTaken()
+// Calls func with the volatile host registers that the register allocator may use saved; emit_args runs once they are
+void EmitCallPreservingRegisters(auto func, auto emit_args, bool stack_is_aligned_for_call)
 {
-    c.mov(JitPtr(in_branch_delay_slot_taken), 0);
-    c.mov(JitPtr(in_branch_delay_slot_not_taken), 1);
-    c.mov(JitPtr(branch_state), std::to_underlying(mips::BranchState::NoBranch));
+    for (HostGpr64 gpr : reg_alloc_volatile_gprs) {
+        c.push(gpr);
+    }
+    constexpr s32 vpr_save_size = s32(16 * reg_alloc_volatile_vprs.size());
+    c.sub(rsp, vpr_save_size);
+    for (size_t i = 0; i < reg_alloc_volatile_vprs.size(); ++i) {
+        c.movdqu(xmmword_ptr(rsp, s32(16 * i)), reg_alloc_volatile_vprs[i]);
+    }
+    emit_args();
+    if (stack_is_aligned_for_call == (reg_alloc_volatile_gprs.size() % 2 == 0)) {
+        jit_call_no_stack_alignment(c, func);
+    } else {
+        jit_call_with_stack_alignment(c, func);
+    }
+    for (size_t i = 0; i < reg_alloc_volatile_vprs.size(); ++i) {
+        c.movdqu(reg_alloc_volatile_vprs[i], xmmword_ptr(rsp, s32(16 * i)));
+    }
+    c.add(rsp, vpr_save_size);
+    for (HostGpr64 gpr : reg_alloc_volatile_gprs | std::views::reverse) {
+        c.pop(gpr);
+    }
 }
 
-void PerformBranch()
+// Code past that of the block, off the path it runs on: the slow paths of its memory accesses, then its exits for the
+// exception handler, which write back only what is dirty where they are taken from
+void EmitColdPaths()
 {
-    in_branch_delay_slot_taken = false;
-    branch_state = mips::BranchState::NoBranch;
-    pc = jump_addr;
-    if (pc & 3) {
-        address_error_exception(pc, MemOp::InstrFetch);
+    for (std::function<void()> const& emit : cold_paths) {
+        emit();
     }
-    if constexpr (log_ee_branches) {
-        log_info("EE branch to 0x{:016X}; RA = 0x{:016X}; SP = 0x{:016X}", u64(pc), u64(gpr[31]), u64(gpr[29]));
+    for (ExceptionExitStub const& stub : exception_exit_stubs) {
+        Label l_stub = c.newLabel();
+        for (size_t i = 0; i < stub.entries.size(); ++i) {
+            auto [cycles, l_entry] = stub.entries[i];
+            c.bind(l_entry);
+            c.mov(eax, cycles);
+            if (i + 1 < stub.entries.size()) {
+                c.jmp(l_stub);
+            }
+        }
+        c.bind(l_stub);
+        c.add(JitPtr(cycle_counter), eax);
+        c.add(JitPtr(cop0.count), eax);
+        reg_alloc.BlockEpilogWithoutRet(stub.state);
+        c.ret();
     }
 }
 
-void RecordBlockCycles()
+// The fast path of a guest memory access, with the guest address in eax: a single host access at fastmem_base + eax.
+// Misaligned addresses take the slow path, where the MMU raises the address error.
+void EmitFastmemAccess(u32 size, Label l_slow_path, Label l_done, auto emit_access)
 {
-    assert(block_cycles > 0);
-    c.add(JitPtr(cycle_counter), block_cycles);
-    c.add(JitPtr(cop0.count), block_cycles);
+    if (!FastmemIsEnabled()) {
+        return;
+    }
+    if (size > 1) {
+        c.test(al, size - 1);
+        c.jnz(l_slow_path);
+    }
+    c.add(rax, JitPtr(fastmem_base));
+    Label l_access = c.newLabel();
+    c.bind(l_access);
+    emit_access();
+    // Pads the access to at least the size of the jmp rel32 that OnFastmemFault replaces it with
+    static constexpr std::array<u8, 3> nop3 = { 0x0F, 0x1F, 0x00 };
+    c.embed(nop3.data(), nop3.size());
+    if (!SlowPathsAreOutOfLine()) {
+        c.jmp(l_done);
+    }
+    fastmem_accesses.push_back({ l_access, l_slow_path });
 }
 
-void ResetPool(Pool*& pool)
+void EmitInstruction()
 {
-    if (pool) {
-        for (Block block : pool->blocks) {
-            if (block) {
-                jit_runtime.release(block);
+    block_cycles++;
+    branch_hit = compiler_exception_occurred = false;
+    size_t index = block_index;
+    if (index == ir_block.insts.size()) {
+        compiler_exception_occurred = true; // fetching the instruction raised an exception
+        return; // todo: handle this. need to compile exception handling
+    }
+    IrInst const& inst = ir_block.insts[index];
+    block_in_delay_slot = enable_ee_jit_static_delay_slots && index > 0 && ir_block.insts[index - 1].op == IrOp::Branch
+                       && CompilesDelaySlotInPlace(index - 1);
+    // A block entered in the delay slot of a branch leaves after its first instruction, for wherever the branch goes
+    reg_alloc.BeginInstruction(index ? inst.live_in : ir_all_registers, inst.next_reads);
+    switch (inst.op) {
+    case IrOp::Nop: break;
+    case IrOp::Const: reg_alloc.SetConst(inst.dst, inst.imm); break;
+    case IrOp::Move: EmitMove(inst.dst, inst.srcs[0].guest); break;
+    case IrOp::Branch:
+        if (inst.branch_outcome != IrBranchOutcome::Dynamic) {
+            // Resolved at compile time; the exit is emitted after the delay slot, by EmitStaticBranchExit
+            if (inst.dst) {
+                EmitLink(inst.dst);
+                EmitReturnStackPush(inst);
             }
+            if (bool* flag = StaticBranchDelaySlotFlag(inst)) {
+                c.mov(JitPtr(flag), 1);
+            }
+        } else if (CompilesDelaySlotInPlace(index)) {
+            EmitDynamicBranch(inst);
+        } else if (enable_ee_jit_static_delay_slots && inst.branch_cond != IrBranchCond::Cop) {
+            EmitBranchBookkeeping(inst);
+        } else {
+            mips::decode_ee(inst.instr);
+        }
+        break;
+    default: mips::decode_ee(inst.instr);
+    }
+    block_in_delay_slot = false;
+    if (compiler_exception_occurred) {
+        return;
+    }
+    jit_pc += 4;
+    block_index++;
+    branch_hit = inst.op == IrOp::Branch && inst.branch_outcome != IrBranchOutcome::Followed;
+    block_has_branch_instr |= branch_hit;
+    if (index > 0 && ir_block.insts[index - 1].branch_outcome == IrBranchOutcome::Followed) {
+        // The delay slot of a jump that the block follows, which goes on at the target
+        IrInst const& jump = ir_block.insts[index - 1];
+        if (bool* flag = StaticBranchDelaySlotFlag(jump)) {
+            c.mov(JitPtr(flag), 0);
         }
-        pool = nullptr;
+        jit_pc = u32(jump.imm);
+    }
+    if constexpr (log_ee_jit_register_status) {
+        jit_logger.log(reg_alloc.GetStatus().c_str());
     }
 }
 
-u32 RunJit(u32 cycles)
+// IO handlers can raise interrupts (e.g. on a write to INTC_MASK), so are called as an access that may raise an
+// exception. Unlike SlowRead etc., they do not clear exception_occurred first.
+void EmitIoHandlerCall(auto handler, u32 vaddr, HostGpr64 const* store_value)
 {
-    cycle_counter = 0;
-    while (cycle_counter < cycles) {
-        exception_occurred = false;
-        Block& block = GetBlock(devirtualize(pc));
-        if (!block) {
-            compile(block);
+    c.mov(JitPtr(exception_occurred), 0);
+    c.mov(eax, vaddr & 0x1FFF'FFFF);
+    EmitMemoryAccessCall(handler, store_value, CurrentAccessSite(true));
+}
+
+void EmitLink(u32 reg)
+{
+    reg_alloc.SetConst(reg, jit_pc + 8);
+}
+
+template<typename Int> void EmitLoad(u32 rs, u32 rt, s16 imm)
+{
+    if (std::optional<u64> base = reg_alloc.GetConst(rs)) {
+        if (EmitConstAddressLoad<Int>(u32(*base) + imm, rt)) {
+            return;
         }
-        block();
     }
-    return cycle_counter;
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    HostGpr64 ht = rt ? reg_alloc.GetDirtyGpr(rt) : rax; // loads to $zero are still made; they may raise exceptions
+    c.lea(eax, ptr(hs, imm));
+    Label l_slow_path = c.newLabel(), l_done = c.newLabel();
+    EmitFastmemAccess(
+      sizeof(Int), l_slow_path, l_done, [ht] { EmitMoveExtended<Int>(ht, ptr(rax, 0, sizeof(Int))); });
+    EmitMemorySlowPath(l_slow_path, l_done, [ht, rt](AccessSite const& site) {
+        EmitMemoryAccessCall(SlowRead<Int>, nullptr, site);
+        if (rt) {
+            c.mov(ht, rax);
+        }
+    });
 }
 
-template<typename Target>
-void TakeBranch(Target target)
-    requires(std::same_as<Target, u32> || std::same_as<Target, HostGpr32>)
+void EmitLoadQuad(u32 rs, u32 rt, s16 imm)
 {
-    c.mov(JitPtr(in_branch_delay_slot_taken), 1);
-    c.mov(JitPtr(in_branch_delay_slot_not_taken), 0);
-    c.mov(JitPtr(branch_state), std::to_underlying(mips::BranchState::Perform));
-    c.mov(JitPtr(jump_addr), target);
+    HostGpr128 ht = rt ? reg_alloc.GetDirtyVpr(rt) : xmm0; // loads to $zero are still made; they may raise exceptions
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    c.lea(eax, ptr(hs, imm));
+    c.and_(eax, ~15);
+    Label l_slow_path = c.newLabel(), l_done = c.newLabel();
+    EmitFastmemAccess(16, l_slow_path, l_done, [ht] { c.vmovdqu(ht, xmmword_ptr(rax)); });
+    EmitMemorySlowPath(l_slow_path, l_done, [ht, rt](AccessSite const& site) {
+        EmitMemoryAccessCall(SlowReadQuad, nullptr, site);
+        if (rt) {
+            c.vmovdqu(ht, JitPtr(slow_path_quad));
+        }
+    });
 }
 
-void TearDownJit()
+void EmitLoadWordToMem(u32 rs, s16 imm, Mem dst)
 {
-    allocator.deallocate();
-    pools.clear();
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    c.lea(eax, ptr(hs, imm));
+    Label l_slow_path = c.newLabel(), l_done = c.newLabel();
+    EmitFastmemAccess(4, l_slow_path, l_done, [] { c.mov(eax, dword_ptr(rax)); });
+    EmitMemorySlowPath(l_slow_path, l_done, [](AccessSite const& site) {
+        EmitMemoryAccessCall(SlowRead<u32>, nullptr, site);
+    });
+    c.mov(dst, eax);
 }
 
-void UpdateBranchState()
+// Calls func(eax) or func(eax, store_value), the MMU or an IO handler, from within a block, where the registers of the
+// allocator are live; all volatile host registers are preserved across the call, except for rax, which receives the
+// value read, if any. If the access may raise an exception and did, the block is left for the exception handler. The
+// code depends only on site, so that it can be emitted away from the access.
+void EmitMemoryAccessCall(auto func, HostGpr64 const* store_value, AccessSite const& site)
 {
-    Label l_nobranch = c.newLabel();
-    c.cmp(JitPtr(branch_state), std::to_underlying(mips::BranchState::Perform));
-    c.jne(l_nobranch);
-    BlockEpilogWithJmp(PerformBranch);
+    if (site.may_raise_exception) {
+        c.mov(JitPtr(pc), site.pc + 4); // as when the interpreter raises an exception
+        if (site.in_delay_slot) {
+            c.mov(JitPtr(in_branch_delay_slot_taken), 1);
+        }
+    }
+    EmitCallPreservingRegisters(
+      func,
+      [store_value] {
+          if (store_value) {
+              c.mov(host_gpr_arg[1], *store_value); // before the address, since the value may be in host_gpr_arg[0]
+          }
+          c.mov(host_gpr_arg[0].r32(), eax);
+      },
+      site.stack_is_aligned_for_call);
+    if (!site.may_raise_exception) {
+        return;
+    }
+    if (site.in_delay_slot) {
+        c.mov(JitPtr(in_branch_delay_slot_taken), 0); // raised by now, if at all
+    }
+    c.cmp(JitPtr(exception_occurred), 0);
+    if constexpr (enable_ee_jit_out_of_line_exits) {
+        c.jne(site.exception_exit);
+    } else {
+        Label l_no_exception = c.newLabel();
+        c.je(l_no_exception);
+        RecordBlockCycles();
+        reg_alloc.BlockEpilogWithoutRet();
+        c.ret();
+        c.bind(l_no_exception);
+    }
+    c.mov(JitPtr(pc), block_pc);
+}
+
+// The slow path of a guest memory access, entered at l_slow_path and going on at l_done, where emit(site) makes the MMU
+// call and takes its result. Past a fastmem access, it is only entered on misaligned addresses or once the access
+// faulted, and is emitted out of line, so that the fast path falls through to l_done.
+void EmitMemorySlowPath(Label l_slow_path, Label l_done, auto emit)
+{
+    AccessSite site = CurrentAccessSite(true);
+    if (SlowPathsAreOutOfLine()) {
+        cold_paths.push_back([l_slow_path, l_done, site, emit] {
+            c.bind(l_slow_path);
+            emit(site);
+            c.jmp(l_done);
+        });
+    } else {
+        c.bind(l_slow_path);
+        emit(site);
+    }
+    c.bind(l_done);
+}
+
+// Moves the Int in src, a host register or memory operand of the size of Int, to dst, extended by the signedness of Int
+void EmitMove(u32 dst, u32 src)
+{
+    if (std::optional<u64> value = reg_alloc.GetConst(src)) {
+        reg_alloc.SetConst(dst, *value);
+        return;
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(src), hd = reg_alloc.GetDirtyGpr(dst);
+    c.mov(hd, hs);
+}
+
+template<typename Int> void EmitMoveExtended(HostGpr64 dst, auto src)
+{
+    if constexpr (sizeof(Int) == 8) c.mov(dst, src);
+    else if constexpr (sizeof(Int) == 4 && std::is_signed_v<Int>) c.movsxd(dst, src);
+    else if constexpr (sizeof(Int) == 4) c.mov(dst.r32(), src);
+    else if constexpr (std::is_signed_v<Int>) c.movsx(dst, src);
+    else c.movzx(dst.r32(), src);
+}
+
+// The exit of a return, with its aligned target in eax, and pc set to it: straight into the block that the top entry of
+// the return stack links to, if that is the block at the target, and otherwise back to the dispatcher. Past the epilog,
+// only volatile host registers are used, and the guest GPR base pointer is pinned.
+void EmitReturnStackExit()
+{
+    RecordBlockCycles();
+    reg_alloc.BlockEpilogWithoutRet();
+    Label l_return = c.newLabel();
+    c.mov(ecx, JitPtr(return_stack_top));
+    c.cmp(eax, JitPtrOffset(return_stack[0].guest_vaddr, rcx));
+    c.jne(l_return); // mispredicted; the entry stays, for a return further up the call chain
+    c.lea(edx, ptr(rcx, -s32(sizeof(ReturnStackEntry))));
+    c.and_(edx, sizeof(return_stack) - 1);
+    c.mov(JitPtr(return_stack_top), edx);
+    c.mov(eax, JitPtr(cycle_counter));
+    c.cmp(eax, JitPtr(cycle_budget));
+    c.jae(l_return); // out of cycles
+    c.mov(host_gpr_arg[0], JitPtrOffset(&return_stack[0].link, rcx));
+    c.jmp(qword_ptr(host_gpr_arg[0], offsetof(BlockLink, host_target)));
+    c.bind(l_return);
+    c.ret();
+}
+
+// At a call, pushes its return address onto the return stack, along with a link to the block there, for
+// EmitReturnStackExit to jump through once jr $ra goes back there. Only rax and xmm0, scratch registers, are used.
+void EmitReturnStackPush(IrInst const& branch)
+{
+    u32 return_addr = jit_pc + 8;
+    if (!enable_ee_jit_return_stack || !guest_gpr_base_ptr_is_pinned || branch.dst != 31
+        || branch.branch_cond != IrBranchCond::Always || !CanLinkTo(return_addr)) {
+        return;
+    }
+    c.lea(rax, ptr(NewBlockLink(return_addr)));
+    c.vmovq(xmm0, rax);
+    c.mov(eax, JitPtr(return_stack_top));
+    c.add(eax, sizeof(ReturnStackEntry));
+    c.and_(eax, sizeof(return_stack) - 1);
+    c.mov(JitPtr(return_stack_top), eax);
+    c.vmovq(JitPtrOffset(&return_stack[0].link, rax), xmm0);
+    c.mov(JitPtrOffset(return_stack[0].guest_vaddr, rax), return_addr);
+}
+
+// The exit of a block that ends on a branch resolved at compile time, after its delay slot
+void EmitStaticBranchExit(IrInst const& branch, u32 dead_gprs)
+{
+    if (bool* flag = StaticBranchDelaySlotFlag(branch)) {
+        c.mov(JitPtr(flag), 0);
+    }
+    if (branch.branch_outcome == IrBranchOutcome::NotTaken) {
+        FlushPc();
+        BlockEpilogWithLink(jit_pc, dead_gprs);
+    } else {
+        EmitDirectBranchExit(u32(branch.imm), dead_gprs);
+    }
+}
+
+template<std::unsigned_integral UInt> void EmitStore(u32 rs, u32 rt, s16 imm)
+{
+    if (std::optional<u64> base = reg_alloc.GetConst(rs)) {
+        if (EmitConstAddressStore<UInt>(u32(*base) + imm, rt)) {
+            return;
+        }
+    }
+    HostGpr64 hs = reg_alloc.GetGpr(rs), ht = reg_alloc.GetGpr(rt);
+    c.lea(eax, ptr(hs, imm));
+    Label l_slow_path = c.newLabel(), l_done = c.newLabel();
+    EmitFastmemAccess(sizeof(UInt), l_slow_path, l_done, [ht] {
+        Mem dst = ptr(rax, 0, sizeof(UInt));
+        if constexpr (sizeof(UInt) == 8) c.mov(dst, ht);
+        else if constexpr (sizeof(UInt) == 4) c.mov(dst, ht.r32());
+        else if constexpr (sizeof(UInt) == 2) c.mov(dst, ht.r16());
+        else c.mov(dst, ht.r8());
+    });
+    EmitMemorySlowPath(l_slow_path, l_done, [ht](AccessSite const& site) {
+        EmitMemoryAccessCall(SlowWrite<UInt>, &ht, site);
+    });
+}
+
+void EmitStoreQuad(u32 rs, u32 rt, s16 imm)
+{
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    HostGpr128 ht = reg_alloc.GetVpr(rt);
+    c.lea(eax, ptr(hs, imm));
+    c.and_(eax, ~15);
+    Label l_slow_path = c.newLabel(), l_done = c.newLabel();
+    EmitFastmemAccess(16, l_slow_path, l_done, [ht] { c.vmovdqu(xmmword_ptr(rax), ht); });
+    EmitMemorySlowPath(l_slow_path, l_done, [ht](AccessSite const& site) {
+        c.vmovdqu(JitPtr(slow_path_quad), ht);
+        EmitMemoryAccessCall(SlowWriteQuad, nullptr, site);
+    });
+}
+
+void EmitStoreWordFromMem(u32 rs, s16 imm, Mem src)
+{
+    HostGpr64 hs = reg_alloc.GetGpr(rs);
+    c.vmovd(xmm0, src);
+    c.lea(eax, ptr(hs, imm));
+    Label l_slow_path = c.newLabel(), l_done = c.newLabel();
+    EmitFastmemAccess(4, l_slow_path, l_done, [] { c.vmovd(dword_ptr(rax), xmm0); });
+    EmitMemorySlowPath(l_slow_path, l_done, [](AccessSite const& site) {
+        c.vmovd(JitPtr(slow_path_quad, 4), xmm0);
+        EmitMemoryAccessCall(SlowWriteWordFromQuad, nullptr, site);
+    });
+}
+
+template<typename Emitter> void EndBlockFunction(Emitter& emitter)
+{
+    if constexpr (std::derived_from<Emitter, BaseCompiler>) {
+        emitter.endFunc();
+    }
+}
+
+// The guest registers that the block run after this one may read before writing them: all of them, unless that block is
+// known at compile time, and starts within the span of this one (see IsWithinBlockSpan). Its code then cannot change
+// without this block being invalidated too, and the disk cache validates it along with this block's, as it is appended
+// to block_instructions.
+u64 ExitLiveRegisters()
+{
+    IrInst const* branch = ir_block.StaticBranch();
+    if (!branch || log_ee_branches) {
+        return ir_all_registers;
+    }
+    u32 successor = branch->branch_outcome == IrBranchOutcome::Taken ? u32(branch->imm)
+                                                                      : ir_block.insts.back().vaddr + 4;
+    if (!IsWithinBlockSpan(successor)) {
+        return ir_all_registers;
+    }
+    std::vector<u32> instructions;
+    bool delay_slot = false;
+    for (u32 vaddr = successor;;) {
+        u32 instr = FetchSpanInstruction(vaddr);
+        if (compiler_exception_occurred) {
+            compiler_exception_occurred = false;
+            return ir_all_registers;
+        }
+        instructions.push_back(instr);
+        vaddr += 4;
+        if (delay_slot || !IsWithinBlockSpan(vaddr)) {
+            break;
+        }
+        delay_slot = IsBranchInstruction(instr);
+    }
+    // The IR passes only ever remove reads; without them, and with jumps not followed, the liveness is conservative
+    IrBlock successor_ir = BuildIr(successor, instructions);
+    ComputeLiveness(successor_ir, ir_all_registers);
+    return successor_ir.insts.front().live_in;
+}
+
+// Fetches the instructions of the block at block_pc to block_path_vaddrs and block_path_instructions: up to the end of
+// the span of the block, or up to and including the delay slot of its first branch, or up to an instruction that cannot
+// be fetched. Forward unconditional jumps within the span are followed, except for one that starts the block, which
+// may be in the delay slot of the branch that ended the previous block. block_instructions receives the guest code
+// from block_pc up to the furthest instruction fetched, skipped parts included; the block depends on all of it.
+void FetchBlock()
+{
+    block_instructions.clear();
+    block_path_vaddrs.clear();
+    block_path_instructions.clear();
+    compiler_exception_occurred = false;
+    bool delay_slot = false;
+    std::optional<u32> jump_target;
+    for (u32 vaddr = block_pc;;) {
+        u32 instr = FetchSpanInstruction(vaddr);
+        if (compiler_exception_occurred) {
+            return;
+        }
+        block_path_vaddrs.push_back(vaddr);
+        block_path_instructions.push_back(instr);
+        vaddr += 4;
+        if (delay_slot) {
+            if (!jump_target) {
+                return;
+            }
+            vaddr = *std::exchange(jump_target, std::nullopt);
+            delay_slot = false;
+            continue;
+        }
+        if (!IsWithinBlockSpan(vaddr)) {
+            return;
+        }
+        delay_slot = IsBranchInstruction(instr);
+        if (enable_ee_jit_superblocks && delay_slot && block_path_vaddrs.size() > 1) {
+            // Forward only, so that no instruction is compiled twice
+            std::optional<u32> target = UnconditionalJumpTarget(instr, vaddr - 4);
+            if (target && *target > vaddr && IsWithinBlockSpan(*target)) {
+                jump_target = target;
+            }
+        }
+    }
+}
+
+u32 FetchInstruction(u32 vaddr)
+{
+    if (!instruction_snapshot.empty()) {
+        assert(vaddr - block_pc < instruction_snapshot.size() * 4); // see IsWithinBlockSpan
+        return instruction_snapshot[(vaddr - block_pc) / 4];
+    }
+    return virtual_read<u32, Alignment::Aligned, MemOp::InstrFetch>(vaddr);
+}
+
+// The instruction at vaddr, within the span of the block, with the guest code of the span fetched up to it
+u32 FetchSpanInstruction(u32 vaddr)
+{
+    size_t index = (vaddr - block_pc) / 4;
+    while (block_instructions.size() <= index) {
+        u32 instr = FetchInstruction(block_pc + 4 * u32(block_instructions.size()));
+        if (compiler_exception_occurred) {
+            return 0;
+        }
+        block_instructions.push_back(instr);
+    }
+    return block_instructions[index];
+}
+
+bool FinalizeBlock()
+{
+    EmitColdPaths();
+    EndBlockFunction(c);
+    for (PendingLink const& link : pending_links) {
+        static_assert(offsetof(BlockLink, host_target) == 0 && offsetof(BlockLink, guest_paddr) == 8);
+        c.align(AlignMode::kData, alignof(BlockLink));
+        c.bind(link.label);
+        c.embedUInt64(reinterpret_cast<uintptr_t>(LinkBlock));
+        c.embedUInt32(link.guest_paddr);
+    }
+    asmjit::Error err = FinalizeBlockCode(c);
+    if (err) {
+        log_fatal("Failed to finalize code block; returned {}", asmjit::DebugUtils::errorAsString(err));
+        return false;
+    }
+    return true;
+}
+
+template<typename Emitter> asmjit::Error FinalizeBlockCode(Emitter& emitter)
+{
+    if constexpr (std::derived_from<Emitter, BaseCompiler>) {
+        return emitter.finalize();
+    } else {
+        return kErrorOk;
+    }
+}
+
+// pc equals block_pc until the block flushes it, which it does only on its way out
+void FlushPc(int pc_offset)
+{
+    u32 new_pc = jit_pc + pc_offset;
+    if (new_pc - block_pc < 128) {
+        c.add(JitPtr(pc), new_pc - block_pc);
+    } else {
+        c.mov(JitPtr(pc), new_pc);
+    }
+}
+
+Block& GetBlock(u32 paddr)
+{
+    static_assert(std::has_single_bit(num_pools));
+    Pool*& pool = pools[paddr >> 8 & (num_pools - 1)]; // each pool 6 bits, each instruction 2 bits
+    if (!pool) {
+        pool = allocator.acquire<Pool>(); // TODO: check if OOM
+    }
+    assert(pool);
+    return pool->blocks[paddr >> 2 & 63];
+}
+
+// Host memory holding the guest code at paddr, up to the end of RDRAM or the BIOS, if it lies in either
+std::span<u8 const> GetGuestCode(u32 paddr)
+{
+    if (paddr < rdram.size()) {
+        return std::span(rdram).subspan(paddr);
+    }
+    if (paddr - 0x1C00'0000 < 0x0400'0000) {
+        return std::span(bios).subspan(paddr & (bios.size() - 1));
+    }
+    return {};
+}
+
+// The code must have been finalized. fastmem_offsets receives pairs of the offsets of a fastmem access and its slow
+// path.
+bool GetLabelOffsets(std::vector<u32>& link_offsets, std::vector<u32>& fastmem_offsets)
+{
+    if (code_holder->flatten() != kErrorOk) {
+        return false;
+    }
+    for (PendingLink const& link : pending_links) {
+        link_offsets.push_back(u32(code_holder->labelOffsetFromBase(link.label)));
+    }
+    for (FastmemAccess const& access : fastmem_accesses) {
+        fastmem_offsets.push_back(u32(code_holder->labelOffsetFromBase(access.access)));
+        fastmem_offsets.push_back(u32(code_holder->labelOffsetFromBase(access.slow_path)));
+    }
+    return true;
+}
+
+CodeCache::Stats GetCodeCacheStats()
+{
+    return code_cache.GetStats();
+}
+
+TierStats GetTierStats()
+{
+    return tier_stats;
+}
+
+// num_instructions: of the guest code the block was compiled from, which may extend past the pool of paddr
+Block InstallBlock(asmjit::CodeHolder& code, u32 paddr, u32 vaddr, u32 num_instructions,
+  std::span<u32 const> fastmem_offsets)
+{
+    Block block = reinterpret_cast<Block>(code_cache.Add(code));
+    if (!block) {
+        log_fatal("Failed to add code block to the code cache");
+        return nullptr;
+    }
+    uintptr_t block_addr = reinterpret_cast<uintptr_t>(block);
+    for (size_t i = 0; i + 1 < fastmem_offsets.size(); i += 2) {
+        fastmem_slow_paths[block_addr + fastmem_offsets[i]] = block_addr + fastmem_offsets[i + 1];
+    }
+    // Making room for the block may have reset all pools, so look up where it goes only now
+    GetBlock(paddr) = block;
+    compiled_blocks.push_back({ block, paddr });
+    tier_stats.compiled_blocks++;
+    u32 paddr_last = paddr + 4 * std::max(num_instructions, 1u) - 1;
+    for (u32 pool_index = (paddr >> 8) + 1; pool_index <= paddr_last >> 8; ++pool_index) {
+        std::vector<u32>& spanning = pool_spanning_blocks[pool_index & (num_pools - 1)];
+        if (std::ranges::find(spanning, paddr >> 8) == spanning.end()) {
+            spanning.push_back(paddr >> 8); // invalidating the pool must invalidate the block too
+        }
+    }
+    if constexpr (enable_ee_jit_rdram_write_tracking) {
+        // Writes to the pages must now invalidate the block
+        for (u32 page_paddr = paddr; page_paddr <= paddr_last && page_paddr < rdram.size();
+             page_paddr = u32((page_paddr / rdram_page_size + 1) * rdram_page_size)) {
+            ProtectRdramPage(page_paddr);
+        }
+    }
+    if (jit_perf::is_open()) {
+        jit_perf::record_code(reinterpret_cast<void const*>(block), code.codeSize(),
+          std::format("ee_block_{:08X}", vaddr));
+    }
+    CloseBlockProfilingInterval(); // don't charge the compilation to the block entered before it
+    return block;
+}
+
+// Called on the EE thread, which is the only one to touch the pools and the code cache
+void InstallCompiledBlocks()
+{
+    if (!compile_jobs_finished.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<std::unique_ptr<CompileJob>> jobs;
+    {
+        std::lock_guard lock(compile_jobs_mutex);
+        jobs.swap(finished_compile_jobs);
+        compile_jobs_finished.store(false, std::memory_order_relaxed);
+    }
+    for (std::unique_ptr<CompileJob> const& job : jobs) {
+        pending_compile_jobs.erase(job->paddr);
+        std::span<u8 const> guest_code = GetGuestCode(job->paddr);
+        bool stale = job->epoch != compile_epoch || guest_code.size() < job->num_instructions * 4
+                  || std::memcmp(guest_code.data(), job->instructions.data(), job->num_instructions * 4) != 0;
+        if (!job->ok || stale || GetBlock(job->paddr)) { // the last: compiled on the EE thread in the meantime
+            tier_stats.discarded_compilations++;
+            continue;
+        }
+        if (JitDiskCacheIsOpen()) {
+            std::span<u32 const> instructions{ job->instructions.data(), job->num_instructions };
+            StoreBlockToJitDiskCache(job->paddr, job->vaddr, instructions, job->code, job->link_offsets,
+              job->fastmem_offsets);
+        }
+        InstallBlock(job->code, job->paddr, job->vaddr, job->num_instructions, job->fastmem_offsets);
+        interpreted_block_counts.erase(job->paddr);
+        tier_stats.background_compilations++;
+    }
+}
+
+// Blocks are interpreted the first compile_threshold times they are entered, so that code that only ever runs a few
+// times, such as most of the BIOS boot code, is never compiled. Returns null unless the block was compiled.
+Block InterpretOrCompile(u32 paddr)
+{
+    if (ShouldCompile(paddr)) {
+        if (!QueueCompileJob(paddr)) {
+            interpreted_block_counts.erase(paddr);
+            return compile(paddr);
+        }
+        // Keep interpreting the block until a compile worker is done with it
+    } else if (JitDiskCacheIsOpen() && !BlockProfilingEnabled()) {
+        if (Block block = LoadCachedBlock(paddr)) {
+            interpreted_block_counts.erase(paddr);
+            return block; // compiled in an earlier session; as cheap to load as it is to interpret
+        }
+    }
+    interpreted_block_counts[paddr]++;
+    CloseBlockProfilingInterval(); // don't charge the interpreted code to the block entered before it
+    interpreter::BlockRun run = interpreter::run_block();
+    tier_stats.interpreted_blocks++;
+    tier_stats.interpreted_instructions += run.instructions;
+    if (!run.reached_jit_only_instruction) {
+        return nullptr;
+    }
+    // pc points to an instruction that only the JIT implements, and was fetched without an exception just now
+    exception_occurred = false;
+    u32 next_paddr = devirtualize(pc);
+    if (exception_occurred) {
+        return nullptr;
+    }
+    interpreted_block_counts[paddr] = std::max(interpreted_block_counts[paddr], compile_threshold);
+    interpreted_block_counts.erase(next_paddr);
+    tier_stats.forced_compilations++;
+    Block block = GetBlock(next_paddr);
+    return block ? block : compile(next_paddr);
+}
+
+Status InitJit()
+{
+    // First, as the rdram and bios arrays become views of the memory shared with the fastmem arena
+    if constexpr (enable_ee_jit_fastmem) {
+        Status status = InitFastmem();
+        if (!status.Ok()) {
+            log_warn("EE JIT fastmem is not in use: {}", status.Message());
+        }
+    }
+    InitMmi(jit_runtime.cpuFeatures());
+    allocator.allocate(64_MiB);
+    pools = static_cast<Pool**>(host_memory::allocate(num_pools * sizeof(Pool*)));
+    if (!pools) {
+        return FailureStatus("Failed to allocate EE JIT block lookup table");
+    }
+    Status status = code_cache.Init(ee_jit_code_cache_size, ee_jit_code_cache_generations,
+      enable_ee_jit_code_cache_dual_mapping, OnCodeCacheEvict);
+    if (!status.Ok()) {
+        return status;
+    }
+    if constexpr (enable_ee_jit_rdram_write_tracking) {
+        rdram_page_size = host_memory::page_size();
+        assert(std::has_single_bit(rdram_page_size) && alignof(decltype(rdram)) % rdram_page_size == 0);
+        protected_rdram_pages.assign(rdram.size() / rdram_page_size, false);
+        status = host_memory::add_fault_handler(OnRdramWriteFault);
+        if (!status.Ok()) {
+            return status;
+        }
+    }
+    if (FastmemIsEnabled()) {
+        status = host_memory::add_fault_handler(OnFastmemFault); // after OnRdramWriteFault, which goes first
+        if (!status.Ok()) {
+            return status;
+        }
+    }
+    InvalidateReturnStack();
+    for (u32 i = 0; i < ee_jit_compile_workers; ++i) {
+        compile_workers.emplace_back(RunCompileWorker);
+    }
+    if constexpr (guest_gpr_base_ptr_is_pinned) {
+        return EmitDispatcher();
+    }
+    return OkStatus();
+}
+
+void Invalidate(u32 paddr)
+{
+    assert(paddr < pool_max_addr_excl);
+    ResetPool(paddr >> 8 & (num_pools - 1)); // each pool 6 bits, each instruction 2 bits
+}
+
+// Neither the blocks nor the lookup table are walked; the memory backing the pools and the table is simply handed
+// back to the host, and reads back as zero.
+void InvalidateAll()
+{
+    if (!pools) {
+        return;
+    }
+    host_memory::decommit(pools, num_pools * sizeof(Pool*));
+    allocator.reset();
+    pool_links.clear();
+    pool_spanning_blocks.clear();
+    compiled_blocks.clear();
+    pending_compile_jobs.clear();
+    compile_epoch++;
+    InvalidateReturnStack(); // the links it holds may be evicted along with their blocks
+}
+
+void InvalidateReturnStack()
+{
+    // A misaligned address never matches the target of a return, which is checked for alignment first
+    return_stack.fill({ .link = nullptr, .guest_vaddr = 1 });
+}
+
+void InvalidateRange(u32 paddr_lo, u32 paddr_hi)
+{
+    assert(paddr_lo <= paddr_hi);
+    assert(paddr_hi < pool_max_addr_excl);
+    u32 pool_lo = paddr_lo >> 8;
+    u32 pool_hi = paddr_hi >> 8;
+    for (u32 pool_index = pool_lo; pool_index <= pool_hi; ++pool_index) {
+        ResetPool(pool_index);
+    }
+}
+
+bool IsBranchToBlockStart(IrInst const& inst)
+{
+    return inst.op == IrOp::Branch && inst.branch_direct && u32(inst.imm) == block_pc
+        && inst.branch_outcome != IrBranchOutcome::NotTaken;
+}
+
+// Blocks span at most ee_jit_max_block_span bytes of guest code from their start, within the page of their start, or
+// within kseg0 or kseg1, whose translation is fixed. The span is thus contiguous in physical memory too.
+bool IsWithinBlockSpan(u32 vaddr)
+{
+    u32 offset = vaddr - block_pc;
+    if (offset >= ee_jit_max_block_span) {
+        return false;
+    }
+    if (!instruction_snapshot.empty() && offset / 4 >= instruction_snapshot.size()) {
+        return false; // the snapshot of a compile job ends early at the end of RDRAM or the BIOS
+    }
+    bool unmapped_segment = block_pc - 0x8000'0000 < 0x4000'0000 && (vaddr ^ block_pc) < 0x2000'0000;
+    bool same_page = (vaddr ^ block_pc) < 0x1000;
+    return unmapped_segment || same_page;
+}
+
+// Entered through a jump from the exit of a block, in place of its successor, while the exit is unlinked. The block
+// has flushed the guest pc and torn down its frame beforehand, so returning from here returns to the dispatcher.
+void LinkBlock(BlockLink* link)
+{
+    exception_occurred = false;
+    u32 paddr = devirtualize(pc);
+    if (exception_occurred || paddr != link->guest_paddr) {
+        return;
+    }
+    Block block = GetBlock(paddr);
+    if (!block) {
+        if (!ShouldCompile(paddr) || QueueCompileJob(paddr)) {
+            return; // the successor is still interpreted, from the dispatcher; it is linked once compiled
+        }
+        interpreted_block_counts.erase(paddr);
+        u64 evictions = code_cache_evictions;
+        block = compile(paddr);
+        if (evictions != code_cache_evictions) {
+            return; // making room for the block may have evicted the link itself
+        }
+    }
+    code_cache.Write(&link->host_target, block);
+    pool_links[paddr >> 8 & (num_pools - 1)].push_back(link);
+}
+
+Block LoadCachedBlock(u32 paddr)
+{
+    ResetCodeHolder();
+    std::vector<u32> link_offsets, fastmem_offsets;
+    auto fetch_instruction = [](u32 vaddr) -> std::optional<u32> {
+        exception_occurred = false;
+        u32 instr = FetchInstruction(vaddr);
+        return exception_occurred ? std::nullopt : std::optional{ instr };
+    };
+    u32 num_instructions;
+    if (!LoadBlockFromJitDiskCache(paddr, pc, fetch_instruction, *code_holder, num_instructions, link_offsets,
+          fastmem_offsets)) {
+        return nullptr;
+    }
+    if (!fastmem_offsets.empty() && !FastmemIsEnabled()) {
+        return nullptr; // compiled in a session that had fastmem, which the block accesses guest memory through
+    }
+    Block block = InstallBlock(*code_holder, paddr, pc, num_instructions, fastmem_offsets);
+    for (u32 link_offset : link_offsets) {
+        auto link = reinterpret_cast<BlockLink*>(reinterpret_cast<u8*>(block) + link_offset);
+        code_cache.Write(&link->host_target, reinterpret_cast<Block>(LinkBlock));
+    }
+    return block;
+}
+
+// Called by the dispatcher when the block at pc cannot be found inline, and by the C++ dispatch loop. Returns null if
+// an exception occurred while translating pc; pc then points to the exception handler, which is looked up next.
+Block LookupBlock()
+{
+    InstallCompiledBlocks();
+    exception_occurred = false;
+    u32 paddr = devirtualize(pc);
+    if (exception_occurred) {
+        return nullptr;
+    }
+    Block block = GetBlock(paddr);
+    if (!block) {
+        block = InterpretOrCompile(paddr);
+    }
+    return block;
+}
+
+// A link to the block at target, which CanLinkTo; emitted by FinalizeBlock
+Label NewBlockLink(u32 target)
+{
+    // The TLB is not consulted; CanLinkTo only accepts targets whose translation follows from that of the block
+    u32 target_paddr = target - 0x8000'0000 < 0x4000'0000 ? target & 0x1FFF'FFFF : block_paddr + (target - block_pc);
+    Label l_link = c.newLabel();
+    pending_links.push_back({ l_link, target_paddr });
+    return l_link;
+}
+
+// Where the block is left for the exception handler from, once a call made at the current point of the block raised an
+// exception: an entry of the stub for the current state of the register allocator, emitted by EmitColdPaths
+Label NewExceptionExit()
+{
+    RegisterAllocator::ExitState state = reg_alloc.GetExitState();
+    auto stub = std::ranges::find(exception_exit_stubs, state, &ExceptionExitStub::state);
+    if (stub == exception_exit_stubs.end()) {
+        stub = exception_exit_stubs.insert(stub, { state, {} });
+    }
+    auto entry = std::ranges::find(stub->entries, block_cycles, &std::pair<u32, Label>::first);
+    if (entry == stub->entries.end()) {
+        entry = stub->entries.insert(entry, { block_cycles, c.newLabel() });
+    }
+    return entry->second;
+}
+
+void OnBranchNotTaken()
+{
+    c.mov(JitPtr(in_branch_delay_slot_taken), 0);
+    c.mov(JitPtr(in_branch_delay_slot_not_taken), 1);
+    c.mov(JitPtr(branch_state), std::to_underlying(mips::BranchState::NoBranch));
+}
+
+// Before code is overwritten, forget about the blocks in it, and about the links embedded with them.
+void OnCodeCacheEvict(u8 const* begin, u8 const* end)
+{
+    auto is_evicted = [begin, end](void const* ptr) { return ptr >= begin && ptr < end; };
+    std::erase_if(fastmem_slow_paths,
+      [&](auto const& access) { return is_evicted(reinterpret_cast<void const*>(access.first)); });
+    if (!compiled_blocks.empty() && is_evicted(reinterpret_cast<void const*>(compiled_blocks.back().block))) {
+        InvalidateAll(); // blocks are evicted oldest first, so if the newest one goes, so do all others
+        code_cache_evictions++;
+        return;
+    }
+    while (!compiled_blocks.empty() && is_evicted(reinterpret_cast<void const*>(compiled_blocks.front().block))) {
+        auto [block, paddr] = compiled_blocks.front();
+        compiled_blocks.pop_front();
+        u32 pool_index = paddr >> 8 & (num_pools - 1);
+        Pool* pool = pools[pool_index];
+        if (pool && pool->blocks[paddr >> 2 & 63] == block) {
+            ResetPool(pool_index);
+        }
+    }
+    for (auto& [pool_index, links] : pool_links) {
+        std::erase_if(links, is_evicted);
+    }
+    InvalidateReturnStack();
+    code_cache_evictions++;
+}
+
+// A fastmem access faulted: its guest address is not backed by RDRAM or the BIOS in the fastmem arena (IO, the
+// scratchpad, or a page only the MMU can translate), or it is a store to the BIOS. The access would most likely keep
+// faulting, so it is patched for good into a jump to its slow path, where execution resumes.
+bool OnFastmemFault(void* fault_addr, void* host_context)
+{
+    if (!FastmemContains(fault_addr)) {
+        return false;
+    }
+    auto access = fastmem_slow_paths.find(host_memory::get_fault_pc(host_context));
+    if (access == fastmem_slow_paths.end()) {
+        return false;
+    }
+    auto [access_addr, slow_path] = *access;
+    std::array<u8, 5> jmp = { 0xE9 }; // jmp rel32
+    s32 rel = s32(slow_path - (access_addr + jmp.size()));
+    std::memcpy(&jmp[1], &rel, sizeof(rel));
+    code_cache.Write(reinterpret_cast<std::array<u8, 5>*>(access_addr), jmp);
+    host_memory::set_fault_pc(host_context, slow_path);
+    return true;
+}
+
+// Stores to an RDRAM page that code has been compiled from fault, since the page is write-protected, in the rdram
+// array and in every fastmem view of it. The fault is synchronous to the emulator thread, which is either running JIT
+// code or in the memory write path, but never in the middle of modifying JIT state; therefore, the pools of the page
+// can be invalidated directly from here.
+bool OnRdramWriteFault(void* fault_addr, void* /*host_context*/)
+{
+    std::optional<u32> paddr = RdramOffsetOfHostAddress(fault_addr);
+    if (!paddr) {
+        return false;
+    }
+    size_t page = *paddr / rdram_page_size;
+    if (!protected_rdram_pages[page]) {
+        return false;
+    }
+    u32 paddr_lo = u32(page * rdram_page_size);
+    InvalidateRange(paddr_lo, u32(paddr_lo + rdram_page_size - 1));
+    ProtectRdram(paddr_lo, u32(rdram_page_size), host_memory::Protection::ReadWrite);
+    protected_rdram_pages[page] = false;
+    return true;
+}
+
+void PerformBranch()
+{
+    in_branch_delay_slot_taken = false;
+    branch_state = mips::BranchState::NoBranch;
+    pc = jump_addr;
+    if (pc & 3) {
+        address_error_exception(pc, MemOp::InstrFetch);
+    }
+    if constexpr (log_ee_branches) {
+        log_info("EE branch to 0x{:016X}; RA = 0x{:016X}; SP = 0x{:016X}", u64(pc), u64(gpr[31]), u64(gpr[29]));
+    }
+}
+
+void ProtectRdramPage(u32 paddr)
+{
+    size_t page = paddr / rdram_page_size;
+    if (!protected_rdram_pages[page]) {
+        u32 paddr_lo = u32(page * rdram_page_size);
+        protected_rdram_pages[page] =
+          ProtectRdram(paddr_lo, u32(rdram_page_size), host_memory::Protection::ReadOnly);
+    }
+}
+
+// Returns false if the block is to be compiled on the EE thread instead: when there are no compile workers, when its
+// code cannot be copied for a worker, and when profiling, as the profiles are only accessed from the EE thread.
+bool QueueCompileJob(u32 paddr)
+{
+    if (compile_workers.empty() || BlockProfilingEnabled()) {
+        return false;
+    }
+    if (pending_compile_jobs.contains(paddr)) {
+        return true;
+    }
+    std::span<u8 const> guest_code = GetGuestCode(paddr);
+    if (guest_code.size() < 4) {
+        return false;
+    }
+    auto job = std::make_unique<CompileJob>();
+    job->instructions.resize(std::min<size_t>(ee_jit_max_block_span, guest_code.size()) / 4);
+    std::memcpy(job->instructions.data(), guest_code.data(), job->instructions.size() * 4);
+    job->epoch = compile_epoch;
+    job->paddr = paddr;
+    job->vaddr = pc;
+    pending_compile_jobs.insert(paddr);
+    {
+        std::lock_guard lock(compile_jobs_mutex);
+        queued_compile_jobs.push_back(std::move(job));
+    }
+    compile_jobs_cv.notify_one();
+    return true;
+}
+
+// The exception paths of a delay slot compiled in place set the delay slot flag only for as long as the exception
+// handler needs it; the flag is otherwise left clear, the branch being decided within the block
+void RaiseInDelaySlot()
+{
+    in_branch_delay_slot_taken = true;
+    delay_slot_exception();
+    in_branch_delay_slot_taken = false;
+}
+
+void RecordBlockCycles()
+{
+    assert(block_cycles > 0);
+    c.add(JitPtr(cycle_counter), block_cycles);
+    c.add(JitPtr(cop0.count), block_cycles);
+}
+
+void ResetCodeHolder()
+{
+    code_holder->reset();
+    asmjit::Error err = code_holder->init(jit_runtime.environment(), jit_runtime.cpuFeatures());
+    if (err) [[unlikely]] {
+        log_fatal("Failed to init asmjit code holder; returned {}", asmjit::DebugUtils::errorAsString(err));
+    }
+    if constexpr (enable_ee_jit_error_handler) {
+        static AsmjitLogErrorHandler asmjit_log_error_handler{};
+        code_holder->setErrorHandler(&asmjit_log_error_handler);
+    }
+}
+
+// The code of the blocks stays in the code cache until it is evicted, which happens only while compiling. The
+// invalidation may come from a store made by one of the blocks of the pool itself, which then keeps running after
+// the store.
+void ResetPool(u32 pool_index)
+{
+    Pool* pool = pools[pool_index];
+    if (pool) {
+        UnlinkPool(pool_index);
+        pool->blocks = {};
+    }
+    auto spanning = pool_spanning_blocks.extract(pool_index);
+    if (!spanning.empty()) {
+        for (u32 first_pool_index : spanning.mapped()) {
+            ResetPool(first_pool_index);
+        }
+    }
+}
+
+// The physical memory behind a guest address known at compile time, if it is fixed: the address must be aligned, and
+// in kseg0 or kseg1, which bypass the TLB. Unmapped addresses are left to the MMU.
+std::optional<PhysicalMapping> ResolveConstAddress(u32 vaddr, u32 size)
+{
+    if ((vaddr & (size - 1)) || vaddr < 0x8000'0000 || vaddr >= 0xC000'0000) {
+        return {};
+    }
+    PhysicalMapping mapping = get_physical_mapping(vaddr & 0x1FFF'FFFF);
+    if (!mapping.host && !mapping.io_handlers) {
+        return {};
+    }
+    return mapping;
+}
+
+void RunCompileWorker(std::stop_token stop_token)
+{
+    while (true) {
+        std::unique_ptr<CompileJob> job;
+        {
+            std::unique_lock lock(compile_jobs_mutex);
+            if (!compile_jobs_cv.wait(lock, stop_token, [] { return !queued_compile_jobs.empty(); })) {
+                return;
+            }
+            job = std::move(queued_compile_jobs.front());
+            queued_compile_jobs.pop_front();
+        }
+        code_holder = &job->code;
+        instruction_snapshot = job->instructions;
+        job->ok = Translate(job->paddr, job->vaddr, false)
+               && GetLabelOffsets(job->link_offsets, job->fastmem_offsets);
+        job->num_instructions = u32(block_instructions.size());
+        job->code.detach(&c); // the code belongs to the EE thread from here on
+        instruction_snapshot = {};
+        std::lock_guard lock(compile_jobs_mutex);
+        finished_compile_jobs.push_back(std::move(job));
+        compile_jobs_finished.store(true, std::memory_order_release);
+    }
+}
+
+u32 RunJit(u32 cycles)
+{
+    cycle_counter = 0;
+    cycle_budget = cycles;
+    CloseBlockProfilingInterval();
+    if constexpr (guest_gpr_base_ptr_is_pinned) {
+        dispatcher();
+    } else {
+        while (cycle_counter < cycles) {
+            if (Block block = LookupBlock()) {
+                block();
+            }
+        }
+    }
+    CloseBlockProfilingInterval();
+    return cycle_counter;
+}
+
+void SetCompileThreshold(u32 threshold)
+{
+    compile_threshold = threshold;
+}
+
+bool ShouldCompile(u32 paddr)
+{
+    if (compile_threshold == 0) {
+        return true;
+    }
+    auto count = interpreted_block_counts.find(paddr);
+    return count != interpreted_block_counts.end() && count->second >= compile_threshold;
+}
+
+// Called by an idle loop as it branches back to its start. Until a scheduler event fires, every iteration would read
+// the same values and branch back again, so the cycles they would take are skipped. Events only fire between the steps
+// of the scheduler, so the skip goes at least to the end of the step.
+void SkipIdleLoop()
+{
+    s64 next_event = scheduler::get_ee_cycles_until_next_event().value_or(0);
+    u32 target = u32(std::clamp<s64>(next_event, cycle_budget, std::numeric_limits<s32>::max()));
+    if (target <= cycle_counter) {
+        return;
+    }
+    u32 skipped = target - cycle_counter;
+    advance_pipeline(skipped);
+    tier_stats.idle_loop_skips++;
+    tier_stats.idle_loop_skipped_cycles += skipped;
+}
+
+// Called from the slow path of guest memory accesses in JIT code
+// Without fastmem, the slow path of an access is its only path, and stays in line
+bool SlowPathsAreOutOfLine()
+{
+    return enable_ee_jit_out_of_line_exits && FastmemIsEnabled();
+}
+
+template<typename Int> u64 SlowRead(u32 vaddr)
+{
+    exception_occurred = false;
+    return u64(s64(Int(virtual_read<std::make_unsigned_t<Int>>(vaddr)))); // extended by the signedness of Int
+}
+
+void SlowReadQuad(u32 vaddr)
+{
+    exception_occurred = false;
+    slow_path_quad = virtual_read<u128>(vaddr);
+}
+
+template<std::unsigned_integral UInt> void SlowWrite(u32 vaddr, u64 value)
+{
+    exception_occurred = false;
+    virtual_write(vaddr, UInt(value));
+}
+
+void SlowWriteQuad(u32 vaddr)
+{
+    exception_occurred = false;
+    virtual_write(vaddr, slow_path_quad);
+}
+
+void SlowWriteWordFromQuad(u32 vaddr)
+{
+    exception_occurred = false;
+    virtual_write(vaddr, u32(slow_path_quad));
+}
+
+// The flag that tells exception handlers that they interrupt a branch delay slot, for a branch resolved at compile
+// time; only set around delay slots that may raise an exception, unless their exception paths set it themselves
+bool* StaticBranchDelaySlotFlag(IrInst const& branch)
+{
+    if (enable_ee_jit_static_delay_slots || !(&branch)[1].may_raise) {
+        return nullptr;
+    }
+    return branch.branch_outcome == IrBranchOutcome::NotTaken ? &in_branch_delay_slot_not_taken
+                                                               : &in_branch_delay_slot_taken;
+}
+
+template<typename Target>
+void TakeBranch(Target target)
+    requires(std::same_as<Target, u32> || std::same_as<Target, HostGpr32>)
+{
+    c.mov(JitPtr(in_branch_delay_slot_taken), 1);
+    c.mov(JitPtr(in_branch_delay_slot_not_taken), 0);
+    c.mov(JitPtr(branch_state), std::to_underlying(mips::BranchState::Perform));
+    c.mov(JitPtr(jump_addr), target);
+    if constexpr (std::same_as<Target, u32>) {
+        static_branch_target = target;
+    } else {
+        static_branch_target = {};
+    }
+}
+
+void TearDownJit()
+{
+    if (tier_stats.interpreted_blocks > 0) {
+        log_info("EE JIT: {} blocks compiled ({} early, {} in the background, {} discarded); {} block runs, {} "
+                 "instructions interpreted",
+          tier_stats.compiled_blocks, tier_stats.forced_compilations, tier_stats.background_compilations,
+          tier_stats.discarded_compilations, tier_stats.interpreted_blocks, tier_stats.interpreted_instructions);
+    }
+    if (tier_stats.idle_loop_skips > 0) {
+        log_info("EE JIT: {} idle loop iterations skipped, {} cycles in total", tier_stats.idle_loop_skips,
+          tier_stats.idle_loop_skipped_cycles);
+    }
+    compile_workers.clear(); // stops and joins them
+    queued_compile_jobs.clear();
+    finished_compile_jobs.clear();
+    compile_jobs_finished = false;
+    pending_compile_jobs.clear();
+    tier_stats = {};
+    interpreted_block_counts.clear();
+    CloseJitDiskCache();
+    allocator.deallocate();
+    if (pools) {
+        host_memory::free(pools, num_pools * sizeof(Pool*));
+        pools = nullptr;
+    }
+    pool_links.clear();
+    pool_spanning_blocks.clear();
+    compiled_blocks.clear();
+    fastmem_slow_paths.clear();
+    code_cache.TearDown();
+    if constexpr (enable_ee_jit_rdram_write_tracking) {
+        host_memory::remove_fault_handler(OnRdramWriteFault);
+        ProtectRdram(0, u32(rdram.size()), host_memory::Protection::ReadWrite);
+        protected_rdram_pages.clear();
+    }
+    host_memory::remove_fault_handler(OnFastmemFault);
+    TearDownFastmem();
+    if (dispatcher) {
+        jit_runtime.release(dispatcher);
+        dispatcher = nullptr;
+    }
+}
+
+// Compiles the block at paddr into code_holder. On a compile worker, this touches no state shared with the EE thread.
+bool Translate(u32 paddr, u32 vaddr, bool profile)
+{
+    block_pc = jit_pc = vaddr;
+    block_paddr = paddr;
+    branched = block_has_branch_instr = false;
+    static_branch_target = {};
+    block_dynamic_branch = nullptr;
+    pending_links.clear();
+    fastmem_accesses.clear();
+    cold_paths.clear();
+    exception_exit_stubs.clear();
+    block_cycles = 0;
+    block_index = 0;
+
+    FetchBlock();
+    ir_block = BuildIr(block_path_vaddrs, block_path_instructions);
+    RunIrPasses(ir_block);
+    u64 exit_live_registers = ExitLiveRegisters();
+    ComputeLiveness(ir_block, exit_live_registers);
+    block_is_idle_loop = enable_ee_jit_idle_loop_skipping && IsIdleLoop(ir_block);
+    if constexpr (log_ee_jit_ir) {
+        jit_logger.log(DumpIr(ir_block).c_str());
+    }
+
+    BlockProlog();
+    block_profile = profile ? EmitBlockProfilingProlog(paddr, block_pc) : nullptr;
+    // Profiles count the runs of the block by its entries
+    block_loop_head = {};
+    if (enable_ee_jit_native_loops && !profile && std::ranges::any_of(ir_block.insts, IsBranchToBlockStart)) {
+        reg_alloc.LoopHead();
+        block_loop_head = c.newLabel();
+        c.bind(block_loop_head);
+    }
+
+    EmitInstruction();
+    if (compiler_exception_occurred) {
+        BlockEpilog();
+        return FinalizeBlock();
+    }
+
+    // If the previously executed block ended with a branch instruction, meaning that the branch delay
+    // slot did not fit, execute only the first instruction in this block, before jumping.
+    // The jump can be cancelled if the first instruction is also a branch.
+    if (!branch_hit) {
+        UpdateBranchState();
+    }
+
+    while (!branched && !compiler_exception_occurred && block_index < ir_block.insts.size()) {
+        branched |= branch_hit; // If the branch delay slot instruction fits within the block boundary,
+                                // include it before stopping
+        EmitInstruction();
+    }
+
+    if (compiler_exception_occurred) {
+        BlockEpilog();
+    } else if (IrInst const* branch = ir_block.StaticBranch()) {
+        EmitStaticBranchExit(*branch, ~u32(exit_live_registers));
+    } else if (block_dynamic_branch) {
+        EmitDynamicBranchExit(*block_dynamic_branch);
+    } else {
+        if (!branch_hit && block_has_branch_instr) {
+            UpdateBranchState();
+        }
+        FlushPc();
+        BlockEpilogWithLink(jit_pc);
+    }
+
+    return FinalizeBlock();
+}
+
+void UnlinkPool(u32 pool_index)
+{
+    auto links = pool_links.find(pool_index);
+    if (links != pool_links.end()) {
+        for (BlockLink* link : links->second) {
+            code_cache.Write(&link->host_target, reinterpret_cast<Block>(LinkBlock));
+        }
+        pool_links.erase(links);
+    }
+}
+
+void UpdateBranchState()
+{
+    Label l_nobranch = c.newLabel();
+    c.cmp(JitPtr(branch_state), std::to_underlying(mips::BranchState::Perform));
+    c.jne(l_nobranch);
+    if (static_branch_target && !log_ee_branches) {
+        // Same as PerformBranch, but with the target known, the exit can be linked to the target block
+        c.mov(JitPtr(in_branch_delay_slot_taken), 0);
+        c.mov(JitPtr(branch_state), std::to_underlying(mips::BranchState::NoBranch));
+        c.mov(JitPtr(pc), *static_branch_target);
+        if (*static_branch_target & 3) {
+            BlockEpilogWithJmp([] { address_error_exception(pc, MemOp::InstrFetch); });
+        } else {
+            BlockEpilogWithLink(*static_branch_target);
+        }
+    } else {
+        BlockEpilogWithJmp(PerformBranch);
+    }
     c.bind(l_nobranch);
     c.mov(JitPtr(in_branch_delay_slot_not_taken), 0);
 }
 
+template void EmitLoad<s8>(u32, u32, s16);
+template void EmitLoad<u8>(u32, u32, s16);
+template void EmitLoad<s16>(u32, u32, s16);
+template void EmitLoad<u16>(u32, u32, s16);
+template void EmitLoad<s32>(u32, u32, s16);
+template void EmitLoad<u32>(u32, u32, s16);
+template void EmitLoad<u64>(u32, u32, s16);
+template void EmitStore<u8>(u32, u32, s16);
+template void EmitStore<u16>(u32, u32, s16);
+template void EmitStore<u32>(u32, u32, s16);
+template void EmitStore<u64>(u32, u32, s16);
 template void TakeBranch<u32>(u32);
 template void TakeBranch<HostGpr32>(HostGpr32);
 
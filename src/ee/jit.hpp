@@ -2,6 +2,7 @@
 
 #include "asmjit/a64.h"
 #include "asmjit/x86.h"
+#include "code_cache.hpp"
 #include "ee.hpp"
 #include "jit_common.hpp"
 #include "numtypes.hpp"
@@ -9,10 +10,22 @@
 #include "register_allocator.hpp"
 #include "status.hpp"
 
+#include <concepts>
 #include <type_traits>
 
 namespace ee {
 
+struct TierStats {
+    u64 interpreted_blocks; // block runs in the interpreter
+    u64 interpreted_instructions;
+    u64 compiled_blocks;
+    u64 forced_compilations; // blocks compiled early, as they contain instructions the interpreter lacks
+    u64 background_compilations; // blocks compiled by a compile worker
+    u64 discarded_compilations; // blocks compiled by a compile worker, whose code changed in the meantime
+    u64 idle_loop_skips; // times an idle loop skipped to the next scheduler event
+    u64 idle_loop_skipped_cycles;
+};
+
 void BlockEpilog();
 void BlockEpilogWithJmp(void (*func)());
 void BlockEpilogWithPcFlushAndJmp(void (*func)(), int pc_offset = 0);
@@ -21,30 +34,52 @@ void BlockProlog();
 void RecordBlockCycles();
 void DiscardBranch();
 bool CheckDwordOpCondJit();
+// Compiles the block at pc on the calling thread, and returns the number of guest instructions compiled; for benchmarks
+u32 CompileBlockAtPc();
 void EmitLink(u32 reg);
+// Guest loads and stores, through fastmem if it is in use, and otherwise through the MMU. The signedness of Int
+// decides how the value loaded is extended to 64 bits.
+template<typename Int> void EmitLoad(u32 rs, u32 rt, s16 imm);
+template<std::unsigned_integral UInt> void EmitStore(u32 rs, u32 rt, s16 imm);
+// LQ and SQ; the address is aligned down to 16 bytes
+void EmitLoadQuad(u32 rs, u32 rt, s16 imm);
+void EmitStoreQuad(u32 rs, u32 rt, s16 imm);
+// LWC1 and SWC1: the word at rs + imm is loaded into, or stored from, host memory
+void EmitLoadWordToMem(u32 rs, s16 imm, asmjit::x86::Mem dst);
+void EmitStoreWordFromMem(u32 rs, s16 imm, asmjit::x86::Mem src);
 void FlushPc(int pc_offset = 0);
+CodeCache::Stats GetCodeCacheStats();
+TierStats GetTierStats();
 Status InitJit();
 void Invalidate(u32 paddr);
+void InvalidateAll();
 void InvalidateRange(u32 paddr_lo, u32 paddr_hi);
+// Forgets the calls that returns are predicted to go back from; for when the TLB changes
+void InvalidateReturnStack();
 void OnBranchNotTaken();
 u32 RunJit(u32 cpu_cycles);
+void SetCompileThreshold(u32 threshold);
 template<typename Target>
 void TakeBranch(Target target)
     requires(std::same_as<Target, u32> || std::same_as<Target, HostGpr32>);
 void TearDownJit();
 
-inline JitCompiler c;
-inline RegisterAllocator reg_alloc{ c };
-inline u32 jit_pc;
-inline u32 block_cycles;
 inline mips::BranchState branch_state;
-inline bool branch_hit;
-inline bool branched;
-inline bool compiler_exception_occurred;
 
+// Compiler state; blocks are compiled both on the EE thread and by the background compile workers
+inline thread_local JitCompiler c;
+inline thread_local RegisterAllocator reg_alloc{ c };
+inline thread_local u32 jit_pc;
+inline thread_local u32 block_cycles;
+inline thread_local bool branch_hit;
+inline thread_local bool branched;
+inline thread_local bool compiler_exception_occurred;
+
+// Blocks address the guest state relative to guest_gpr_base_ptr_reg, which points to the middle of gpr, so that every
+// guest register is within a disp8 of it; see EmitDispatcher and RegisterAllocator::BlockProlog
 inline ptrdiff_t get_offset_to_guest_gpr_base_ptr(void const* obj)
 {
-    return static_cast<u8 const*>(obj) - reinterpret_cast<u8 const*>(&gpr) + sizeof(u128) * 16;
+    return static_cast<u8 const*>(obj) - reinterpret_cast<u8 const*>(gpr.data() + gpr.size() / 2);
 }
 
 template<typename T> asmjit::x86::Mem JitPtr(T const& obj, u32 ptr_size = sizeof(std::remove_pointer_t<T>))
@@ -75,7 +110,7 @@ asmjit::x86::Mem JitPtrOffset(T const& obj, asmjit::x86::Gp index, u32 ptr_size
         if constexpr (std::is_pointer_v<T>) return obj;
         else return &obj;
     }();
-    ptrdiff_t diff = reinterpret_cast<u8 const*>(obj_ptr) - reinterpret_cast<u8 const*>(&gpr);
+    ptrdiff_t diff = get_offset_to_guest_gpr_base_ptr(obj_ptr);
     return asmjit::x86::ptr(guest_gpr_base_ptr_reg, index.r64(), 0u, s32(diff), ptr_size);
 }
 
@@ -0,0 +1,332 @@
+#include "jit_disk_cache.hpp"
+#include "asmjit/a64.h"
+#include "asmjit/x86.h"
+#include "cop1.hpp"
+#include "ee.hpp"
+#include "exceptions.hpp"
+#include "host_memory.hpp"
+#include "log.hpp"
+#include "mmi.hpp"
+#include "platform.hpp"
+#include "register_allocator.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <ranges>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace asmjit;
+
+namespace ee {
+
+using Assembler = std::conditional_t<platform.x64, x86::Assembler, a64::Assembler>;
+
+struct FileHeader {
+    std::array<char, 8> magic;
+    u32 format_version;
+    u32 reserved;
+    u64 build_tag;
+};
+
+struct RecordHeader {
+    u32 paddr;
+    u32 vaddr;
+    u64 guest_hash;
+    u32 num_guest_instructions;
+    u32 code_size;
+    u32 num_relocs;
+    u32 num_links;
+    u32 num_fastmem_offsets;
+    u32 reserved;
+};
+
+struct RelocRecord {
+    u64 source_offset;
+    s64 payload; // relative to the executable image if external; otherwise, relative to the code of the block
+    std::array<u8, sizeof(OffsetFormat)> format;
+    u32 type;
+    u32 external;
+};
+
+struct IndexEntry {
+    u64 record_offset;
+    u64 guest_hash;
+    u32 num_guest_instructions;
+};
+
+static std::optional<u64> BuildTag();
+static u64 Fnv1a(u64 hash, void const* data, size_t size);
+static u64 HashInstructions(std::span<u32 const> instructions);
+static bool ReadRecord(u64 record_offset, CodeHolder& code, std::vector<u32>& link_offsets,
+  std::vector<u32>& fastmem_offsets);
+static u64 RecordKey(u32 paddr, u32 vaddr);
+
+constexpr std::array<char, 8> file_magic = { 'N', 'S', 'E', 'E', 'J', 'I', 'T', '\0' };
+constexpr u32 file_format_version = 2;
+constexpr u64 fnv1a_offset_basis = 0xCBF2'9CE4'8422'2325;
+
+static std::fstream file;
+static std::unordered_map<u64, std::vector<IndexEntry>> record_index; // record key => records, oldest first
+static u8 const* image_base;
+
+static_assert(std::is_trivially_copyable_v<OffsetFormat>);
+
+// Anything that changes the layout of the executable, or how code is encoded, invalidates the cache. The code of the
+// executable covers codegen changes and moved relocation targets, whichever translation unit they are in; nullopt if it
+// cannot be found.
+std::optional<u64> BuildTag()
+{
+    std::vector<std::span<u8 const>> image_code = host_memory::module_code(reinterpret_cast<void const*>(&BuildTag));
+    if (image_code.empty()) {
+        return {};
+    }
+    u64 hash = fnv1a_offset_basis;
+    for (std::span<u8 const> segment : image_code) {
+        hash = Fnv1a(hash, segment.data(), segment.size());
+    }
+    std::array<u64, 8> build_properties = {
+        file_format_version,
+        ASMJIT_LIBRARY_VERSION,
+        u64(GetMmiTier()), // the same build compiles MMI instructions differently from host to host
+        u64(GetFpuClampMode()),
+        u64(reinterpret_cast<u8 const*>(&gpr) - image_base),
+        u64(reinterpret_cast<u8 const*>(&cycle_counter) - image_base),
+        u64(reinterpret_cast<u8 const*>(&address_error_exception) - image_base),
+        u64(reinterpret_cast<u8 const*>(&OpenJitDiskCache) - image_base),
+    };
+    return Fnv1a(hash, build_properties.data(), sizeof(build_properties));
+}
+
+void CloseJitDiskCache()
+{
+    if (file.is_open()) {
+        file.close();
+    }
+    record_index.clear();
+}
+
+u64 Fnv1a(u64 hash, void const* data, size_t size)
+{
+    for (u8 byte : std::span{ static_cast<u8 const*>(data), size }) {
+        hash = (hash ^ byte) * 0x100'0000'01B3;
+    }
+    return hash;
+}
+
+u64 HashInstructions(std::span<u32 const> instructions)
+{
+    return Fnv1a(fnv1a_offset_basis, instructions.data(), instructions.size_bytes());
+}
+
+bool JitDiskCacheIsOpen()
+{
+    return file.is_open();
+}
+
+bool LoadBlockFromJitDiskCache(u32 paddr, u32 vaddr, std::optional<u32> (*fetch_instruction)(u32 vaddr),
+  CodeHolder& code, u32& num_guest_instructions, std::vector<u32>& link_offsets, std::vector<u32>& fastmem_offsets)
+{
+    auto records = record_index.find(RecordKey(paddr, vaddr));
+    if (records == record_index.end()) {
+        return false;
+    }
+    std::vector<u32> guest_instructions;
+    for (IndexEntry const& entry : records->second | std::views::reverse) {
+        while (guest_instructions.size() < entry.num_guest_instructions) {
+            std::optional<u32> instr = fetch_instruction(vaddr + 4 * u32(guest_instructions.size()));
+            if (!instr) break;
+            guest_instructions.push_back(*instr);
+        }
+        if (guest_instructions.size() < entry.num_guest_instructions) continue;
+        if (HashInstructions(std::span{ guest_instructions }.first(entry.num_guest_instructions)) != entry.guest_hash) {
+            continue;
+        }
+        num_guest_instructions = entry.num_guest_instructions;
+        return ReadRecord(entry.record_offset, code, link_offsets, fastmem_offsets);
+    }
+    return false;
+}
+
+Status OpenJitDiskCache(std::filesystem::path const& path)
+{
+    if constexpr (!guest_gpr_base_ptr_is_pinned) {
+        return FailureStatus("The JIT disk cache requires blocks that do not embed the address of the guest state");
+    }
+    CloseJitDiskCache();
+    image_base = static_cast<u8 const*>(host_memory::module_base(reinterpret_cast<void const*>(&OpenJitDiskCache)));
+    if (!image_base) {
+        return FailureStatus("Failed to find the base address of the executable image");
+    }
+    std::optional<u64> build_tag = BuildTag();
+    if (!build_tag) {
+        return FailureStatus("Failed to find the code of the executable image");
+    }
+    FileHeader expected_header = {
+        .magic = file_magic,
+        .format_version = file_format_version,
+        .reserved = 0,
+        .build_tag = *build_tag,
+    };
+
+    std::error_code ec;
+    u64 file_size = std::filesystem::exists(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+    if (ec) {
+        return FailureStatus("Failed to query JIT disk cache file {}: {}", path.string(), ec.message());
+    }
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    FileHeader header{};
+    bool valid = file && file_size >= sizeof(header) && file.read(reinterpret_cast<char*>(&header), sizeof(header))
+              && std::memcmp(&header, &expected_header, sizeof(header)) == 0;
+
+    u64 valid_size = sizeof(header);
+    if (valid) {
+        size_t num_records = 0;
+        while (valid_size + sizeof(RecordHeader) <= file_size) {
+            RecordHeader record{};
+            file.seekg(std::streamoff(valid_size));
+            if (!file.read(reinterpret_cast<char*>(&record), sizeof(record))) break;
+            u64 record_size = sizeof(record) + record.code_size + u64(record.num_relocs) * sizeof(RelocRecord)
+                            + u64(record.num_links + record.num_fastmem_offsets) * sizeof(u32);
+            if (valid_size + record_size > file_size) break; // cut short, e.g. by a crash while writing it
+            record_index[RecordKey(record.paddr, record.vaddr)].push_back({
+              .record_offset = valid_size,
+              .guest_hash = record.guest_hash,
+              .num_guest_instructions = record.num_guest_instructions,
+            });
+            valid_size += record_size;
+            num_records++;
+        }
+        log_info("Opened JIT disk cache {} with {} blocks", path.string(), num_records);
+    } else if (file_size > 0) {
+        log_info("Discarding JIT disk cache {}, which was written by a different build", path.string());
+    }
+    if (!valid || valid_size < file_size) {
+        file.close();
+        if (!valid) {
+            file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<char const*>(&expected_header), sizeof(expected_header));
+        } else {
+            std::filesystem::resize_file(path, valid_size, ec);
+            file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        }
+    }
+    if (!file.is_open() || ec) {
+        CloseJitDiskCache();
+        return FailureStatus("Failed to open JIT disk cache file {}", path.string());
+    }
+    file.clear(); // reaching the end of the file while indexing it set eofbit
+    return OkStatus();
+}
+
+bool ReadRecord(u64 record_offset, CodeHolder& code, std::vector<u32>& link_offsets,
+  std::vector<u32>& fastmem_offsets)
+{
+    RecordHeader header{};
+    std::vector<u8> code_bytes;
+    std::vector<RelocRecord> relocs;
+    file.clear();
+    file.seekg(std::streamoff(record_offset));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    code_bytes.resize(header.code_size);
+    relocs.resize(header.num_relocs);
+    link_offsets.resize(header.num_links);
+    fastmem_offsets.resize(header.num_fastmem_offsets);
+    file.read(reinterpret_cast<char*>(code_bytes.data()), std::streamsize(code_bytes.size()));
+    file.read(reinterpret_cast<char*>(relocs.data()), std::streamsize(relocs.size() * sizeof(RelocRecord)));
+    file.read(reinterpret_cast<char*>(link_offsets.data()), std::streamsize(link_offsets.size() * sizeof(u32)));
+    file.read(reinterpret_cast<char*>(fastmem_offsets.data()), std::streamsize(fastmem_offsets.size() * sizeof(u32)));
+    if (!file) {
+        log_error("Failed to read JIT disk cache record at offset {}", record_offset);
+        file.clear();
+        return false;
+    }
+
+    Assembler a(&code);
+    if (a.embed(code_bytes.data(), code_bytes.size()) != kErrorOk) {
+        return false;
+    }
+    for (RelocRecord const& record : relocs) {
+        RelocEntry* re{};
+        if (code.newRelocEntry(&re, RelocType(record.type)) != kErrorOk) {
+            return false;
+        }
+        re->_format = std::bit_cast<OffsetFormat>(record.format);
+        re->_sourceSectionId = 0;
+        re->_targetSectionId = record.external ? Globals::kInvalidId : 0;
+        re->_sourceOffset = record.source_offset;
+        re->_payload = record.external ? reinterpret_cast<u64>(image_base + record.payload) : u64(record.payload);
+        if (record.external && re->_relocType == RelocType::kX64AddressEntry) {
+            code.addAddressToAddressTable(re->_payload);
+        }
+    }
+    return true;
+}
+
+u64 RecordKey(u32 paddr, u32 vaddr)
+{
+    return u64(paddr) << 32 | vaddr;
+}
+
+void StoreBlockToJitDiskCache(u32 paddr, u32 vaddr, std::span<u32 const> guest_instructions, CodeHolder& code,
+  std::span<u32 const> link_offsets, std::span<u32 const> fastmem_offsets)
+{
+    if (!file.is_open() || code.flatten() != kErrorOk || code.resolveUnresolvedLinks() != kErrorOk) {
+        return;
+    }
+    std::vector<RelocRecord> relocs;
+    for (RelocEntry const* re : code.relocEntries()) {
+        bool supported_type = one_of(re->relocType(), RelocType::kAbsToAbs, RelocType::kAbsToRel,
+          RelocType::kX64AddressEntry);
+        bool external = re->targetSectionId() == Globals::kInvalidId;
+        if (!supported_type || re->sourceSectionId() != 0 || !(external || re->targetSectionId() == 0)) {
+            return;
+        }
+        if (external && host_memory::module_base(reinterpret_cast<void const*>(re->payload())) != image_base) {
+            return; // e.g. into the heap or a shared library, which are not at a fixed offset from the image
+        }
+        relocs.push_back({
+          .source_offset = re->sourceOffset(),
+          .payload = external ? s64(re->payload() - reinterpret_cast<u64>(image_base)) : s64(re->payload()),
+          .format = std::bit_cast<std::array<u8, sizeof(OffsetFormat)>>(re->format()),
+          .type = u32(re->relocType()),
+          .external = external,
+        });
+    }
+    CodeBuffer const& buffer = code.textSection()->buffer();
+    RecordHeader header = {
+        .paddr = paddr,
+        .vaddr = vaddr,
+        .guest_hash = HashInstructions(guest_instructions),
+        .num_guest_instructions = u32(guest_instructions.size()),
+        .code_size = u32(buffer.size()),
+        .num_relocs = u32(relocs.size()),
+        .num_links = u32(link_offsets.size()),
+        .num_fastmem_offsets = u32(fastmem_offsets.size()),
+        .reserved = 0,
+    };
+    file.clear();
+    file.seekp(0, std::ios::end);
+    u64 record_offset = u64(file.tellp());
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(buffer.data()), std::streamsize(buffer.size()));
+    file.write(reinterpret_cast<char const*>(relocs.data()), std::streamsize(relocs.size() * sizeof(RelocRecord)));
+    file.write(reinterpret_cast<char const*>(link_offsets.data()), std::streamsize(link_offsets.size_bytes()));
+    file.write(reinterpret_cast<char const*>(fastmem_offsets.data()), std::streamsize(fastmem_offsets.size_bytes()));
+    if (!file) {
+        log_error("Failed to write to JIT disk cache; closing it");
+        CloseJitDiskCache();
+        return;
+    }
+    record_index[RecordKey(paddr, vaddr)].push_back({
+      .record_offset = record_offset,
+      .guest_hash = header.guest_hash,
+      .num_guest_instructions = header.num_guest_instructions,
+    });
+}
+
+} // namespace ee
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "asmjit/core/codeholder.h"
+#include "numtypes.hpp"
+#include "status.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace ee {
+
+// Translated blocks are kept on disk across runs in a relocatable form: the code of the block before relocation,
+// together with its relocations, where host addresses are stored relative to the executable image. Entries are keyed
+// on the physical and virtual address of the block and a hash of its guest instructions, and the whole file is
+// discarded if it was written by a different build.
+
+void CloseJitDiskCache();
+bool JitDiskCacheIsOpen();
+
+// Rebuilds the code of a block compiled in an earlier run into 'code', which must have been initialized, if the guest
+// instructions at the block still hash to the same value. fetch_instruction returns the instruction at a virtual
+// address, or nothing if it cannot be fetched. num_guest_instructions receives the number of guest instructions the
+// block was compiled from, link_offsets the offsets of the embedded block links, and fastmem_offsets those of the
+// fastmem accesses of the block, each followed by the offset of its slow path.
+bool LoadBlockFromJitDiskCache(u32 paddr, u32 vaddr, std::optional<u32> (*fetch_instruction)(u32 vaddr),
+  asmjit::CodeHolder& code, u32& num_guest_instructions, std::vector<u32>& link_offsets,
+  std::vector<u32>& fastmem_offsets);
+
+Status OpenJitDiskCache(std::filesystem::path const& path);
+
+// 'code' must have been finalized, but not yet relocated.
+void StoreBlockToJitDiskCache(u32 paddr, u32 vaddr, std::span<u32 const> guest_instructions, asmjit::CodeHolder& code,
+  std::span<u32 const> link_offsets, std::span<u32 const> fastmem_offsets);
+
+} // namespace ee
@@ -0,0 +1,663 @@
+#include "jit_ir.hpp"
+#include "mips/decoder.hpp"
+#include "mmu.hpp"
+
+#include <cassert>
+#include <format>
+#include <string_view>
+#include <utility>
+
+namespace ee {
+
+static IrInst Decode(u32 instr, u32 vaddr);
+static u64 Evaluate(IrOp op, u64 a, u64 b);
+static std::string FormatOperand(IrOperand operand);
+static std::string FormatRegisters(u64 mask);
+static u64 GuaranteedWrites(IrBlock const& block, size_t index);
+static bool IsArithmetic(IrOp op);
+static bool IsPure(IrOp op);
+static bool IsUnconditionalJump(IrInst const& inst);
+static u64 RegisterBit(u32 guest);
+
+constexpr std::array<std::string_view, 21> ir_op_names = {
+    "nop",
+    "const",
+    "move",
+    "add32",
+    "add64",
+    "sub32",
+    "sub64",
+    "and",
+    "or",
+    "xor",
+    "nor",
+    "sll32",
+    "srl32",
+    "sra32",
+    "sll64",
+    "srl64",
+    "sra64",
+    "slt",
+    "sltu",
+    "branch",
+    "guest",
+};
+
+constexpr std::array<std::string_view, 8> ir_branch_cond_names = { "always", "eq", "ne", "lez", "gtz", "ltz", "gez",
+    "cop" };
+
+IrBlock BuildIr(u32 vaddr, std::span<u32 const> instructions)
+{
+    std::vector<u32> vaddrs(instructions.size());
+    for (size_t i = 0; i < vaddrs.size(); ++i) {
+        vaddrs[i] = vaddr + 4 * u32(i);
+    }
+    return BuildIr(vaddrs, instructions);
+}
+
+IrBlock BuildIr(std::span<u32 const> vaddrs, std::span<u32 const> instructions)
+{
+    assert(!vaddrs.empty() && vaddrs.size() == instructions.size());
+    IrBlock block = { .vaddr = vaddrs.front(), .insts = {} };
+    block.insts.reserve(instructions.size());
+    std::array<s16, 32> defs;
+    defs.fill(ir_entry_value);
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        s16 index = s16(i);
+        IrInst inst = Decode(instructions[i], vaddrs[i]);
+        // Only jumps that the block follows have a delay slot that is not its last instruction; see FetchBlock
+        if (i > 0 && i + 2 < instructions.size() && IsUnconditionalJump(inst)) {
+            inst.branch_outcome = IrBranchOutcome::Followed;
+        }
+        for (u32 i = 0; i < inst.num_srcs; ++i) {
+            inst.srcs[i].def = defs[inst.srcs[i].guest];
+        }
+        for (u32 guest = 1; guest < 32; ++guest) {
+            if (inst.writes & RegisterBit(guest)) {
+                defs[guest] = index;
+            }
+        }
+        block.insts.push_back(inst);
+    }
+    return block;
+}
+
+void ComputeLiveness(IrBlock& block, u64 live_out)
+{
+    u64 live = live_out;
+    std::array<u8, 32> next_reads;
+    next_reads.fill(ir_no_next_read);
+    for (size_t i = block.insts.size(); i-- > 0;) {
+        IrInst& inst = block.insts[i];
+        if (inst.may_raise) {
+            live = ir_all_registers; // the exception handler may read any register
+        } else {
+            live = (live & ~GuaranteedWrites(block, i)) | inst.reads;
+        }
+        inst.live_in = live;
+        for (u32 guest = 1; guest < 32; ++guest) {
+            if (inst.reads & RegisterBit(guest)) {
+                next_reads[guest] = 0;
+            } else if (next_reads[guest] != ir_no_next_read) {
+                next_reads[guest]++;
+            }
+        }
+        inst.next_reads = next_reads;
+    }
+}
+
+std::optional<u64> IrBlock::ConstOperand(IrOperand operand) const
+{
+    if (operand.guest == 0) {
+        return 0;
+    }
+    if (operand.def != ir_entry_value && insts[operand.def].op == IrOp::Const) {
+        return insts[operand.def].imm;
+    }
+    return {};
+}
+
+IrInst Decode(u32 instr, u32 vaddr)
+{
+    u32 rs = instr >> 21 & 31, rt = instr >> 16 & 31, rd = instr >> 11 & 31, sa = instr >> 6 & 31;
+    u64 simm = u64(s64(s16(instr))), zimm = instr & 0xFFFF;
+    u64 lo = RegisterBit(ir_lo_index), hi = RegisterBit(ir_hi_index);
+
+    IrInst inst = { .instr = instr, .vaddr = vaddr, .op = IrOp::Guest };
+    auto guest = [&](u64 reads, u64 writes, bool may_raise) {
+        inst.reads = reads;
+        inst.writes = writes;
+        inst.may_raise = may_raise;
+        return inst;
+    };
+    auto unknown = [&] { return guest(ir_all_registers, ir_all_registers, true); };
+    auto unary = [&](IrOp op, u32 src, u32 dst, u64 imm) {
+        inst.op = dst ? op : IrOp::Nop; // writes to $zero have no effect
+        inst.dst = u8(dst);
+        inst.num_srcs = 1;
+        inst.srcs[0].guest = u8(src);
+        inst.imm = imm;
+        inst.reads = dst ? RegisterBit(src) : 0;
+        inst.writes = RegisterBit(dst);
+        return inst;
+    };
+    auto binary = [&](IrOp op, u32 src0, u32 src1, u32 dst) {
+        unary(op, src0, dst, 0);
+        inst.num_srcs = 2;
+        inst.srcs[1].guest = u8(src1);
+        inst.reads |= dst ? RegisterBit(src1) : 0;
+        return inst;
+    };
+    auto move_or = [&](IrOp op, u32 src0, u32 src1, u32 dst) {
+        if (src0 == 0 || src1 == 0) {
+            return unary(IrOp::Move, src0 | src1, dst, 0);
+        }
+        return binary(op, src0, src1, dst);
+    };
+    auto branch = [&](IrBranchCond cond, u32 src0, u32 src1, u32 link, bool likely, std::optional<u32> target) {
+        inst.op = IrOp::Branch;
+        inst.branch_cond = cond;
+        inst.branch_likely = likely;
+        inst.branch_direct = target.has_value();
+        inst.dst = u8(link);
+        switch (cond) {
+        case IrBranchCond::Always: inst.num_srcs = !target; break; // jr and jalr read the target
+        case IrBranchCond::Eq:
+        case IrBranchCond::Ne: inst.num_srcs = 2; break;
+        case IrBranchCond::Cop: inst.num_srcs = 0; break;
+        default: inst.num_srcs = 1;
+        }
+        inst.srcs[0].guest = u8(src0);
+        inst.srcs[1].guest = u8(src1);
+        inst.imm = target.value_or(0);
+        inst.reads = (inst.num_srcs > 0 ? RegisterBit(src0) : 0) | (inst.num_srcs > 1 ? RegisterBit(src1) : 0);
+        inst.writes = RegisterBit(link);
+        return inst;
+    };
+    u32 branch_target = vaddr + 4 + (u32(simm) << 2);
+
+    switch (instr >> 26) {
+    case 0x00:
+        switch (instr & 63) {
+        case 0x00: return unary(IrOp::Sll32, rt, rd, sa);
+        case 0x02: return unary(IrOp::Srl32, rt, rd, sa);
+        case 0x03: return unary(IrOp::Sra32, rt, rd, sa);
+        case 0x04:
+        case 0x06:
+        case 0x07: return guest(RegisterBit(rs) | RegisterBit(rt), RegisterBit(rd), false);
+        case 0x08: return branch(IrBranchCond::Always, rs, 0, 0, false, {});
+        case 0x09: return branch(IrBranchCond::Always, rs, 0, rd, false, {});
+        case 0x0A:
+        case 0x0B: return guest(RegisterBit(rs) | RegisterBit(rt) | RegisterBit(rd), RegisterBit(rd), false);
+        case 0x0C:
+        case 0x0D: return guest(0, 0, true);
+        case 0x0F: return guest(0, 0, false);
+        case 0x10: return guest(hi, RegisterBit(rd), false);
+        case 0x11: return guest(RegisterBit(rs), hi, false);
+        case 0x12: return guest(lo, RegisterBit(rd), false);
+        case 0x13: return guest(RegisterBit(rs), lo, false);
+        case 0x14:
+        case 0x16:
+        case 0x17: return guest(RegisterBit(rs) | RegisterBit(rt), RegisterBit(rd), false);
+        case 0x18:
+        case 0x19: return guest(RegisterBit(rs) | RegisterBit(rt), RegisterBit(rd) | lo | hi, false);
+        case 0x1A:
+        case 0x1B: return guest(RegisterBit(rs) | RegisterBit(rt), lo | hi, false);
+        case 0x20:
+        case 0x22:
+        case 0x2C:
+        case 0x2E: return guest(RegisterBit(rs) | RegisterBit(rt), RegisterBit(rd), true); // trap on overflow
+        case 0x21: return binary(IrOp::Add32, rs, rt, rd);
+        case 0x23: return binary(IrOp::Sub32, rs, rt, rd);
+        case 0x24: return binary(IrOp::And, rs, rt, rd);
+        case 0x25: return move_or(IrOp::Or, rs, rt, rd);
+        case 0x26: return binary(IrOp::Xor, rs, rt, rd);
+        case 0x27: return binary(IrOp::Nor, rs, rt, rd);
+        case 0x28: return guest(0, RegisterBit(rd), false);
+        case 0x29: return guest(RegisterBit(rs), 0, false);
+        case 0x2A: return binary(IrOp::SetLess, rs, rt, rd);
+        case 0x2B: return binary(IrOp::SetLessUnsigned, rs, rt, rd);
+        case 0x2D: return move_or(IrOp::Add64, rs, rt, rd);
+        case 0x2F: return binary(IrOp::Sub64, rs, rt, rd);
+        case 0x30:
+        case 0x31:
+        case 0x32:
+        case 0x33:
+        case 0x34:
+        case 0x36: return guest(RegisterBit(rs) | RegisterBit(rt), 0, true);
+        case 0x38: return unary(IrOp::Sll64, rt, rd, sa);
+        case 0x3A: return unary(IrOp::Srl64, rt, rd, sa);
+        case 0x3B: return unary(IrOp::Sra64, rt, rd, sa);
+        case 0x3C: return unary(IrOp::Sll64, rt, rd, sa + 32);
+        case 0x3E: return unary(IrOp::Srl64, rt, rd, sa + 32);
+        case 0x3F: return unary(IrOp::Sra64, rt, rd, sa + 32);
+        default: return unknown();
+        }
+    case 0x01:
+        switch (rt) {
+        case 0x00:
+        case 0x02:
+        case 0x10:
+        case 0x12: return branch(IrBranchCond::Ltz, rs, 0, rt & 0x10 ? 31 : 0, rt & 2, branch_target);
+        case 0x01:
+        case 0x03:
+        case 0x11:
+        case 0x13: return branch(IrBranchCond::Gez, rs, 0, rt & 0x10 ? 31 : 0, rt & 2, branch_target);
+        case 0x08:
+        case 0x09:
+        case 0x0A:
+        case 0x0B:
+        case 0x0C:
+        case 0x0E: return guest(RegisterBit(rs), 0, true);
+        case 0x18:
+        case 0x19: return guest(RegisterBit(rs), 0, false);
+        default: return unknown();
+        }
+    case 0x02:
+    case 0x03: {
+        u32 target = ((vaddr + 4) & 0xF000'0000) | (instr & 0x3FF'FFFF) << 2;
+        return branch(IrBranchCond::Always, 0, 0, instr >> 26 == 0x03 ? 31 : 0, false, target);
+    }
+    case 0x04:
+    case 0x14: return branch(IrBranchCond::Eq, rs, rt, 0, instr >> 26 == 0x14, branch_target);
+    case 0x05:
+    case 0x15: return branch(IrBranchCond::Ne, rs, rt, 0, instr >> 26 == 0x15, branch_target);
+    case 0x06:
+    case 0x16: return branch(IrBranchCond::Lez, rs, 0, 0, instr >> 26 == 0x16, branch_target);
+    case 0x07:
+    case 0x17: return branch(IrBranchCond::Gtz, rs, 0, 0, instr >> 26 == 0x17, branch_target);
+    case 0x08:
+    case 0x18: return guest(RegisterBit(rs), RegisterBit(rt), true);
+    case 0x09: return unary(IrOp::Add32, rs, rt, simm);
+    case 0x0A: return unary(IrOp::SetLess, rs, rt, simm);
+    case 0x0B: return unary(IrOp::SetLessUnsigned, rs, rt, simm);
+    case 0x0C: return unary(IrOp::And, rs, rt, zimm);
+    case 0x0D: return unary(IrOp::Or, rs, rt, zimm);
+    case 0x0E: return unary(IrOp::Xor, rs, rt, zimm);
+    case 0x0F:
+        unary(IrOp::Const, 0, rt, simm << 16);
+        inst.num_srcs = 0;
+        inst.reads = 0;
+        return inst;
+    case 0x10:
+    case 0x11:
+    case 0x12: {
+        bool cop2 = instr >> 26 == 0x12;
+        switch (rs) {
+        case 0x00:
+        case 0x02: return guest(0, RegisterBit(rt), true); // mfc0, mfc1, cfc1, cfc2
+        case 0x01: return cop2 ? guest(0, RegisterBit(rt), true) : unknown(); // qmfc2
+        case 0x04:
+        case 0x06: return guest(RegisterBit(rt), 0, true); // mtc0, mtc1, ctc1, ctc2
+        case 0x05: return cop2 ? guest(RegisterBit(rt), 0, true) : unknown(); // qmtc2
+        case 0x08: return branch(IrBranchCond::Cop, 0, 0, 0, rt & 2, branch_target);
+        default: return guest(0, 0, true);
+        }
+    }
+    case 0x19: return unary(IrOp::Add64, rs, rt, simm);
+    case 0x1A:
+    case 0x1B: return guest(RegisterBit(rs) | RegisterBit(rt), RegisterBit(rt), true);
+    case 0x1C: return guest(RegisterBit(rs) | RegisterBit(rt) | lo | hi, RegisterBit(rd) | lo | hi, true);
+    case 0x1E: return guest(RegisterBit(rs), RegisterBit(rt), true);
+    case 0x1F: return guest(RegisterBit(rs) | RegisterBit(rt), 0, true);
+    case 0x20:
+    case 0x21:
+    case 0x23:
+    case 0x24:
+    case 0x25:
+    case 0x27:
+    case 0x37: return guest(RegisterBit(rs), RegisterBit(rt), true);
+    case 0x22:
+    case 0x26: return guest(RegisterBit(rs) | RegisterBit(rt), RegisterBit(rt), true);
+    case 0x28:
+    case 0x29:
+    case 0x2A:
+    case 0x2B:
+    case 0x2C:
+    case 0x2D:
+    case 0x2E:
+    case 0x3F: return guest(RegisterBit(rs) | RegisterBit(rt), 0, true);
+    case 0x2F:
+    case 0x31:
+    case 0x36:
+    case 0x39:
+    case 0x3E: return guest(RegisterBit(rs), 0, true);
+    case 0x33: return guest(RegisterBit(rs), 0, false);
+    default: return unknown();
+    }
+}
+
+std::string DumpIr(IrBlock const& block)
+{
+    std::string out = std::format("IR of the block at {:08X}\n", block.vaddr);
+    for (size_t i = 0; i < block.insts.size(); ++i) {
+        IrInst const& inst = block.insts[i];
+        out += std::format("{:3} {:08X}  {:08X}  ", i, inst.vaddr, inst.instr);
+        switch (inst.op) {
+        case IrOp::Nop: out += "nop"; break;
+        case IrOp::Const: out += std::format("{} = {:#x}", mips::gpr_index_to_name(inst.dst), inst.imm); break;
+        case IrOp::Branch:
+            out += std::format("branch {}", ir_branch_cond_names[std::to_underlying(inst.branch_cond)]);
+            for (u32 src = 0; src < inst.num_srcs; ++src) {
+                out += std::format("{}{}", src ? ", " : " ", FormatOperand(inst.srcs[src]));
+            }
+            if (inst.branch_direct) out += std::format(" -> {:08X}", inst.imm);
+            if (inst.dst) out += std::format(", link {}", mips::gpr_index_to_name(inst.dst));
+            if (inst.branch_likely) out += ", likely";
+            if (inst.branch_outcome == IrBranchOutcome::Taken) out += " (taken)";
+            if (inst.branch_outcome == IrBranchOutcome::NotTaken) out += " (not taken)";
+            if (inst.branch_outcome == IrBranchOutcome::Followed) out += " (followed)";
+            break;
+        case IrOp::Guest:
+            out += std::format("guest; reads {}; writes {}", FormatRegisters(inst.reads), FormatRegisters(inst.writes));
+            if (inst.may_raise) out += "; may raise";
+            break;
+        default:
+            out += std::format("{} = {} {}",
+              mips::gpr_index_to_name(inst.dst),
+              ir_op_names[std::to_underlying(inst.op)],
+              FormatOperand(inst.srcs[0]));
+            if (inst.num_srcs > 1) out += std::format(", {}", FormatOperand(inst.srcs[1]));
+            else if (inst.op != IrOp::Move) out += std::format(", {:#x}", inst.imm);
+        }
+        out += std::format("  ; live {}\n", FormatRegisters(inst.live_in));
+    }
+    return out;
+}
+
+// Liveness runs backwards from the end of the block, where every guest register is live, as the successor is unknown.
+// The same holds after the first instruction: a block entered in the delay slot of a branch exits there (see
+// UpdateBranchState).
+void EliminateDeadCode(IrBlock& block)
+{
+    u64 live = ir_all_registers;
+    for (size_t i = block.insts.size(); i-- > 0;) {
+        IrInst& inst = block.insts[i];
+        if (i == 0) {
+            live = ir_all_registers;
+        }
+        if (IsPure(inst.op) && !(live & RegisterBit(inst.dst))) {
+            inst = { .instr = inst.instr, .vaddr = inst.vaddr, .op = IrOp::Nop };
+            continue;
+        }
+        if (inst.may_raise) {
+            live = ir_all_registers; // the exception handler may read any register
+            continue;
+        }
+        live = (live & ~GuaranteedWrites(block, i)) | inst.reads;
+    }
+}
+
+void EliminateRedundantGprWrites(IrBlock& block)
+{
+    std::array<s16, 32> defs;
+    defs.fill(ir_entry_value);
+    std::vector<s16> replaced_by(block.insts.size(), ir_entry_value); // for removed instructions, the def they repeat
+    for (size_t i = 0; i < block.insts.size(); ++i) {
+        IrInst& inst = block.insts[i];
+        for (IrOperand& src : std::span(inst.srcs.data(), inst.num_srcs)) {
+            if (src.def != ir_entry_value && block.insts[src.def].op == IrOp::Nop) {
+                src.def = replaced_by[src.def];
+            }
+        }
+        bool redundant = [&] {
+            if (!IsPure(inst.op)) return false;
+            IrOperand current = { .guest = inst.dst, .def = defs[inst.dst] };
+            if (inst.op == IrOp::Const) return block.ConstOperand(current) == inst.imm;
+            if (inst.num_srcs != 1 || inst.srcs[0].guest != inst.dst) return false;
+            switch (inst.op) {
+            case IrOp::Move: return true;
+            case IrOp::Add64:
+            case IrOp::Or:
+            case IrOp::Xor:
+            case IrOp::Sll64:
+            case IrOp::Srl64:
+            case IrOp::Sra64: return inst.imm == 0;
+            default: return false;
+            }
+        }();
+        if (redundant) {
+            replaced_by[i] = defs[inst.dst];
+            inst = { .instr = inst.instr, .vaddr = inst.vaddr, .op = IrOp::Nop };
+            continue;
+        }
+        for (u32 guest = 1; guest < 32; ++guest) {
+            if (inst.writes & RegisterBit(guest)) {
+                defs[guest] = s16(i);
+            }
+        }
+    }
+}
+
+u64 Evaluate(IrOp op, u64 a, u64 b)
+{
+    switch (op) {
+    case IrOp::Move: return a;
+    case IrOp::Add32: return u64(s64(s32(u32(a) + u32(b))));
+    case IrOp::Add64: return a + b;
+    case IrOp::Sub32: return u64(s64(s32(u32(a) - u32(b))));
+    case IrOp::Sub64: return a - b;
+    case IrOp::And: return a & b;
+    case IrOp::Or: return a | b;
+    case IrOp::Xor: return a ^ b;
+    case IrOp::Nor: return ~(a | b);
+    case IrOp::Sll32: return u64(s64(s32(u32(a) << b)));
+    case IrOp::Srl32: return u64(s64(s32(u32(a) >> b)));
+    case IrOp::Sra32: return u64(s64(s32(a) >> b));
+    case IrOp::Sll64: return a << b;
+    case IrOp::Srl64: return a >> b;
+    case IrOp::Sra64: return u64(s64(a) >> b);
+    case IrOp::SetLess: return s64(a) < s64(b);
+    case IrOp::SetLessUnsigned: return a < b;
+    default: std::unreachable();
+    }
+}
+
+void FoldConstants(IrBlock& block)
+{
+    for (IrInst& inst : block.insts) {
+        if (!IsArithmetic(inst.op)) continue;
+        std::optional<u64> a = block.ConstOperand(inst.srcs[0]);
+        std::optional<u64> b = inst.num_srcs > 1 ? block.ConstOperand(inst.srcs[1]) : inst.imm;
+        if (a && b) {
+            inst.imm = Evaluate(inst.op, *a, *b);
+            inst.op = IrOp::Const;
+            inst.num_srcs = 0;
+            inst.reads = 0;
+        }
+    }
+}
+
+std::string FormatOperand(IrOperand operand)
+{
+    if (operand.def == ir_entry_value) {
+        return std::format("{}@in", mips::gpr_index_to_name(operand.guest));
+    }
+    return std::format("{}@{}", mips::gpr_index_to_name(operand.guest), operand.def);
+}
+
+std::string FormatRegisters(u64 mask)
+{
+    if (mask == ir_all_registers) {
+        return "all";
+    }
+    std::string out;
+    for (u32 guest = 1; guest <= ir_hi_index; ++guest) {
+        if (mask & RegisterBit(guest)) {
+            if (!out.empty()) out += ',';
+            out += guest == ir_lo_index ? "lo" : guest == ir_hi_index ? "hi" : mips::gpr_index_to_name(guest);
+        }
+    }
+    return out.empty() ? "none" : out;
+}
+
+// The guest registers that an instruction writes whenever it completes; other writes depend on run-time state
+u64 GuaranteedWrites(IrBlock const& block, size_t index)
+{
+    IrInst const& inst = block.insts[index];
+    if (index > 0) {
+        IrInst const& prev = block.insts[index - 1];
+        if (prev.op == IrOp::Branch && prev.branch_likely && prev.branch_outcome != IrBranchOutcome::Taken) {
+            return 0; // the delay slot of a likely branch is skipped if the branch is not taken
+        }
+    }
+    if (IsPure(inst.op) || inst.op == IrOp::Branch) {
+        return RegisterBit(inst.dst);
+    }
+    return 0;
+}
+
+bool IsArithmetic(IrOp op)
+{
+    return op >= IrOp::Move && op <= IrOp::SetLessUnsigned;
+}
+
+bool IsBranchInstruction(u32 instr)
+{
+    return Decode(instr, 0).op == IrOp::Branch;
+}
+
+bool IsIdleLoop(IrBlock const& block)
+{
+    constexpr size_t max_idle_loop_instructions = 16;
+    size_t size = block.insts.size();
+    if (size < 2 || size > max_idle_loop_instructions) {
+        return false;
+    }
+    IrInst const& branch = block.insts[size - 2];
+    if (branch.op != IrOp::Branch || !branch.branch_direct || u32(branch.imm) != block.vaddr || branch.dst != 0
+        || branch.branch_outcome == IrBranchOutcome::NotTaken || branch.branch_cond == IrBranchCond::Cop) {
+        return false;
+    }
+    u64 all_writes = 0;
+    for (IrInst const& inst : block.insts) {
+        all_writes |= inst.writes;
+    }
+    // Every iteration must start from the same registers: none may be read before the iteration writes it
+    u64 written = 0;
+    for (size_t i = 0; i < size; ++i) {
+        IrInst const& inst = block.insts[i];
+        if (inst.reads & all_writes & ~written) {
+            return false;
+        }
+        written |= inst.writes;
+        if (i == size - 2 || inst.op == IrOp::Nop || IsPure(inst.op)) {
+            continue;
+        }
+        switch (inst.instr >> 26) {
+        case 0x1E: // lq
+        case 0x20: // lb
+        case 0x21: // lh
+        case 0x23: // lw
+        case 0x24: // lbu
+        case 0x25: // lhu
+        case 0x27: // lwu
+        case 0x37: { // ld
+            // Only RDRAM and the BIOS, at an address known at compile time that the TLB cannot remap, are polled without
+            // side effects; IO registers may change as they are read (e.g. the timers, which count without a scheduler
+            // event for every change)
+            IrOperand base = { .guest = u8(inst.instr >> 21 & 31), .def = ir_entry_value };
+            for (size_t j = i; j-- > 0;) {
+                if (block.insts[j].writes & RegisterBit(base.guest)) {
+                    base.def = s16(j);
+                    break;
+                }
+            }
+            std::optional<u64> base_value = block.ConstOperand(base);
+            if (!base_value) {
+                return false;
+            }
+            u32 vaddr = u32(*base_value) + u32(s32(s16(inst.instr)));
+            if (vaddr - 0x8000'0000 >= 0x4000'0000 || !get_physical_mapping(vaddr & 0x1FFF'FFFF).host) {
+                return false; // not in kseg0/kseg1, or not RDRAM or the BIOS
+            }
+            break;
+        }
+        default: return false; // stores, reads of COP0 Count, and anything else that is not a plain load
+        }
+    }
+    return true;
+}
+
+// Without side effects, and with dst as the only register written
+bool IsPure(IrOp op)
+{
+    return op == IrOp::Const || IsArithmetic(op);
+}
+
+// A direct jump, or a branch always taken, without a link, and not likely
+bool IsUnconditionalJump(IrInst const& inst)
+{
+    if (inst.op != IrOp::Branch || !inst.branch_direct || inst.dst || inst.branch_likely) {
+        return false;
+    }
+    switch (inst.branch_cond) {
+    case IrBranchCond::Always: return true;
+    case IrBranchCond::Eq: return inst.srcs[0].guest == inst.srcs[1].guest; // b, as beq $zero, $zero
+    case IrBranchCond::Lez:
+    case IrBranchCond::Gez: return inst.srcs[0].guest == 0;
+    default: return false;
+    }
+}
+
+u64 RegisterBit(u32 guest)
+{
+    return guest ? u64(1) << guest : 0;
+}
+
+// A branch at the start of a block is left alone, as it may be in the delay slot of a branch that ended the previous
+// block; so is a branch whose delay slot is in the next block.
+void ResolveBranches(IrBlock& block)
+{
+    for (size_t i = 1; i + 1 < block.insts.size(); ++i) {
+        IrInst& inst = block.insts[i];
+        if (inst.op != IrOp::Branch || !inst.branch_direct) continue;
+        if (inst.branch_outcome == IrBranchOutcome::Followed) continue;
+        std::optional<u64> a = block.ConstOperand(inst.srcs[0]), b = block.ConstOperand(inst.srcs[1]);
+        bool same_operands = inst.srcs[0].guest == inst.srcs[1].guest;
+        std::optional<bool> taken = [&]() -> std::optional<bool> {
+            switch (inst.branch_cond) {
+            case IrBranchCond::Always: return true;
+            case IrBranchCond::Eq: return same_operands ? true : a && b ? std::optional(*a == *b) : std::nullopt;
+            case IrBranchCond::Ne: return same_operands ? false : a && b ? std::optional(*a != *b) : std::nullopt;
+            case IrBranchCond::Lez: return a ? std::optional(s64(*a) <= 0) : std::nullopt;
+            case IrBranchCond::Gtz: return a ? std::optional(s64(*a) > 0) : std::nullopt;
+            case IrBranchCond::Ltz: return a ? std::optional(s64(*a) < 0) : std::nullopt;
+            case IrBranchCond::Gez: return a ? std::optional(s64(*a) >= 0) : std::nullopt;
+            default: return std::nullopt;
+            }
+        }();
+        if (!taken) continue;
+        inst.branch_outcome = *taken ? IrBranchOutcome::Taken : IrBranchOutcome::NotTaken;
+        if (!*taken && inst.branch_likely) {
+            IrInst& delay_slot = block.insts[i + 1];
+            delay_slot = { .instr = delay_slot.instr, .vaddr = delay_slot.vaddr, .op = IrOp::Nop }; // nullified
+        }
+    }
+}
+
+void RunIrPasses(IrBlock& block)
+{
+    FoldConstants(block);
+    ResolveBranches(block);
+    EliminateRedundantGprWrites(block);
+    EliminateDeadCode(block);
+}
+
+IrInst const* IrBlock::StaticBranch() const
+{
+    for (IrInst const& inst : insts) {
+        if (inst.op == IrOp::Branch && inst.branch_outcome != IrBranchOutcome::Followed) {
+            return inst.branch_outcome == IrBranchOutcome::Dynamic ? nullptr : &inst;
+        }
+    }
+    return nullptr;
+}
+
+std::optional<u32> UnconditionalJumpTarget(u32 instr, u32 vaddr)
+{
+    IrInst inst = Decode(instr, vaddr);
+    return IsUnconditionalJump(inst) ? std::optional(u32(inst.imm)) : std::nullopt;
+}
+
+} // namespace ee
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "numtypes.hpp"
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// The IR of the EE JIT: a block of guest instructions, decoded ahead of emission, so that passes over the whole block
+// can run before any code is emitted. There is one IR instruction per guest instruction. Those that the passes
+// understand are described by their semantics; any other is opaque, and only known by the guest registers it may read
+// and write. The IR is in SSA form in that every operand names the instruction that defines its value, rather than the
+// guest register it is read from. Emission still goes through the emitters of the guest instructions, except for
+// instructions that the passes have reduced to a constant, a move, or nothing.
+namespace ee {
+
+enum class IrOp : u8 {
+    Nop, // eliminated; emits nothing
+    Const, // dst = imm
+    Move, // dst = src
+    Add32, // results of 32-bit operations are sign-extended to 64 bits
+    Add64,
+    Sub32,
+    Sub64,
+    And,
+    Or,
+    Xor,
+    Nor,
+    Sll32,
+    Srl32,
+    Sra32,
+    Sll64,
+    Srl64,
+    Sra64,
+    SetLess,
+    SetLessUnsigned,
+    Branch, // a branch or jump; dst is the link register, if any, and imm the target, if direct
+    Guest, // opaque
+};
+
+enum class IrBranchCond : u8 {
+    Always,
+    Eq,
+    Ne,
+    Lez,
+    Gtz,
+    Ltz,
+    Gez,
+    Cop, // on a coprocessor condition
+};
+
+enum class IrBranchOutcome : u8 {
+    Dynamic,
+    Taken,
+    NotTaken,
+    Followed, // an unconditional jump, which the block goes on at the target of, after the delay slot
+};
+
+// The index of the instruction that defines a value, or ir_entry_value for the value a guest register has on entry
+inline constexpr s16 ir_entry_value = -1;
+
+inline constexpr u32 ir_lo_index = 32; // bits of IrInst::reads and IrInst::writes beyond the GPRs
+inline constexpr u32 ir_hi_index = 33;
+inline constexpr u64 ir_all_registers = (u64(1) << (ir_hi_index + 1)) - 2; // not $zero
+
+inline constexpr u8 ir_no_next_read = 0xFF; // in IrInst::next_reads
+
+struct IrOperand {
+    u8 guest;
+    s16 def;
+};
+
+struct IrInst {
+    u32 instr{}; // the guest instruction
+    u32 vaddr{}; // its address; a block that follows jumps is not contiguous
+    IrOp op{};
+    u8 dst{}; // guest register written, for all but Branch and Guest, if not $zero
+    u8 num_srcs{}; // register operands; binary operations with a single one take imm as the second
+    bool may_raise{}; // may raise an exception, which every guest register is live at
+    IrBranchCond branch_cond{};
+    IrBranchOutcome branch_outcome{};
+    bool branch_likely{}; // the delay slot is only executed if the branch is taken
+    bool branch_direct{}; // imm is the target
+    std::array<IrOperand, 2> srcs{};
+    u64 imm{};
+    u64 reads{}; // guest registers that may be read and written; one bit per GPR, then LO and HI
+    u64 writes{};
+    u64 live_in{}; // guest registers whose value may be read by this instruction or after it; set by ComputeLiveness
+    std::array<u8, 32> next_reads{}; // per GPR, how many instructions ahead it is next read, if within the block
+};
+
+struct IrBlock {
+    u32 vaddr;
+    std::vector<IrInst> insts;
+
+    // The value of an operand, if it is known at compile time
+    std::optional<u64> ConstOperand(IrOperand operand) const;
+    // The branch that ends the block, if it is resolved at compile time, with its delay slot within the block
+    IrInst const* StaticBranch() const;
+};
+
+IrBlock BuildIr(u32 vaddr, std::span<u32 const> instructions);
+// Of instructions at the given addresses, which only leave the sequential order after the delay slot of a jump
+IrBlock BuildIr(std::span<u32 const> vaddrs, std::span<u32 const> instructions);
+// Sets live_in and next_reads of every instruction, given the guest registers that may be read after the block
+void ComputeLiveness(IrBlock& block, u64 live_out);
+std::string DumpIr(IrBlock const& block);
+// Removes instructions whose result is overwritten before it is read
+void EliminateDeadCode(IrBlock& block);
+// Removes writes of the value that the guest register already holds
+void EliminateRedundantGprWrites(IrBlock& block);
+// Replaces instructions whose operands are all known by the constant they produce
+void FoldConstants(IrBlock& block);
+// Branches with a delay slot
+bool IsBranchInstruction(u32 instr);
+// A short loop that branches back to its start and polls memory without side effects, so that once it branches back,
+// it keeps doing so until something outside the EE changes the memory it reads
+bool IsIdleLoop(IrBlock const& block);
+// Decides the outcome of branches whose operands are known. The delay slot of a likely branch never taken becomes a
+// Nop.
+void ResolveBranches(IrBlock& block);
+void RunIrPasses(IrBlock& block);
+// The target of a direct jump, or a branch always taken, that neither links nor is likely; the block can go on there
+std::optional<u32> UnconditionalJumpTarget(u32 instr, u32 vaddr);
+
+} // namespace ee
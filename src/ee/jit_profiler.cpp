@@ -0,0 +1,177 @@
+#include "jit_profiler.hpp"
+#include "jit.hpp"
+#include "log.hpp"
+#include "platform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <fstream>
+#include <unordered_map>
+
+#if PLATFORM_X64
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+using namespace asmjit;
+using namespace asmjit::x86;
+
+namespace ee {
+
+static bool IsHotter(BlockProfile const& lhs, BlockProfile const& rhs);
+static u64 ReadHostTicks();
+
+static std::unordered_map<u64, BlockProfile> profiles; // (paddr, vaddr) => profile; compiled code points into it
+static BlockProfile unattributed; // charged for time spent outside of blocks
+static BlockProfile* current_profile = &unattributed; // of the block entered last
+static u64 last_block_entry_ticks;
+static u64 calibration_ticks;
+static std::chrono::steady_clock::time_point calibration_time;
+static bool enabled;
+static bool measuring_host_time;
+
+bool BlockProfilingEnabled()
+{
+    return enabled;
+}
+
+void CloseBlockProfilingInterval()
+{
+    if (enabled && measuring_host_time) {
+        u64 ticks = ReadHostTicks();
+        current_profile->host_ticks += ticks - last_block_entry_ticks;
+        current_profile = &unattributed;
+        last_block_entry_ticks = ticks;
+    }
+}
+
+void DisableBlockProfiling()
+{
+    if (enabled) {
+        CloseBlockProfilingInterval();
+        enabled = measuring_host_time = false;
+        InvalidateAll();
+    }
+}
+
+Status DumpBlockProfiles(std::filesystem::path const& path, size_t top_n)
+{
+    std::ofstream file(path);
+    if (!file) {
+        return FailureStatus("Failed to open {} for writing the EE JIT block profile", path.string());
+    }
+    std::vector<BlockProfile> blocks = GetBlockProfiles();
+    u64 total_executions{}, total_cycles{}, total_host_ticks{};
+    for (BlockProfile const& block : blocks) {
+        total_executions += block.executions;
+        total_cycles += block.executions * block.cycles;
+        total_host_ticks += block.host_ticks;
+    }
+    auto percent = [](u64 part, u64 total) { return total ? 100.0 * double(part) / double(total) : 0.0; };
+
+    file << std::format("# EE JIT block profile: {} blocks, {} executions, {} guest cycles", blocks.size(),
+      total_executions, total_cycles);
+    if (measuring_host_time || total_host_ticks) {
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - calibration_time);
+        double ticks_per_us = elapsed.count() > 0 ? double(ReadHostTicks() - calibration_ticks) / elapsed.count() : 0;
+        file << std::format(", {} host ticks ({:.0f} per microsecond)", total_host_ticks, ticks_per_us);
+    }
+    file << std::format("\n# {:>4}  {:<21}  {:<10}  {:>12}  {:>6}  {:>14}  {:>6}  {:>14}  {:>6}\n", "rank",
+      "guest pc range", "paddr", "executions", "cycles", "guest cycles", "%", "host ticks", "%");
+    for (size_t i = 0; i < std::min(top_n, blocks.size()); ++i) {
+        BlockProfile const& block = blocks[i];
+        u64 cycles = block.executions * block.cycles;
+        file << std::format("{:>6}  {:08X}-{:08X}  {:08X}    {:>12}  {:>6}  {:>14}  {:>6.2f}  {:>14}  {:>6.2f}\n", i + 1,
+          block.vaddr, block.vaddr + 4 * block.num_instructions, block.paddr, block.executions, block.cycles, cycles,
+          percent(cycles, total_cycles), block.host_ticks, percent(block.host_ticks, total_host_ticks));
+    }
+    if (!file) {
+        return FailureStatus("Failed to write the EE JIT block profile to {}", path.string());
+    }
+    log_info("Wrote the {} hottest of {} EE JIT blocks to {}", std::min(top_n, blocks.size()), blocks.size(),
+      path.string());
+    return OkStatus();
+}
+
+// Clobbers rax, rcx and rdx, which hold nothing at block entry.
+BlockProfile* EmitBlockProfilingProlog(u32 paddr, u32 vaddr)
+{
+    BlockProfile& profile = profiles[u64(paddr) << 32 | vaddr];
+    profile.vaddr = vaddr;
+    profile.paddr = paddr;
+    if constexpr (platform.a64) {}
+    if constexpr (platform.x64) {
+        c.mov(rcx, &profile);
+        c.inc(qword_ptr(rcx, offsetof(BlockProfile, executions)));
+        if (measuring_host_time) {
+            c.rdtsc(edx, eax);
+            c.shl(rdx, 32);
+            c.or_(rax, rdx);
+            c.mov(rdx, rax);
+            c.sub(rax, JitPtr(last_block_entry_ticks));
+            c.mov(JitPtr(last_block_entry_ticks), rdx);
+            c.mov(rdx, JitPtr(current_profile));
+            c.add(qword_ptr(rdx, offsetof(BlockProfile, host_ticks)), rax);
+            c.mov(JitPtr(current_profile), rcx);
+        }
+    }
+    return &profile;
+}
+
+void EnableBlockProfiling(bool measure_host_time)
+{
+    enabled = true;
+    measuring_host_time = platform.x64 && measure_host_time;
+    current_profile = &unattributed;
+    last_block_entry_ticks = calibration_ticks = ReadHostTicks();
+    calibration_time = std::chrono::steady_clock::now();
+    InvalidateAll();
+}
+
+std::vector<BlockProfile> GetBlockProfiles()
+{
+    std::vector<BlockProfile> blocks;
+    blocks.reserve(profiles.size());
+    for (auto const& [key, profile] : profiles) {
+        if (profile.executions > 0) {
+            blocks.push_back(profile);
+        }
+    }
+    std::ranges::sort(blocks, IsHotter);
+    return blocks;
+}
+
+bool IsHotter(BlockProfile const& lhs, BlockProfile const& rhs)
+{
+    if (lhs.host_ticks != rhs.host_ticks) {
+        return lhs.host_ticks > rhs.host_ticks;
+    }
+    return lhs.executions * lhs.cycles > rhs.executions * rhs.cycles;
+}
+
+u64 ReadHostTicks()
+{
+#if PLATFORM_X64
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Profiles are only zeroed, never erased, since compiled blocks may still point to them.
+void ResetBlockProfiles()
+{
+    for (auto& [key, profile] : profiles) {
+        profile.executions = profile.host_ticks = 0;
+    }
+    unattributed = {};
+    calibration_ticks = ReadHostTicks();
+    calibration_time = std::chrono::steady_clock::now();
+}
+
+} // namespace ee
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "numtypes.hpp"
+#include "status.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+namespace ee {
+
+// While profiling is enabled, every block counts its executions in its prolog. Optionally, the prolog also reads the
+// host time stamp counter, and charges the time since the previous block was entered to that block; time spent
+// outside of blocks, e.g. compiling, is charged to no block. Blocks are profiled per physical and virtual address, so
+// that the counts of a block survive it being invalidated and recompiled.
+
+struct BlockProfile {
+    u32 vaddr;
+    u32 paddr;
+    u32 num_instructions;
+    u32 cycles; // block_cycles; guest cycles charged per execution
+    u64 executions;
+    u64 host_ticks;
+};
+
+bool BlockProfilingEnabled();
+// Charges the time since the last block was entered to that block, and anything up to the next block entry to none.
+void CloseBlockProfilingInterval();
+void DisableBlockProfiling();
+// Writes the top_n blocks by host time (or by guest cycles if host time is not measured) to a text file.
+Status DumpBlockProfiles(std::filesystem::path const& path, size_t top_n);
+// Emits the profiling prolog of the block being compiled, and returns the profile it updates.
+BlockProfile* EmitBlockProfilingProlog(u32 paddr, u32 vaddr);
+// Changing whether profiling is enabled invalidates all blocks, so that they get recompiled with or without the prolog.
+void EnableBlockProfiling(bool measure_host_time);
+// Returns all profiled blocks, sorted in the order used by DumpBlockProfiles.
+std::vector<BlockProfile> GetBlockProfiles();
+void ResetBlockProfiles();
+
+} // namespace ee
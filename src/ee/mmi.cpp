@@ -5,14 +5,17 @@
 #include "asmjit/x86.h"
 #include "jit.hpp"
 #include "jit_common.hpp"
+#include "log.hpp"
 #include "platform.hpp"
 #include <algorithm>
+#include <array>
 #include <bit>
 #include <cstring>
 
 #include <immintrin.h>
 #include <limits>
 #include <tuple>
+#include <utility>
 
 // reference: https://wiki.qemu.org/File:C790.pdf
 // optimizations: https://godbolt.org/z/KEz81v9zz
@@ -21,6 +24,11 @@ using namespace asmjit::x86;
 
 namespace ee {
 
+static constexpr std::array mmi_tier_names = { "avx", "avx2", "avx512" };
+
+static MmiTier host_mmi_tier = MmiTier::Avx; // set by InitMmi
+static std::optional<MmiTier> forced_mmi_tier;
+
 static std::tuple<Xmm, Xmm, Xmm> get_vpr_rd_rs_rt(u32 rd, u32 rs, u32 rt)
 {
     return { reg_alloc.GetDirtyVpr(rd), reg_alloc.GetVpr(rs), reg_alloc.GetVpr(rt) };
@@ -28,14 +36,12 @@ static std::tuple<Xmm, Xmm, Xmm> get_vpr_rd_rs_rt(u32 rd, u32 rs, u32 rt)
 
 static asmjit::x86::Xmm get_vpr(u32 index)
 {
-    (void)index;
-    return xmm0;
+    return reg_alloc.GetVpr(index);
 }
 
 static asmjit::x86::Xmm get_dirty_vpr(u32 index)
 {
-    (void)index;
-    return xmm0;
+    return reg_alloc.GetDirtyVpr(index);
 }
 
 static asmjit::x86::Gpq get_gpr(u32 index)
@@ -46,33 +52,162 @@ static asmjit::x86::Gpq get_gpr(u32 index)
 
 static asmjit::x86::Gpq get_dirty_gpr(u32 index)
 {
-    (void)index;
+    reg_alloc.ClearConst(index);
     return rax;
 }
 
 static Xmm get_lo()
 {
-    return xmm0;
+    return reg_alloc.GetLo();
 }
 
 static Xmm get_hi()
 {
-    return xmm0;
+    return reg_alloc.GetHi();
 }
 
 static Xmm get_dirty_lo()
 {
-    return xmm0;
+    return reg_alloc.GetDirtyLo();
 }
 
 static Xmm get_dirty_hi()
 {
-    return xmm0;
+    return reg_alloc.GetDirtyHi();
+}
+
+// hi:lo, the 64-bit accumulators of word multiply-adds, gathered as such into the even words of dst and the odd ones
+// above them
+static void emit_combine_lo_hi(Xmm dst, Xmm lo, Xmm hi)
+{
+    c.vpslldq(dst, hi, 4);
+    if (GetMmiTier() >= MmiTier::Avx2) {
+        c.vpblendd(dst, dst, lo, 5);
+    } else {
+        c.vpblendw(dst, dst, lo, 0x33);
+    }
+}
+
+// Sign-extends words 0 and 2 of src to the two doublewords of dst, 64 bits each. xmm0 is used as a temporary.
+static void emit_sign_extend_even_words(Xmm dst, Xmm src)
+{
+    if (GetMmiTier() >= MmiTier::Avx512) {
+        c.vpsllq(dst, src, 32);
+        c.vpsraq(dst, dst, 32);
+    } else {
+        c.vpshufd(xmm0, src, 2 << 2);
+        c.vpmovsxdq(dst, xmm0);
+    }
+}
+
+// LO and HI of word multiplies: the even and the odd words of src, the products, sign-extended
+static void emit_split_lo_hi(Xmm src, Xmm lo, Xmm hi)
+{
+    emit_sign_extend_even_words(lo, src);
+    if (GetMmiTier() >= MmiTier::Avx512) {
+        c.vpsraq(hi, src, 32);
+    } else {
+        c.vpshufd(xmm0, src, 1 | 3 << 2);
+        c.vpmovsxdq(hi, xmm0);
+    }
+}
+
+// PSLLVW, PSRLVW and PSRAVW: words 0 and 2 of rt shifted by the lower 5 bits of words 0 and 2 of rs, sign-extended.
+// shift_per_word(dst, src, counts) is the AVX2 shift by a count per word, and shift(dst, src, count) the shift of all
+// words by the count in the lower doubleword of count.
+static void emit_shift_variable_word(u32 rs, u32 rt, u32 rd, auto shift_per_word, auto shift)
+{
+    auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
+    c.vpslld(xmm0, hs, 27);
+    c.vpsrld(xmm0, xmm0, 27);
+    if (GetMmiTier() >= MmiTier::Avx2) {
+        shift_per_word(xmm0, ht, xmm0);
+    } else {
+        c.vpmovzxdq(xmm1, xmm0);
+        shift(xmm2, ht, xmm1);
+        c.vpsrldq(xmm1, xmm0, 8);
+        c.vpmovzxdq(xmm1, xmm1);
+        shift(xmm3, ht, xmm1);
+        c.vpblendw(xmm0, xmm2, xmm3, 0xF0);
+    }
+    emit_sign_extend_even_words(hd, xmm0);
+}
+
+// PEXT5 and PPAC5 in vector registers, without BMI2 or where AVX-512 merges each bit field in one instruction: moves the
+// 5-5-5-1 bit fields of each word of src between bits 0, 5, 10 and 15 (packed) and bits 3, 11, 19 and 31 (extended)
+static void emit_move_5bit_fields(Xmm dst, Xmm src, bool extend)
+{
+    alignas(16) static constexpr u32 packed_masks[4][4] = {
+        { 0x1F, 0x1F, 0x1F, 0x1F },
+        { 0x3E0, 0x3E0, 0x3E0, 0x3E0 },
+        { 0x7C00, 0x7C00, 0x7C00, 0x7C00 },
+        { 0x8000, 0x8000, 0x8000, 0x8000 },
+    };
+    alignas(16) static constexpr u32 extended_masks[4][4] = {
+        { 0xF8, 0xF8, 0xF8, 0xF8 },
+        { 0xF800, 0xF800, 0xF800, 0xF800 },
+        { 0xF8'0000, 0xF8'0000, 0xF8'0000, 0xF8'0000 },
+        { 0x8000'0000, 0x8000'0000, 0x8000'0000, 0x8000'0000 },
+    };
+    static constexpr u8 shifts[4] = { 3, 6, 9, 16 };
+    for (int i = 0; i < 4; ++i) {
+        Xmm field = i == 0 ? xmm0 : xmm1;
+        if (extend) {
+            c.vpslld(field, src, shifts[i]);
+        } else {
+            c.vpsrld(field, src, shifts[i]);
+        }
+        Mem mask = JitPtr(extend ? extended_masks[i] : packed_masks[i]);
+        if (i == 0) {
+            c.vpand(xmm0, xmm0, mask);
+        } else if (GetMmiTier() >= MmiTier::Avx512) {
+            c.vpternlogd(xmm0, xmm1, mask, 0xF8); // xmm0 | xmm1 & mask
+        } else {
+            c.vpand(xmm1, xmm1, mask);
+            c.vpor(xmm0, xmm0, xmm1);
+        }
+    }
+    c.vmovdqa(dst, xmm0);
+}
+
+void ForceMmiTier(std::optional<MmiTier> tier)
+{
+    forced_mmi_tier = tier;
+}
+
+MmiTier GetMmiTier()
+{
+    return forced_mmi_tier.value_or(host_mmi_tier);
+}
+
+void InitMmi(asmjit::CpuFeatures const& features)
+{
+    auto const& x86 = features.x86();
+    host_mmi_tier = MmiTier::Avx;
+    if (x86.hasAVX2() && x86.hasBMI2()) {
+        host_mmi_tier = MmiTier::Avx2;
+        if (x86.hasAVX512_F() && x86.hasAVX512_VL() && x86.hasAVX512_BW()) {
+            host_mmi_tier = MmiTier::Avx512;
+        }
+    }
+    if (forced_mmi_tier > host_mmi_tier) {
+        log_warn("EE JIT: MMI instructions are compiled for {}, which the host lacks", MmiTierName(*forced_mmi_tier));
+    }
+    log_info("EE JIT: MMI instructions compiled for {}", MmiTierName(GetMmiTier()));
+}
+
+std::string_view MmiTierName(MmiTier tier)
+{
+    return mmi_tier_names[std::to_underlying(tier)];
 }
 
-static Mem jit_ptr(auto)
+std::optional<MmiTier> ParseMmiTier(std::string_view name)
 {
-    return {};
+    auto it = std::ranges::find(mmi_tier_names, name);
+    if (it == mmi_tier_names.end()) {
+        return {};
+    }
+    return MmiTier(it - mmi_tier_names.begin());
 }
 
 void pabsh(u32 rt, u32 rd) // Parallel Absolute Halfword
@@ -115,7 +250,7 @@ void paddsw(u32 rs, u32 rt, u32 rd) // Parallel Add with Signed Saturation Word
 {
     static constexpr u32 mask = 0x8000'0000;
     auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
-    c.vpbroadcastd(xmm0, jit_ptr(mask));
+    c.vpbroadcastd(xmm0, JitPtr(mask));
     c.vpaddd(xmm1, hs, ht);
     c.vpcmpgtd(xmm2, hs, xmm1);
     c.vpxor(xmm2, ht, xmm2);
@@ -205,7 +340,7 @@ void pcpyh(u32 rt, u32 rd) // Parallel Copy Halfword
 {
     static constexpr u8 mask[] = { 0, 1, 0, 1, 0, 1, 0, 1, 8, 9, 8, 9, 8, 9, 8, 9 };
     Xmm hd = get_dirty_vpr(rd), ht = get_vpr(rt);
-    c.vpshufb(hd, ht, jit_ptr(mask));
+    c.vpshufb(hd, ht, JitPtr(mask));
 }
 
 void pcpyld(u32 rs, u32 rt, u32 rd) // Parallel Copy Lower Doubleword
@@ -262,6 +397,22 @@ void pdivbw(u32 rs, u32 rt) // Parallel Divide Broadcast Word
 
 void pdivuw(u32 rs, u32 rt) // Parallel Divide Unsigned Word
 {
+    if (GetMmiTier() >= MmiTier::Avx512) {
+        // As in pdivw, with the unsigned conversions of AVX-512, which turn a division by zero into the quotient that
+        // the EE gives it, 0xFFFF'FFFF
+        Xmm hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
+        c.vpshufd(xmm0, hs, 2 << 2);
+        c.vpshufd(xmm1, ht, 2 << 2);
+        c.vcvtudq2pd(xmm2, xmm0);
+        c.vcvtudq2pd(xmm3, xmm1);
+        c.vdivpd(xmm2, xmm2, xmm3);
+        c.vcvttpd2udq(xmm2, xmm2);
+        c.vpmulld(xmm3, xmm2, xmm1);
+        c.vpsubd(xmm3, xmm0, xmm3);
+        c.vpmovsxdq(lo, xmm2);
+        c.vpmovsxdq(hi, xmm3);
+        return;
+    }
     auto do_div = [](u32 rs, u32 rt) {
         s32 quot[2];
         s32 rem[2];
@@ -297,44 +448,29 @@ void pdivuw(u32 rs, u32 rt) // Parallel Divide Unsigned Word
     }
 }
 
+// Words 0 and 2 are divided as doubles, whose quotients truncate to the exact integer ones. Division by zero is the only
+// case to fix up; INT_MIN / -1 already converts to INT_MIN, and the remainder follows from the quotient either way.
 void pdivw(u32 rs, u32 rt) // Parallel Divide Word
 {
-    auto do_div = [](u32 rs, u32 rt) {
-        s32 quot[2];
-        s32 rem[2];
-        for (int i = 0; i < 2; ++i) {
-            s32 op1, op2;
-            std::memcpy(&op1, reinterpret_cast<u8*>(&gpr[rs]) + 8 * i, 4);
-            std::memcpy(&op2, reinterpret_cast<u8*>(&gpr[rt]) + 8 * i, 4);
-            if (op2 == 0) {
-                quot[i] = op1 >= 0 ? -1 : 1;
-                rem[i] = op1;
-            } else if (op1 == std::numeric_limits<s32>::min() && op2 == -1) {
-                quot[i] = op1;
-                rem[i] = 0;
-            } else [[likely]] {
-                quot[i] = op1 / op2;
-                rem[i] = op1 % op2;
-            }
-        }
-        lo = std::bit_cast<u128>(_mm_set_epi64x(quot[1], quot[0]));
-        hi = std::bit_cast<u128>(_mm_set_epi64x(rem[1], rem[0]));
-    };
-    reg_alloc.FlushAll();
-    if constexpr (platform.abi.systemv) {
-        c.push(rax);
-        c.mov(edi, rs);
-        c.mov(esi, rt);
-        c.call(+do_div);
-        c.pop(rcx);
-    }
-    if constexpr (platform.abi.win64) {
-        c.sub(rsp, 40);
-        c.mov(cl, rs);
-        c.mov(dl, rt);
-        c.call(+do_div);
-        c.add(rsp, 40);
-    }
+    Xmm hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
+    c.vpshufd(xmm0, hs, 2 << 2);
+    c.vpshufd(xmm1, ht, 2 << 2);
+    c.vcvtdq2pd(xmm2, xmm0);
+    c.vcvtdq2pd(xmm3, xmm1);
+    c.vdivpd(xmm2, xmm2, xmm3);
+    c.vcvttpd2dq(xmm2, xmm2);
+    c.vpxor(xmm3, xmm3, xmm3);
+    c.vpcmpeqd(xmm3, xmm1, xmm3);
+    c.vpsrad(lo, xmm0, 31);
+    c.vpcmpeqd(hi, hi, hi);
+    c.vpxor(lo, lo, hi);
+    c.vpsrld(hi, hi, 31);
+    c.vpor(lo, lo, hi); // the quotient of a division by zero: -1 if the dividend is non-negative, otherwise 1
+    c.vblendvps(xmm2, xmm2, lo, xmm3);
+    c.vpmulld(xmm3, xmm2, xmm1);
+    c.vpsubd(xmm3, xmm0, xmm3);
+    c.vpmovsxdq(lo, xmm2);
+    c.vpmovsxdq(hi, xmm3);
 }
 
 void pexch(u32 rt, u32 rd) // Parallel Exchange Center Halfword
@@ -368,12 +504,16 @@ void pext5(u32 rt, u32 rd) // Parallel Extend Upper from 5 bits
     static constexpr u8 shuf_mask[16] = { 0, 1, 4, 5, 8, 9, 12, 13, 0, 0, 0, 0, 0, 0, 0, 0 };
     static constexpr u64 pdep_mask = 0x80f8'f8f8'80f8'f8f8;
     Xmm hd = get_dirty_vpr(rd), ht = get_vpr(rt);
-    c.vpshufb(xmm0, ht, jit_ptr(shuf_mask));
+    if (GetMmiTier() != MmiTier::Avx2) {
+        emit_move_5bit_fields(hd, ht, true);
+        return;
+    }
+    c.vpshufb(xmm0, ht, JitPtr(shuf_mask));
     c.vmovq(rax, xmm0);
-    c.pdep(rcx, rax, jit_ptr(pdep_mask));
+    c.pdep(rcx, rax, JitPtr(pdep_mask));
     c.vmovq(hd, rcx);
     c.shr(rax, 32);
-    c.pdep(rcx, rax, jit_ptr(pdep_mask));
+    c.pdep(rcx, rax, JitPtr(pdep_mask));
     c.vpinsrq(hd, hd, rcx, 1);
 }
 
@@ -493,26 +633,18 @@ void pmadduw(u32 rs, u32 rt, u32 rd) // Parallel Multiply-Add Unsigned Word
 {
     Xmm hd = get_dirty_vpr(rd), hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
     c.vpmuludq(xmm0, hs, ht);
-    c.vpslldq(xmm1, hi, 4);
-    c.vpblendd(xmm1, xmm1, lo, 5);
+    emit_combine_lo_hi(xmm1, lo, hi);
     c.vpaddq(hd, xmm0, xmm1);
-    c.vpshufd(xmm0, hd, 2 << 2);
-    c.vpshufd(xmm1, hd, 1 | 3 << 2);
-    c.vpmovsxdq(lo, xmm0);
-    c.vpmovsxdq(hi, xmm1);
+    emit_split_lo_hi(hd, lo, hi);
 }
 
 void pmaddw(u32 rs, u32 rt, u32 rd) // Parallel Multiply-Add Word
 {
     Xmm hd = get_dirty_vpr(rd), hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
     c.vpmuldq(xmm0, hs, ht);
-    c.vpslldq(xmm1, hi, 4);
-    c.vpblendd(xmm1, xmm1, lo, 5);
+    emit_combine_lo_hi(xmm1, lo, hi);
     c.vpaddq(hd, xmm0, xmm1);
-    c.vpshufd(xmm0, hd, 2 << 2);
-    c.vpshufd(xmm1, hd, 1 | 3 << 2);
-    c.vpmovsxdq(lo, xmm0);
-    c.vpmovsxdq(hi, xmm1);
+    emit_split_lo_hi(hd, lo, hi);
 }
 
 void pmaxh(u32 rs, u32 rt, u32 rd) // Parallel Maximum Halfword
@@ -547,8 +679,8 @@ void pmfhl(u32 rd, u32 fmt) // Parallel Move From HI/LO Register
     if (fmt == 2) {
         static constexpr s64 mask_min = std::numeric_limits<s32>::min();
         static constexpr s64 mask_max = std::numeric_limits<s32>::max();
-        c.vpbroadcastq(xmm0, jit_ptr(mask_min));
-        c.vpbroadcastq(xmm1, jit_ptr(mask_max));
+        c.vpbroadcastq(xmm0, JitPtr(mask_min));
+        c.vpbroadcastq(xmm1, JitPtr(mask_max));
         c.vpslldq(xmm2, hi, 4);
         c.vpblendd(xmm2, xmm2, lo, 5);
         c.vpcmpgtq(xmm3, xmm2, xmm0);
@@ -607,13 +739,9 @@ void pmsubw(u32 rs, u32 rt, u32 rd) // Parallel Multiply-Subtract Word
 {
     Xmm hd = get_dirty_vpr(rd), hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
     c.vpmuldq(xmm0, hs, ht);
-    c.vpslldq(xmm1, hi, 4);
-    c.vpblendd(xmm1, xmm1, lo, 5);
+    emit_combine_lo_hi(xmm1, lo, hi);
     c.vpsubq(hd, xmm1, xmm0);
-    c.vpshufd(xmm0, hd, 2 << 2);
-    c.vpshufd(xmm1, hd, 1 | 3 << 2);
-    c.vpmovsxdq(lo, xmm0);
-    c.vpmovsxdq(hi, xmm1);
+    emit_split_lo_hi(hd, lo, hi);
 }
 
 void pmthi(u32 rs) // Parallel Move To HI Register
@@ -653,20 +781,14 @@ void pmultuw(u32 rs, u32 rt, u32 rd) // Parallel Multiply Unsigned Word
 {
     Xmm hd = get_dirty_vpr(rd), hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
     c.vpmuludq(hd, hs, ht);
-    c.vpshufd(xmm0, hd, 2 << 2);
-    c.vpshufd(xmm1, hd, 1 | 3 << 2);
-    c.vpmovsxdq(lo, xmm0);
-    c.vpmovsxdq(hi, xmm1);
+    emit_split_lo_hi(hd, lo, hi);
 }
 
 void pmultw(u32 rs, u32 rt, u32 rd) // Parallel Multiply Word
 {
     Xmm hd = get_dirty_vpr(rd), hs = get_vpr(rs), ht = get_vpr(rt), lo = get_dirty_lo(), hi = get_dirty_hi();
     c.vpmuldq(hd, hs, ht);
-    c.vpshufd(xmm0, hd, 2 << 2);
-    c.vpshufd(xmm1, hd, 1 | 3 << 2);
-    c.vpmovsxdq(lo, xmm0);
-    c.vpmovsxdq(hi, xmm1);
+    emit_split_lo_hi(hd, lo, hi);
 }
 
 void pnor(u32 rs, u32 rt, u32 rd) // Parallel NOR
@@ -688,28 +810,44 @@ void ppac5(u32 rt, u32 rd) // Parallel Pack to 5 bits
     static constexpr u8 shuf_mask[16] = { 0, 1, 0x80, 0x80, 2, 3, 0x80, 0x80, 4, 5, 0x80, 0x80, 6, 7, 0x80, 0x80 };
     static constexpr u64 pext_mask = 0x80f8'f8f8'80f8'f8f8;
     Xmm hd = get_dirty_vpr(rd), ht = get_vpr(rt);
+    if (GetMmiTier() != MmiTier::Avx2) {
+        emit_move_5bit_fields(hd, ht, false);
+        return;
+    }
     c.vmovq(rax, ht);
-    c.pext(rcx, rax, jit_ptr(pext_mask));
+    c.pext(rcx, rax, JitPtr(pext_mask));
     c.vmovq(xmm0, rcx);
     c.vpextrq(rax, ht, 1);
-    c.pext(rcx, rax, jit_ptr(pext_mask));
+    c.pext(rcx, rax, JitPtr(pext_mask));
     c.vpinsrq(xmm0, xmm0, rcx, 1);
-    c.vpshufb(hd, xmm0, jit_ptr(shuf_mask));
+    c.vpshufb(hd, xmm0, JitPtr(shuf_mask));
 }
 
 void ppacb(u32 rs, u32 rt, u32 rd) // Parallel Pack to Byte
 {
     auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
+    if (GetMmiTier() >= MmiTier::Avx512) {
+        c.vpmovwb(xmm0, ht);
+        c.vpmovwb(xmm1, hs);
+        c.vpunpcklqdq(hd, xmm0, xmm1);
+        return;
+    }
     static constexpr u8 mask1[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 4, 6, 8, 10, 12, 14 };
     static constexpr u8 mask2[16] = { 0, 2, 4, 6, 8, 10, 12, 14, 0, 0, 0, 0, 0, 0, 0, 0 };
-    c.vpshufb(xmm0, hs, jit_ptr(mask1));
-    c.vpshufb(xmm1, ht, jit_ptr(mask2));
+    c.vpshufb(xmm0, hs, JitPtr(mask1));
+    c.vpshufb(xmm1, ht, JitPtr(mask2));
     c.vpblendw(hd, xmm0, xmm1, 15);
 }
 
 void ppach(u32 rs, u32 rt, u32 rd) // Parallel Pack to Halfword
 {
     auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
+    if (GetMmiTier() >= MmiTier::Avx512) {
+        c.vpmovdw(xmm0, ht);
+        c.vpmovdw(xmm1, hs);
+        c.vpunpcklqdq(hd, xmm0, xmm1);
+        return;
+    }
     c.vpxor(xmm0, xmm0, xmm0);
     c.vpblendw(xmm1, xmm0, hs, 0x55);
     c.vpblendw(xmm2, xmm0, ht, 0x55);
@@ -743,12 +881,8 @@ void psllh(u32 rt, u32 rd, u32 sa) // Parallel Shift Left Logical Halfword
 
 void psllvw(u32 rs, u32 rt, u32 rd) // Parallel Shift Left Logical Variable Word
 {
-    auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
-    c.vpslld(xmm0, hs, 27);
-    c.vpsrld(xmm0, xmm0, 27);
-    c.vpsllvd(xmm0, ht, xmm0);
-    c.vpshufd(xmm0, xmm0, 2 << 2);
-    c.vpmovsxdq(hd, xmm0);
+    emit_shift_variable_word(
+      rs, rt, rd, [](Xmm d, Xmm s, Xmm n) { c.vpsllvd(d, s, n); }, [](Xmm d, Xmm s, Xmm n) { c.vpslld(d, s, n); });
 }
 
 void psllw(u32 rt, u32 rd, u32 sa) // Parallel Shift Left Logical Word
@@ -765,12 +899,8 @@ void psrah(u32 rt, u32 rd, u32 sa) // Parallel Shift Right Arithmetic Halfword
 
 void psravw(u32 rs, u32 rt, u32 rd) // Parallel Shift Right Arithmetic Variable Word
 {
-    auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
-    c.vpslld(xmm0, hs, 27);
-    c.vpsrld(xmm0, xmm0, 27);
-    c.vpsravd(xmm0, ht, xmm0);
-    c.vpshufd(xmm0, xmm0, 2 << 2);
-    c.vpmovsxdq(hd, xmm0);
+    emit_shift_variable_word(
+      rs, rt, rd, [](Xmm d, Xmm s, Xmm n) { c.vpsravd(d, s, n); }, [](Xmm d, Xmm s, Xmm n) { c.vpsrad(d, s, n); });
 }
 
 void psraw(u32 rt, u32 rd, u32 sa) // Parallel Shift Right Arithmetic Word
@@ -787,12 +917,8 @@ void psrlh(u32 rt, u32 rd, u32 sa) // Parallel Shift Right Logical Halfword
 
 void psrlvw(u32 rs, u32 rt, u32 rd) // Parallel Shift Right Logical Variable Word
 {
-    auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
-    c.vpslld(xmm0, hs, 27);
-    c.vpsrld(xmm0, xmm0, 27);
-    c.vpsrlvd(xmm0, ht, xmm0);
-    c.vpshufd(xmm0, xmm0, 2 << 2);
-    c.vpmovsxdq(hd, xmm0);
+    emit_shift_variable_word(
+      rs, rt, rd, [](Xmm d, Xmm s, Xmm n) { c.vpsrlvd(d, s, n); }, [](Xmm d, Xmm s, Xmm n) { c.vpsrld(d, s, n); });
 }
 
 void psrlw(u32 rt, u32 rd, u32 sa) // Parallel Shift Right Logical Word
@@ -829,7 +955,7 @@ void psubsw(u32 rs, u32 rt, u32 rd) // Parallel Subtract with Signed Saturation
 {
     static constexpr u32 mask = 0x8000'0000;
     auto [hd, hs, ht] = get_vpr_rd_rs_rt(rd, rs, rt);
-    c.vpbroadcastd(xmm0, jit_ptr(mask));
+    c.vpbroadcastd(xmm0, JitPtr(mask));
     c.vpxor(xmm1, xmm1, xmm1);
     c.vpcmpgtd(xmm1, ht, xmm1);
     c.vpsubd(xmm2, hs, ht);
@@ -908,6 +1034,7 @@ void qfsrv(u32 rs, u32 rt, u32 rd) // Quadword Funnel Shift Right Variable
         c.call(+do_qfsrv);
         c.add(rsp, 40);
     }
+    reg_alloc.ClearConst(rd);
 }
 
 } // namespace ee
@@ -1,9 +1,30 @@
 #pragma once
 
+#include "asmjit/x86.h"
 #include "numtypes.hpp"
 
+#include <optional>
+#include <string_view>
+
 namespace ee {
 
+// The instruction sets that MMI instructions are compiled for, each including those of the tiers before it: AVX, for
+// the VEX encodings of SSE4.1 that the whole JIT emits; AVX2 with BMI2; AVX-512 F, VL and BW
+enum class MmiTier {
+    Avx,
+    Avx2,
+    Avx512,
+};
+
+// For tests and benchmarks, which exercise every tier on one host: compiles MMI instructions for tier, whether or not
+// the host supports it, or again for the best tier the host supports, if nullopt
+void ForceMmiTier(std::optional<MmiTier> tier);
+MmiTier GetMmiTier();
+// Picks the best tier that the host supports; called by InitJit
+void InitMmi(asmjit::CpuFeatures const& features);
+std::string_view MmiTierName(MmiTier tier);
+std::optional<MmiTier> ParseMmiTier(std::string_view name);
+
 void madd(u32 rs, u32 rt, u32 rd);
 void madd1(u32 rs, u32 rt, u32 rd);
 void maddu(u32 rs, u32 rt, u32 rd);
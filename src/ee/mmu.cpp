@@ -4,21 +4,63 @@
 #include "exceptions.hpp"
 #include "frontend/message.hpp"
 #include "intc.hpp"
+#include "log.hpp"
 #include "timers.hpp"
 
 #include <bit>
 #include <cassert>
 #include <cstring>
 #include <format>
+#include <limits>
+#include <utility>
+#include <vector>
 
 namespace ee {
 
-template<ee_uint Int> static Int read_bios(u32 addr);
-template<ee_uint Int> static Int read_io(u32 addr);
-template<ee_uint Int> static Int read_rdram(u32 addr);
-template<ee_uint Int> static void write_io(u32 addr, Int data);
+enum class VtlbState : u8 {
+    Invalid, // the entry that matches has V clear
+    Miss, // no entry matches
+    ReadOnly, // D clear; stores raise TLB modification exceptions
+    ReadWrite,
+};
+
+// What a search of tlb_entries under the current ASID finds for a 4 KiB virtual page
+struct VtlbEntry {
+    u32 paddr; // of the page
+    VtlbState state;
+    u8 tlb_index; // of the first entry that matches; tlb_entries.size() on a miss
+};
+
+// A 4 KiB page of physical memory: either host memory, or IO registers
+struct PhysicalPage {
+    u8* host; // the page within rdram or bios
+    bool read_only; // ROM; writes are ignored
+    u8 io_handlers; // index into io_handler_sets, if host is null
+};
+
+static void map_memory(u32 paddr, u32 size, u8* host, size_t host_size, bool read_only);
+template<ee_uint Int> static Int read_io(IoHandlers const& handlers, u32 paddr);
+template<ee_uint Int> static Int read_physical(u32 paddr);
+template<ee_uint Int> static Int read_unmapped(u32 paddr);
+static VtlbEntry search_tlb(u32 vaddr, size_t first_index);
+static std::pair<u32, u32> tlb_entry_pages(TlbEntry const& entry);
 template<MemOp> static u32 tlb_addr_translation(u32 vaddr);
 template<MemOp> static u32 virt_to_phys_addr(u32 vaddr);
+template<ee_uint Int> static void write_io(IoHandlers const& handlers, u32 paddr, Int data);
+template<ee_uint Int> static void write_physical(u32 paddr, Int data);
+template<ee_uint Int> static void write_unmapped(u32 paddr, Int data);
+
+constexpr u32 physical_page_shift = 12;
+constexpr u32 physical_memory_size = 0x2000'0000; // what kseg0 and kseg1 reach
+
+// Zero-initialized, every page is unmapped until init_memory_map
+static std::array<PhysicalPage, (physical_memory_size >> physical_page_shift)> physical_pages;
+static std::vector<IoHandlers> io_handler_sets; // the first is for unmapped memory
+
+// Software TLB, one entry per 4 KiB virtual page. Zero-initialized, it reads as entry 0 matching every page with V
+// clear, which is what a search finds among TLB entries that have never been written.
+static std::array<VtlbEntry, 0x10'0000> vtlb;
+static u8 vtlb_asid; // that vtlb was built under
 
 void TlbEntry::read() const
 {
@@ -27,10 +69,13 @@ void TlbEntry::read() const
     cop0.entry_lo[0].g = cop0.entry_lo[1].g = hi.g;
     cop0.entry_hi.raw = hi.raw & ~page_mask & ~0x1F00;
     cop0.page_mask = page_mask;
+    sync_vtlb_asid();
 }
 
 void TlbEntry::write()
 {
+    size_t index = size_t(this - tlb_entries.data());
+    auto [old_first_page, old_num_pages] = tlb_entry_pages(*this);
     lo[0].raw = cop0.entry_lo[0].raw & ~1;
     lo[1].raw = cop0.entry_lo[1].raw & ~1;
     hi.raw = cop0.entry_hi.raw & ~cop0.page_mask;
@@ -40,51 +85,152 @@ void TlbEntry::write()
     vpn2_addr_mask = ~page_mask & ~0x1FFF;
     vpn2_compare = hi.raw & vpn2_addr_mask;
     offset_addr_mask = page_mask >> 1 | 0xFFF;
+
+    // Pages the entry used to translate may now fall through to a later entry; in its new range, it takes precedence
+    // over later entries. Earlier entries are unaffected either way.
+    for (u32 page = old_first_page; page < old_first_page + old_num_pages; ++page) {
+        if (vtlb[page].tlb_index == index) {
+            vtlb[page] = search_tlb(page << 12, index);
+        }
+    }
+    if (hi.g || hi.asid == cop0.entry_hi.asid) {
+        auto [first_page, num_pages] = tlb_entry_pages(*this);
+        for (u32 page = first_page; page < first_page + num_pages; ++page) {
+            if (vtlb[page].tlb_index >= index) {
+                vtlb[page] = search_tlb(page << 12, index);
+            }
+        }
+    }
 }
 
 u32 devirtualize(u32 vaddr)
 {
-    return vaddr; // TODO
+    return virt_to_phys_addr<MemOp::InstrFetch>(vaddr);
 }
 
-template<ee_uint Int> Int read_bios(u32 addr)
+PhysicalMapping get_physical_mapping(u32 paddr)
 {
-    static_assert(std::has_single_bit(bios.size()));
-    static constexpr u32 mask = u32(bios.size() - 1);
-    Int ret;
-    std::memcpy(&ret, &bios[addr & mask], sizeof(Int));
-    return ret;
+    if (paddr >= physical_memory_size) {
+        return {};
+    }
+    PhysicalPage const& page = physical_pages[paddr >> physical_page_shift];
+    if (page.host) {
+        return { .host = page.host + (paddr & 0xFFF), .read_only = page.read_only, .io_handlers = nullptr };
+    }
+    if (page.io_handlers == 0) {
+        return {};
+    }
+    return { .host = nullptr, .read_only = false, .io_handlers = &io_handler_sets[page.io_handlers] };
 }
 
-template<ee_uint Int> Int read_io(u32 addr)
+void init_memory_map()
 {
-    if constexpr (sizeof(Int) == 4) {
-        if (addr < 0x1000'2000) {
-            return timers::read_io(addr);
-        }
-        if (addr == 0x1000'F000) {
-            return read_intc_stat();
-        }
-        if (addr == 0x1000'F010) {
-            return read_intc_mask();
-        }
-    } else {
-        message::fatal(std::format("Tried to read {} bytes from IO, when only word reads are supported.", sizeof(Int)));
+    physical_pages = {};
+    io_handler_sets.clear();
+    io_handler_sets.push_back({
+      .read8 = read_unmapped<u8>,
+      .read16 = read_unmapped<u16>,
+      .read32 = read_unmapped<u32>,
+      .read64 = read_unmapped<u64>,
+      .read128 = read_unmapped<u128>,
+      .write8 = write_unmapped<u8>,
+      .write16 = write_unmapped<u16>,
+      .write32 = write_unmapped<u32>,
+      .write64 = write_unmapped<u64>,
+      .write128 = write_unmapped<u128>,
+    });
+    map_memory(0, u32(rdram.size()), rdram.data(), rdram.size(), false);
+    map_memory(0x1C00'0000, 0x0400'0000, bios.data(), bios.size(), true); // mirrored across the range
+    // Registers without a device behind them yet read as zero and ignore writes, but only as words
+    map_io(0x1000'0000, 0x0100'0000,
+      { .read32 = [](u32) { return u32(0); }, .write32 = [](u32, u32) {} });
+    map_io(0x1000'0000, 0x2000, { .read32 = timers::read_io, .write32 = timers::write_io });
+    map_io(0x1000'F000, 0x1000,
+      {
+        .read32 = [](u32 paddr) -> u32 {
+            switch (paddr) {
+            case 0x1000'F000: return read_intc_stat();
+            case 0x1000'F010: return read_intc_mask();
+            default: return 0;
+            }
+        },
+        .write32 =
+          [](u32 paddr, u32 data) {
+              switch (paddr) {
+              case 0x1000'F000: write_intc_stat(u16(data)); break;
+              case 0x1000'F010: write_intc_mask(u16(data)); break;
+              }
+          },
+      });
+}
+
+void map_io(u32 paddr, u32 size, IoHandlers const& handlers)
+{
+    assert(!(paddr & 0xFFF) && !(size & 0xFFF) && paddr + size <= physical_memory_size);
+    assert(io_handler_sets.size() <= std::numeric_limits<u8>::max());
+    io_handler_sets.push_back(handlers);
+    for (u32 page = paddr >> physical_page_shift; page < (paddr + size) >> physical_page_shift; ++page) {
+        physical_pages[page] = { .host = nullptr, .read_only = false, .io_handlers = u8(io_handler_sets.size() - 1) };
+    }
+}
+
+// Maps host memory of host_size bytes over [paddr, paddr + size), repeating it if size is larger
+void map_memory(u32 paddr, u32 size, u8* host, size_t host_size, bool read_only)
+{
+    for (u32 offset = 0; offset < size; offset += 1 << physical_page_shift) {
+        physical_pages[(paddr + offset) >> physical_page_shift] = {
+            .host = host + offset % host_size,
+            .read_only = read_only,
+            .io_handlers = 0,
+        };
+    }
+}
+
+template<ee_uint Int> Int read_io(IoHandlers const& handlers, u32 paddr)
+{
+    auto handler = handlers.read_handler<Int>();
+    if (!handler) {
+        message::fatal(std::format("Tried to read {} bytes from IO at {:08X}, which does not support that width.",
+          sizeof(Int), paddr));
+        return {};
     }
+    return handler(paddr);
+}
+
+template<ee_uint Int> Int read_physical(u32 paddr)
+{
+    if (paddr >= physical_memory_size) [[unlikely]] {
+        return read_unmapped<Int>(paddr);
+    }
+    PhysicalPage const& page = physical_pages[paddr >> physical_page_shift];
+    if (page.host) [[likely]] {
+        Int ret;
+        std::memcpy(&ret, page.host + (paddr & 0xFFF), sizeof(Int));
+        return ret;
+    }
+    return read_io<Int>(io_handler_sets[page.io_handlers], paddr);
+}
+
+template<ee_uint Int> Int read_unmapped(u32 paddr)
+{
+    log_error("EE: Tried to read {} bytes from unmapped physical address {:08X}", sizeof(Int), paddr);
     return {};
 }
 
-template<ee_uint Int> Int read_rdram(u32 addr)
+void rebuild_vtlb()
 {
-    static_assert(std::has_single_bit(rdram.size()));
-    Int ret;
-    std::memcpy(&ret, &rdram[addr & (rdram.size() - 1)], sizeof(Int));
-    return ret;
+    vtlb_asid = cop0.entry_hi.asid;
+    for (u32 page = 0; page < vtlb.size(); ++page) {
+        vtlb[page] = search_tlb(page << 12, 0);
+    }
 }
 
-template<MemOp mem_op> u32 tlb_addr_translation(u32 vaddr)
+// Searches tlb_entries from first_index on; the same search the hardware makes, but done only when an entry or the ASID
+// changes, to keep vtlb up to date
+VtlbEntry search_tlb(u32 vaddr, size_t first_index)
 {
-    for (TlbEntry const& entry : tlb_entries) {
+    for (size_t i = first_index; i < tlb_entries.size(); ++i) {
+        TlbEntry const& entry = tlb_entries[i];
         // Compare the virtual page number (divided by two; VPN2) of the entry with the VPN2 of the virtual address
         if ((vaddr & entry.vpn2_addr_mask) != entry.vpn2_compare) continue;
         // If the global bit is clear, the entry's ASID must coincide with the one in the EntryHi register
@@ -92,26 +238,55 @@ template<MemOp mem_op> u32 tlb_addr_translation(u32 vaddr)
         // The VPN maps to two (consecutive) pages; EntryLo0 for even virtual pages and EntryLo1 for odd virtual pages.
         bool vpn_odd = vaddr & (entry.offset_addr_mask + 1);
         auto entry_lo = entry.lo[vpn_odd];
-        if (!entry_lo.v) {
-            tlb_invalid_exception(vaddr, mem_op);
-            return 0;
-        }
-        if constexpr (mem_op == MemOp::DataWrite) {
-            if (!entry_lo.d) {
-                tlb_mod_exception(vaddr);
-                return 0;
+        u32 offset = vaddr & entry.offset_addr_mask & ~0xFFF;
+        u32 pfn = entry_lo.pfn << 12 & ~entry.offset_addr_mask;
+        VtlbState state = !entry_lo.v ? VtlbState::Invalid
+                        : entry_lo.d  ? VtlbState::ReadWrite
+                                      : VtlbState::ReadOnly;
+        return { .paddr = offset | pfn, .state = state, .tlb_index = u8(i) };
+    }
+    return { .paddr = 0, .state = VtlbState::Miss, .tlb_index = u8(tlb_entries.size()) };
+}
+
+void sync_vtlb_asid()
+{
+    if (cop0.entry_hi.asid == vtlb_asid) {
+        return;
+    }
+    vtlb_asid = cop0.entry_hi.asid;
+    // Only the pages of entries that are not global translate differently under another ASID
+    for (TlbEntry const& entry : tlb_entries) {
+        if (!entry.hi.g) {
+            auto [first_page, num_pages] = tlb_entry_pages(entry);
+            for (u32 page = first_page; page < first_page + num_pages; ++page) {
+                vtlb[page] = search_tlb(page << 12, 0);
             }
         }
-        // TLB hit
-        u32 offset = vaddr & entry.offset_addr_mask;
-        u32 pfn = entry_lo.pfn << 12 & ~entry.offset_addr_mask;
-        return offset | pfn;
     }
-    // TLB miss
-    tlb_refill_exception(vaddr, mem_op);
+}
+
+template<MemOp mem_op> u32 tlb_addr_translation(u32 vaddr)
+{
+    VtlbEntry const& entry = vtlb[vaddr >> 12];
+    VtlbState required_state = mem_op == MemOp::DataWrite ? VtlbState::ReadWrite : VtlbState::ReadOnly;
+    if (entry.state >= required_state) [[likely]] {
+        return entry.paddr | vaddr & 0xFFF;
+    }
+    switch (entry.state) {
+    case VtlbState::Invalid: tlb_invalid_exception(vaddr, mem_op); break;
+    case VtlbState::Miss: tlb_refill_exception(vaddr, mem_op); break;
+    default: tlb_mod_exception(vaddr); break;
+    }
     return 0;
 }
 
+// The 4 KiB pages an entry matches, as the first page and the number of pages: both pages of its pair, or all pages
+// for an entry that has never been written
+std::pair<u32, u32> tlb_entry_pages(TlbEntry const& entry)
+{
+    return { entry.vpn2_compare >> 12, u32((u64(~entry.vpn2_addr_mask) + 1) >> 12) };
+}
+
 template<MemOp mem_op> u32 virt_to_phys_addr(u32 vaddr)
 {
     if (vaddr < 0x8000'0000) {
@@ -135,34 +310,56 @@ template<ee_uint Int, Alignment alignment, MemOp mem_op> Int virtual_read(u32 ad
 
     u32 paddr = virt_to_phys_addr<mem_op>(addr);
     if (exception_occurred) return {};
-
-    if (paddr < 0x0200'0000) return read_rdram<Int>(paddr);
-    if (paddr < 0x1000'0000) assert(false);
-    if (paddr < 0x1100'0000) return read_io<Int>(paddr);
-    if (paddr < 0x1101'0000) {}
-    if (paddr < 0x1200'0000) {}
-    if (paddr < 0x1200'2000) {}
-    if (paddr < 0x1C00'0000) assert(false);
-    if (paddr < 0x2000'0000) return read_bios<Int>(paddr);
-    assert(false);
-    return {};
+    return read_physical<Int>(paddr);
 }
 
-template<ee_uint Int> static void write_io(u32 addr, Int data)
+template<ee_uint Int, Alignment alignment> void virtual_write(u32 addr, Int data)
 {
-    if constexpr (sizeof(Int) == 4) {
-        if (addr < 0x1000'2000) {
-            timers::write_io(addr, data);
-        }
-        if (addr == 0x1000'F000) {
-            write_intc_stat(u16(data));
+    static constexpr size_t size = sizeof(Int);
+    if constexpr (alignment == Alignment::Aligned && size > 1 && size < 16) {
+        if (addr & (size - 1)) {
+            address_error_exception(addr, MemOp::DataWrite);
+            return;
         }
-        if (addr == 0x1000'F010) {
-            write_intc_mask(u16(data));
+    }
+
+    u32 paddr = virt_to_phys_addr<MemOp::DataWrite>(addr);
+    if (exception_occurred) return;
+    write_physical(paddr, data);
+}
+
+template<ee_uint Int> void write_io(IoHandlers const& handlers, u32 paddr, Int data)
+{
+    auto handler = handlers.write_handler<Int>();
+    if (!handler) {
+        message::fatal(std::format("Tried to write {} bytes to IO at {:08X}, which does not support that width.",
+          sizeof(Int), paddr));
+        return;
+    }
+    handler(paddr, data);
+}
+
+// Writes to RDRAM pages that code has been compiled from fault, and are resolved by the JIT, like stores from JIT code
+template<ee_uint Int> void write_physical(u32 paddr, Int data)
+{
+    if (paddr >= physical_memory_size) [[unlikely]] {
+        write_unmapped(paddr, data);
+        return;
+    }
+    PhysicalPage const& page = physical_pages[paddr >> physical_page_shift];
+    if (page.host) [[likely]] {
+        if (!page.read_only) {
+            std::memcpy(page.host + (paddr & 0xFFF), &data, sizeof(Int));
         }
-    } else {
-        message::fatal(std::format("Tried to write {} bytes to IO, when only word writes are supported.", sizeof(Int)));
+        return;
     }
+    write_io(io_handler_sets[page.io_handlers], paddr, data);
+}
+
+template<ee_uint Int> void write_unmapped(u32 paddr, Int data)
+{
+    (void)data;
+    log_error("EE: Tried to write {} bytes to unmapped physical address {:08X}", sizeof(Int), paddr);
 }
 
 template u8 virtual_read<u8, Alignment::Aligned, MemOp::DataRead>(u32);
@@ -173,5 +370,12 @@ template u128 virtual_read<u128, Alignment::Aligned, MemOp::DataRead>(u32);
 template u32 virtual_read<u32, Alignment::Unaligned, MemOp::DataRead>(u32);
 template u64 virtual_read<u64, Alignment::Unaligned, MemOp::DataRead>(u32);
 template u32 virtual_read<u32, Alignment::Aligned, MemOp::InstrFetch>(u32);
+template void virtual_write<u8, Alignment::Aligned>(u32, u8);
+template void virtual_write<u16, Alignment::Aligned>(u32, u16);
+template void virtual_write<u32, Alignment::Aligned>(u32, u32);
+template void virtual_write<u64, Alignment::Aligned>(u32, u64);
+template void virtual_write<u128, Alignment::Aligned>(u32, u128);
+template void virtual_write<u32, Alignment::Unaligned>(u32, u32);
+template void virtual_write<u64, Alignment::Unaligned>(u32, u64);
 
 } // namespace ee
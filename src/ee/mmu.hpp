@@ -21,6 +21,47 @@ enum class MemOp {
     InstrFetch
 };
 
+// Handlers for the IO registers in a range of physical memory, one per access width; null for widths that the registers
+// cannot be accessed with, which is fatal.
+struct IoHandlers {
+    u8 (*read8)(u32 paddr) = nullptr;
+    u16 (*read16)(u32 paddr) = nullptr;
+    u32 (*read32)(u32 paddr) = nullptr;
+    u64 (*read64)(u32 paddr) = nullptr;
+    u128 (*read128)(u32 paddr) = nullptr;
+    void (*write8)(u32 paddr, u8 data) = nullptr;
+    void (*write16)(u32 paddr, u16 data) = nullptr;
+    void (*write32)(u32 paddr, u32 data) = nullptr;
+    void (*write64)(u32 paddr, u64 data) = nullptr;
+    void (*write128)(u32 paddr, u128 data) = nullptr;
+
+    template<ee_uint Int> auto read_handler() const
+    {
+        if constexpr (sizeof(Int) == 1) return read8;
+        if constexpr (sizeof(Int) == 2) return read16;
+        if constexpr (sizeof(Int) == 4) return read32;
+        if constexpr (sizeof(Int) == 8) return read64;
+        if constexpr (sizeof(Int) == 16) return read128;
+    }
+
+    template<ee_uint Int> auto write_handler() const
+    {
+        if constexpr (sizeof(Int) == 1) return write8;
+        if constexpr (sizeof(Int) == 2) return write16;
+        if constexpr (sizeof(Int) == 4) return write32;
+        if constexpr (sizeof(Int) == 8) return write64;
+        if constexpr (sizeof(Int) == 16) return write128;
+    }
+};
+
+// What a physical address resolves to: host memory, or else the IO handlers of its page; neither, if it is unmapped.
+// Stable once init_memory_map has run, so that the JIT can access addresses known at compile time directly.
+struct PhysicalMapping {
+    u8* host;
+    bool read_only;
+    IoHandlers const* io_handlers;
+};
+
 struct TlbEntry {
     union {
         u32 raw;
@@ -59,25 +100,26 @@ inline constexpr size_t bios_size = 4 * 1024 * 1024;
 
 inline std::array<TlbEntry, 48> tlb_entries;
 
-inline std::array<u8, bios_size> bios;
-inline std::array<u8, 32 * 1024 * 1024> rdram;
+// Page aligned (up to 16 KiB host pages), so that fastmem can replace their pages with views of shared memory, and so
+// that the JIT can write-protect RDRAM pages that code has been compiled from
+alignas(0x4000) inline std::array<u8, bios_size> bios;
+alignas(0x4000) inline std::array<u8, 32 * 1024 * 1024> rdram;
 
 u32 devirtualize(u32 vaddr);
+PhysicalMapping get_physical_mapping(u32 paddr);
+// Lays out physical memory: RDRAM, the BIOS, and the IO registers of the devices
+void init_memory_map();
+// Routes accesses to physical memory [paddr, paddr + size), which must be aligned to 4 KiB, to handlers. Ranges mapped
+// later take precedence.
+void map_io(u32 paddr, u32 size, IoHandlers const& handlers);
+// Rebuilds the software TLB, the table that mapped addresses are translated through, from tlb_entries
+void rebuild_vtlb();
+// Call after the ASID in EntryHi may have changed
+void sync_vtlb_asid();
 
 template<ee_uint Int, Alignment alignment = Alignment::Aligned, MemOp mem_op = MemOp::DataRead>
 Int virtual_read(u32 addr);
 
-template<size_t size, Alignment alignment = Alignment::Aligned> void virtual_write(u32 addr, auto data);
-
-template<size_t size, Alignment alignment> void virtual_write(u32 addr, auto data)
-{
-    static_assert(std::has_single_bit(size) && size <= 16 && size == sizeof(data));
-    if constexpr (alignment == Alignment::Aligned && size > 1) {
-        if (addr & (size - 1)) {
-            // address_error_exception(addr, MemOp::DataWrite);
-            return;
-        }
-    }
-}
+template<ee_uint Int, Alignment alignment = Alignment::Aligned> void virtual_write(u32 addr, Int data);
 
 } // namespace ee
@@ -9,13 +9,14 @@
 #include <algorithm>
 #include <cassert>
 #include <format>
-#include <limits>
+#include <tuple>
 
 using namespace asmjit;
 
 namespace ee {
 
-constexpr int register_stack_space = 8 * reg_alloc_nonvolatile_gprs.size();
+// Non-volatile GPRs, then non-volatile VPRs
+constexpr int register_stack_space = 8 * reg_alloc_nonvolatile_gprs.size() + 16 * reg_alloc_nonvolatile_vprs.size();
 
 static s32 get_nonvolatile_host_gpr_stack_offset(HostGpr64 const& gpr)
 {
@@ -24,6 +25,13 @@ static s32 get_nonvolatile_host_gpr_stack_offset(HostGpr64 const& gpr)
     return 8 * (s32)std::distance(reg_alloc_nonvolatile_gprs.begin(), it);
 }
 
+static s32 get_nonvolatile_host_vpr_stack_offset(HostGpr128 const& vpr)
+{
+    auto it = std::find(reg_alloc_nonvolatile_vprs.begin(), reg_alloc_nonvolatile_vprs.end(), vpr);
+    assert(it != reg_alloc_nonvolatile_vprs.end());
+    return 8 * s32(reg_alloc_nonvolatile_gprs.size()) + 16 * (s32)std::distance(reg_alloc_nonvolatile_vprs.begin(), it);
+}
+
 enum : u32 {
     lo_index = 32,
     hi_index,
@@ -33,95 +41,187 @@ RegisterAllocator::RegisterAllocator(JitCompiler& compiler)
   : c{ compiler }
 {
     std::ranges::transform(reg_alloc_volatile_gprs, gpr_bindings.begin(), [](HostGpr64 gpr) {
-        return Binding{ .host = gpr, .is_volatile = true };
+        return GprBinding{ .host = gpr, .is_volatile = true };
     });
     std::ranges::transform(reg_alloc_nonvolatile_gprs,
       gpr_bindings.begin() + reg_alloc_volatile_gprs.size(),
-      [](HostGpr64 gpr) { return Binding{ .host = gpr, .is_volatile = false }; });
+      [](HostGpr64 gpr) { return GprBinding{ .host = gpr, .is_volatile = false }; });
+    std::ranges::transform(reg_alloc_volatile_vprs, vpr_bindings.begin(), [](HostGpr128 vpr) {
+        return VprBinding{ .host = vpr, .is_volatile = true };
+    });
+    std::ranges::transform(reg_alloc_nonvolatile_vprs,
+      vpr_bindings.begin() + reg_alloc_volatile_vprs.size(),
+      [](HostGpr128 vpr) { return VprBinding{ .host = vpr, .is_volatile = false }; });
+}
+
+// A free binding, or else the one of ChooseVictim, written back if needed
+template<typename B, size_t N> B& RegisterAllocator::AcquireBinding(std::array<B, N>& bindings)
+{
+    auto free_it = std::ranges::find_if(bindings, [](B const& b) { return !b.Occupied(); });
+    B& binding = free_it != bindings.end() ? *free_it : ChooseVictim(bindings);
+    if (binding.Occupied()) {
+        if (NeedsWriteBack(binding)) {
+            Flush(binding, false);
+        }
+        ResetBinding(binding);
+    }
+    if (!binding.is_volatile) {
+        ReserveFrame();
+        if (!std::exchange(binding.host_saved, true)) {
+            SaveHost(binding.host);
+        }
+    }
+    return binding;
+}
+
+void RegisterAllocator::BeginInstruction(u64 live, std::array<u8, 32> const& next)
+{
+    live_gprs = live;
+    next_reads = next;
+    instruction_access_index = host_access_index;
 }
 
 void RegisterAllocator::BlockEpilog()
 {
-    FlushAndRestoreAll();
+    FlushAndRestoreAll(0);
+    ReleaseFrame(nonvolatile_regs_used);
+    if constexpr (!guest_gpr_base_ptr_is_pinned && !IsVolatile(guest_gpr_base_ptr_reg)) {
+        stack_is_aligned_for_call = !stack_is_aligned_for_call;
+    }
     if constexpr (platform.a64) {}
     if constexpr (platform.x64) {
-        if (nonvolatile_gprs_used) {
-            c.add(x86::rsp, register_stack_space);
-        }
-        if constexpr (!IsVolatile(guest_gpr_base_ptr_reg)) {
-            c.pop(guest_gpr_base_ptr_reg);
-            stack_is_aligned_for_call = !stack_is_aligned_for_call;
-        }
         c.ret();
     }
 }
 
 void RegisterAllocator::BlockEpilogWithJmp(void (*func)())
 {
-    FlushAndRestoreAll();
-    if constexpr (!IsVolatile(guest_gpr_base_ptr_reg)) {
-        c.pop(guest_gpr_base_ptr_reg);
+    FlushAndRestoreAll(0);
+    ReleaseFrame(nonvolatile_regs_used);
+    if constexpr (!guest_gpr_base_ptr_is_pinned && !IsVolatile(guest_gpr_base_ptr_reg)) {
         stack_is_aligned_for_call = !stack_is_aligned_for_call;
     }
     if constexpr (platform.a64) {}
     if constexpr (platform.x64) {
-        if (nonvolatile_gprs_used) {
-            c.add(x86::rsp, register_stack_space);
-        }
-        if constexpr (!IsVolatile(guest_gpr_base_ptr_reg)) {
-            c.pop(guest_gpr_base_ptr_reg);
-            stack_is_aligned_for_call = !stack_is_aligned_for_call;
-        }
         c.jmp(func);
     }
 }
 
+// Used for block exits that may be emitted mid-block, on a run-time code path. The host flags are left untouched, so
+// that the caller can emit a compare before the epilog, and the jump on its result after it.
+void RegisterAllocator::BlockEpilogWithoutRet(u32 dead_gprs) const
+{
+    FlushAndRestoreAll(dead_gprs);
+    ReleaseFrame(nonvolatile_regs_used);
+}
+
+void RegisterAllocator::BlockEpilogWithoutRet(ExitState const& state) const
+{
+    for (GprBinding const& binding : state.gpr_bindings) {
+        Flush(binding, true);
+    }
+    for (VprBinding const& binding : state.vpr_bindings) {
+        Flush(binding, true);
+    }
+    ReleaseFrame(state.nonvolatile_regs_used);
+}
+
 void RegisterAllocator::BlockProlog()
 {
     Reset();
     auto gpr_mid_ptr = gpr.data() + gpr.size() / 2;
     if constexpr (platform.a64) {}
     if constexpr (platform.x64) {
-        if constexpr (!IsVolatile(guest_gpr_base_ptr_reg)) {
-            c.push(guest_gpr_base_ptr_reg);
-            stack_is_aligned_for_call = !stack_is_aligned_for_call;
+        if constexpr (!guest_gpr_base_ptr_is_pinned) {
+            if constexpr (!IsVolatile(guest_gpr_base_ptr_reg)) {
+                c.push(guest_gpr_base_ptr_reg);
+                stack_is_aligned_for_call = !stack_is_aligned_for_call;
+            }
+            c.mov(guest_gpr_base_ptr_reg, gpr_mid_ptr);
         }
-        c.mov(guest_gpr_base_ptr_reg, gpr_mid_ptr);
     }
 }
 
-void RegisterAllocator::Flush(Binding const& b, bool restore) const
+// The binding whose guest register is read the furthest ahead, if at all. Bindings accessed by the current instruction
+// hold its operands, and are never chosen.
+template<typename B, size_t N> B& RegisterAllocator::ChooseVictim(std::array<B, N>& bindings)
 {
-    if (!b.Occupied()) return;
-    if (b.dirty) {
+    auto rank = [this](B const& b) {
+        u32 guest = b.guest.value();
+        u8 next_read = guest < 32 ? next_reads[guest] : 0; // LO and HI are not tracked
+        return std::tuple(next_read, !NeedsWriteBack(b), u16(~b.access_index));
+    };
+    B* victim{};
+    for (B& b : bindings) {
+        if (b.access_index >= instruction_access_index) continue;
+        if (!victim || rank(b) > rank(*victim)) {
+            victim = &b;
+        }
+    }
+    assert(victim);
+    return *victim;
+}
+
+void RegisterAllocator::ClearConst(u32 guest)
+{
+    const_mask &= ~(1u << guest);
+}
+
+void RegisterAllocator::Flush(GprBinding const& b, bool restore) const
+{
+    if (b.Occupied() && b.dirty) {
         s32 offset = GetGprMidPtrOffset(b.guest.value());
         if constexpr (platform.a64) {}
         if constexpr (platform.x64) {
             c.mov(qword_ptr(guest_gpr_base_ptr_reg, offset), b.host);
         }
     }
-    if (!b.is_volatile && restore) {
+    // Also for a host register whose binding was released, which still holds the value of some guest register
+    if (b.host_saved && restore) {
+        RestoreHost(b.host);
+    }
+}
+
+void RegisterAllocator::Flush(VprBinding const& b, bool restore) const
+{
+    if (b.Occupied() && b.dirty) {
+        s32 offset = GetVprMidPtrOffset(b.guest.value());
+        if constexpr (platform.a64) {}
+        if constexpr (platform.x64) {
+            c.vmovdqu(xmmword_ptr(guest_gpr_base_ptr_reg, offset), b.host);
+        }
+    }
+    // Also for a host register whose binding was released, which still holds the value of some guest register
+    if (b.host_saved && restore) {
         RestoreHost(b.host);
     }
 }
 
 void RegisterAllocator::FlushAll()
 {
-    for (Binding& binding : gpr_bindings) {
-        Flush(binding, false);
+    for (GprBinding& binding : gpr_bindings) {
+        FlushAndDestroyBinding(binding, false);
+    }
+    for (VprBinding& binding : vpr_bindings) {
+        FlushAndDestroyBinding(binding, false);
     }
 }
 
 void RegisterAllocator::FlushAndDestroyAllVolatile()
 {
-    for (Binding& binding : gpr_bindings) {
+    for (GprBinding& binding : gpr_bindings) {
+        if (binding.is_volatile) {
+            FlushAndDestroyBinding(binding, false);
+        }
+    }
+    for (VprBinding& binding : vpr_bindings) {
         if (binding.is_volatile) {
             FlushAndDestroyBinding(binding, false);
         }
     }
 }
 
-void RegisterAllocator::FlushAndDestroyBinding(Binding& b, bool restore)
+void RegisterAllocator::FlushAndDestroyBinding(auto& b, bool restore)
 {
     Flush(b, restore);
     ResetBinding(b);
@@ -130,31 +230,68 @@ void RegisterAllocator::FlushAndDestroyBinding(Binding& b, bool restore)
 // This should only be used as part of an instruction epilogue. Thus, there is no need
 // to destroy bindings. In fact, this would be undesirable, since this function could not
 // be called in an epilog emitted mid-block, as part of a code path dependent on a run-time branch.
-void RegisterAllocator::FlushAndRestoreAll() const
+void RegisterAllocator::FlushAndRestoreAll(u32 dead_gprs) const
 {
-    for (Binding const& binding : gpr_bindings) {
-        Flush(binding, true);
+    for (GprBinding const& binding : gpr_bindings) {
+        if (binding.Occupied() && dead_gprs >> binding.guest.value() & 1) {
+            if (!binding.is_volatile) {
+                RestoreHost(binding.host);
+            }
+        } else {
+            Flush(binding, true);
+        }
+    }
+    for (VprBinding const& binding : vpr_bindings) {
+        Flush(binding, true); // the upper half is live even where the lower half is dead
+    }
+}
+
+std::optional<u64> RegisterAllocator::GetConst(u32 guest) const
+{
+    if (guest == 0) {
+        return 0;
+    }
+    if (const_mask & 1u << guest) {
+        return const_values[guest];
     }
+    return {};
 }
 
 HostGpr64 RegisterAllocator::GetDirtyGpr(u32 guest)
 {
+    ClearConst(guest);
     return GetGpr(guest, guest != 0);
 }
 
 HostGpr128 RegisterAllocator::GetDirtyHi()
 {
-    return {};
+    return GetVpr(hi_index, true);
 }
 
 HostGpr128 RegisterAllocator::GetDirtyLo()
 {
-    return {};
+    return GetVpr(lo_index, true);
 }
 
-HostGpr128 RegisterAllocator::GetDirtyVpr(u32)
+HostGpr128 RegisterAllocator::GetDirtyVpr(u32 guest)
 {
-    return {};
+    ClearConst(guest);
+    return GetVpr(guest, guest != 0);
+}
+
+// Bindings that need not be written back are left as mere host registers, the same whatever they hold
+RegisterAllocator::ExitState RegisterAllocator::GetExitState() const
+{
+    ExitState state{ gpr_bindings, vpr_bindings, nonvolatile_regs_used };
+    auto normalize = [](auto& b) {
+        if (!b.dirty) {
+            b.guest.reset();
+        }
+        b.access_index = 0;
+    };
+    std::ranges::for_each(state.gpr_bindings, normalize);
+    std::ranges::for_each(state.vpr_bindings, normalize);
+    return state;
 }
 
 HostGpr64 RegisterAllocator::GetGpr(u32 guest)
@@ -164,73 +301,47 @@ HostGpr64 RegisterAllocator::GetGpr(u32 guest)
 
 HostGpr64 RegisterAllocator::GetGpr(u32 guest, bool make_dirty)
 {
-    Binding* binding = guest_to_host[guest];
-    if (binding) {
-        binding->access_index = host_access_index++;
-        binding->dirty |= make_dirty;
-        return binding->host;
-    }
-
-    bool found_free{};
-
-    if (next_free_binding_it != gpr_bindings.end()) {
-        binding = next_free_binding_it++;
-        found_free = true;
-    } else {
-        auto min_access_index = std::numeric_limits<decltype(host_access_index)>::max();
-        for (Binding& b : gpr_bindings) {
-            if (!b.Occupied()) {
-                found_free = true;
-                binding = &b;
-                break;
-            } else if (b.access_index < min_access_index) {
-                min_access_index = b.access_index;
-                binding = &b;
+    GprBinding* binding = guest_to_host[guest];
+    VprBinding* vpr_binding = guest128_to_host[guest];
+    if (!binding) {
+        binding = &AcquireBinding(gpr_bindings);
+        binding->guest = u8(guest);
+        binding->dirty = false;
+        guest_to_host[guest] = binding;
+        HostGpr64 const& host = binding->host;
+        if constexpr (platform.a64) {
+            if (guest == 0) {
+                c.mov(host, 0);
+            } else {
+                // TODO
             }
         }
-        assert(binding);
-        if (!found_free) {
-            Flush(*binding, false);
+        if constexpr (platform.x64) {
+            if (guest == 0) {
+                c.xor_(host.r32(), host.r32());
+            } else if (vpr_binding) {
+                c.vmovq(host, vpr_binding->host);
+            } else {
+                c.mov(host, qword_ptr(guest_gpr_base_ptr_reg, GetGprMidPtrOffset(guest)));
+            }
         }
     }
-
-    binding->guest = u8(guest);
     binding->access_index = host_access_index++;
-    binding->dirty = make_dirty;
-    guest_to_host[guest] = binding;
-
-    HostGpr64 const& host = binding->host;
-
-    if (!binding->is_volatile) {
-        if (!std::exchange(nonvolatile_gprs_used, true)) {
-            if constexpr (platform.a64) {
-                // TODO
+    if (make_dirty) {
+        binding->dirty = true;
+        if (vpr_binding) {
+            // The lower half is the GPR binding's from now on. Of the VPR binding, only the upper half may still need
+            // writing back, which takes a 64-bit store rather than a 128-bit one.
+            if (vpr_binding->dirty) {
+                if constexpr (platform.a64) {}
+                if constexpr (platform.x64) {
+                    c.vpextrq(qword_ptr(guest_gpr_base_ptr_reg, GetGprMidPtrOffset(guest) + 8), vpr_binding->host, 1);
+                }
             }
-            if constexpr (platform.x64) {
-                c.sub(x86::rsp, register_stack_space);
-            }
-        }
-        if (found_free) {
-            SaveHost(host);
-        }
-    }
-
-    if constexpr (platform.a64) {
-        if (guest == 0) {
-            c.mov(host, 0);
-        } else {
-            // TODO
-        }
-    }
-    if constexpr (platform.x64) {
-        if (guest == 0) {
-            c.xor_(host.r32(), host.r32());
-        } else {
-            c.mov(host, qword_ptr(guest_gpr_base_ptr_reg, GetGprMidPtrOffset(guest)));
+            ResetBinding(*vpr_binding);
         }
     }
-
-    return host;
+    return binding->host;
 }
 
 s32 RegisterAllocator::GetGprMidPtrOffset(u32 guest) const
@@ -241,57 +352,170 @@ s32 RegisterAllocator::GetGprMidPtrOffset(u32 guest) const
 
 HostGpr128 RegisterAllocator::GetHi()
 {
-    return {};
+    return GetVpr(hi_index, false);
 }
 
 HostGpr128 RegisterAllocator::GetLo()
 {
-    return {};
-}
-
-HostGpr128 RegisterAllocator::GetVpr(u32)
-{
-    return {};
+    return GetVpr(lo_index, false);
 }
 
 std::string RegisterAllocator::GetStatus() const
 {
     std::string used_str, free_str;
-    for (Binding const& b : gpr_bindings) {
+    auto append = [&](auto const& b) {
         auto host_reg_str{ HostRegToStr(b.host) };
         if (b.Occupied()) {
             u32 guest = b.guest.value();
-            std::string guest_reg_str =
-              b.host.isXmm() ? std::format("$v{}", guest) : std::string(mips::gpr_index_to_name(guest));
+            std::string guest_reg_str = [&] {
+                if (!b.host.isXmm()) return std::string(mips::gpr_index_to_name(guest));
+                if (guest == lo_index) return std::string("lo");
+                if (guest == hi_index) return std::string("hi");
+                return std::format("$v{}", guest);
+            }();
             used_str.append(std::format("{}({},{}),", host_reg_str, guest_reg_str, b.dirty ? 'd' : 'c'));
         } else {
             free_str.append(host_reg_str);
             free_str.push_back(',');
         }
-    }
+    };
+    std::ranges::for_each(gpr_bindings, append);
+    std::ranges::for_each(vpr_bindings, append);
     return std::format("Used: {}; Free: {}\n", used_str, free_str);
 }
 
-HostGpr128 RegisterAllocator::GetVpr(u32, bool)
+HostGpr128 RegisterAllocator::GetVpr(u32 guest)
 {
-    return {};
+    return GetVpr(guest, false);
+}
+
+HostGpr128 RegisterAllocator::GetVpr(u32 guest, bool make_dirty)
+{
+    VprBinding* binding = guest128_to_host[guest];
+    GprBinding* gpr_binding = guest < 32 ? guest_to_host[guest] : nullptr;
+    if (!binding) {
+        binding = &AcquireBinding(vpr_bindings);
+        binding->guest = u8(guest);
+        binding->dirty = false;
+        guest128_to_host[guest] = binding;
+        HostGpr128 const& host = binding->host;
+        s32 offset = GetVprMidPtrOffset(guest);
+        if constexpr (platform.a64) {
+            // TODO
+        }
+        if constexpr (platform.x64) {
+            if (guest == 0) {
+                c.vpxor(host, host, host);
+            } else if (gpr_binding && gpr_binding->dirty) {
+                // Without a dirty VPR binding, the upper half in memory is current; only the lower half is loaded
+                // from the GPR binding, rather than it being written back for a 128-bit load
+                c.vmovq(host, gpr_binding->host);
+                c.vpinsrq(host, host, qword_ptr(guest_gpr_base_ptr_reg, offset + 8), 1);
+            } else {
+                c.vmovdqu(host, xmmword_ptr(guest_gpr_base_ptr_reg, offset));
+            }
+        }
+    }
+    binding->access_index = host_access_index++;
+    if (make_dirty) {
+        binding->dirty = true;
+        if (gpr_binding) {
+            ResetBinding(*gpr_binding); // stale from now on; a dirty value it held is in the lower half of the VPR
+        }
+    }
+    return binding->host;
+}
+
+s32 RegisterAllocator::GetVprMidPtrOffset(u32 guest) const
+{
+    if (guest == lo_index) return s32(get_offset_to_guest_gpr_base_ptr(&lo));
+    if (guest == hi_index) return s32(get_offset_to_guest_gpr_base_ptr(&hi));
+    return GetGprMidPtrOffset(guest);
+}
+
+void RegisterAllocator::LoopBackEdge(asmjit::Label loop_head) const
+{
+    FlushAndRestoreAll(0);
+    if constexpr (platform.a64) {}
+    if constexpr (platform.x64) {
+        c.jb(loop_head);
+    }
+    ReleaseFrame(nonvolatile_regs_used);
+}
+
+void RegisterAllocator::LoopHead()
+{
+    ReserveFrame();
+}
+
+// Whether a binding holds a value that is not in memory, and may still be read
+bool RegisterAllocator::NeedsWriteBack(GprBinding const& b) const
+{
+    return b.dirty && live_gprs >> b.guest.value() & 1;
+}
+
+// The liveness of guest registers does not extend to their upper halves
+bool RegisterAllocator::NeedsWriteBack(VprBinding const& b) const
+{
+    return b.dirty;
+}
+
+void RegisterAllocator::ReleaseFrame(bool frame_reserved) const
+{
+    if constexpr (platform.a64) {}
+    if constexpr (platform.x64) {
+        if (frame_reserved) {
+            c.lea(x86::rsp, x86::ptr(x86::rsp, register_stack_space)); // lea rather than add; keeps the flags intact
+        }
+        if constexpr (!guest_gpr_base_ptr_is_pinned && !IsVolatile(guest_gpr_base_ptr_reg)) {
+            c.pop(guest_gpr_base_ptr_reg);
+        }
+    }
+}
+
+// Makes room for saving the non-volatile host registers, when the first of them is bound
+void RegisterAllocator::ReserveFrame()
+{
+    if (std::exchange(nonvolatile_regs_used, true)) {
+        return;
+    }
+    if constexpr (platform.a64) {
+        // TODO
+    }
+    if constexpr (platform.x64) {
+        c.sub(x86::rsp, register_stack_space);
+        if constexpr (register_stack_space % 16 != 0) {
+            stack_is_aligned_for_call = !stack_is_aligned_for_call;
+        }
+    }
 }
 
 void RegisterAllocator::Reset()
 {
-    for (Binding& b : gpr_bindings) {
+    for (GprBinding& b : gpr_bindings) {
+        b.access_index = 0;
+        b.dirty = false;
+        b.guest = {};
+        b.host_saved = false;
+    }
+    for (VprBinding& b : vpr_bindings) {
         b.access_index = 0;
         b.dirty = false;
         b.guest = {};
+        b.host_saved = false;
     }
     guest_to_host = {};
+    guest128_to_host = {};
+    const_mask = 0;
+    live_gprs = ~u64{};
+    next_reads.fill(0);
     host_access_index = 0;
-    next_free_binding_it = gpr_bindings.begin();
-    nonvolatile_gprs_used = false;
+    instruction_access_index = 0;
+    nonvolatile_regs_used = false;
     stack_is_aligned_for_call = false;
 }
 
-void RegisterAllocator::ResetBinding(Binding& b)
+void RegisterAllocator::ResetBinding(GprBinding& b)
 {
     if (b.Occupied()) {
         guest_to_host[b.guest.value()] = {};
@@ -300,6 +524,15 @@ void RegisterAllocator::ResetBinding(Binding& b)
     }
 }
 
+void RegisterAllocator::ResetBinding(VprBinding& b)
+{
+    if (b.Occupied()) {
+        guest128_to_host[b.guest.value()] = {};
+        b.guest = {};
+        b.dirty = false;
+    }
+}
+
 void RegisterAllocator::RestoreHost(HostGpr64 host) const
 {
     s32 stack_offset = get_nonvolatile_host_gpr_stack_offset(host);
@@ -311,6 +544,17 @@ void RegisterAllocator::RestoreHost(HostGpr64 host) const
     }
 }
 
+void RegisterAllocator::RestoreHost(HostGpr128 host) const
+{
+    s32 stack_offset = get_nonvolatile_host_vpr_stack_offset(host);
+    if constexpr (platform.a64) {
+        // TODO
+    }
+    if constexpr (platform.x64) {
+        c.vmovdqu(host, xmmword_ptr(x86::rsp, stack_offset));
+    }
+}
+
 void RegisterAllocator::SaveHost(HostGpr64 host) const
 {
     s32 stack_offset = get_nonvolatile_host_gpr_stack_offset(host);
@@ -322,6 +566,33 @@ void RegisterAllocator::SaveHost(HostGpr64 host) const
     }
 }
 
+void RegisterAllocator::SaveHost(HostGpr128 host) const
+{
+    s32 stack_offset = get_nonvolatile_host_vpr_stack_offset(host);
+    if constexpr (platform.a64) {
+        // TODO
+    }
+    if constexpr (platform.x64) {
+        c.vmovdqu(xmmword_ptr(x86::rsp, stack_offset), host);
+    }
+}
+
+void RegisterAllocator::SetConst(u32 guest, u64 value)
+{
+    if (guest == 0) {
+        return;
+    }
+    HostGpr64 host = GetDirtyGpr(guest);
+    if constexpr (platform.a64) {
+        // TODO
+    }
+    if constexpr (platform.x64) {
+        c.mov(host, value);
+    }
+    const_values[guest] = value;
+    const_mask |= 1u << guest;
+}
+
 bool RegisterAllocator::StackIsAlignedForCall() const
 {
     return stack_is_aligned_for_call;
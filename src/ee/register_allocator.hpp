@@ -1,5 +1,6 @@
 #pragma once
 
+#include "build_options.hpp"
 #include "jit_common.hpp"
 #include "numtypes.hpp"
 #include "platform.hpp"
@@ -56,14 +57,11 @@ inline constexpr std::array reg_alloc_volatile_vprs = [] {
             v31,
         };
     }
+    // xmm0-xmm3 are left out; they are scratch registers of the emitters
     if constexpr (platform.x64) {
         using namespace asmjit::x86;
         if constexpr (platform.abi.systemv) {
             return std::array{
-                xmm0,
-                xmm1,
-                xmm2,
-                xmm3,
                 xmm4,
                 xmm5,
                 xmm6,
@@ -79,7 +77,7 @@ inline constexpr std::array reg_alloc_volatile_vprs = [] {
             };
         }
         if constexpr (platform.abi.win64) {
-            return std::array{ xmm0, xmm1, xmm2, xmm3, xmm4, xmm5 };
+            return std::array{ xmm4, xmm5 };
         }
     }
 }();
@@ -121,61 +119,119 @@ inline constexpr HostGpr64 guest_gpr_base_ptr_reg = [] {
     if constexpr (platform.x64) return asmjit::x86::rbp;
 }();
 
+// With the assembly dispatcher, the guest base pointer is loaded once on entry to the dispatcher and stays live across
+// all blocks run from it, so blocks neither set it up nor preserve it.
+inline constexpr bool guest_gpr_base_ptr_is_pinned = platform.x64 && enable_ee_jit_asm_dispatcher;
+
 inline constexpr size_t reg_alloc_num_gprs = reg_alloc_volatile_gprs.size() + reg_alloc_nonvolatile_gprs.size();
 inline constexpr size_t reg_alloc_num_vprs = reg_alloc_volatile_vprs.size() + reg_alloc_nonvolatile_vprs.size();
 
 class RegisterAllocator {
 
-    struct Binding {
-        HostGpr64 host;
-        std::optional<u8> guest;
-        u16 access_index;
-        bool dirty;
-        bool is_volatile;
+    template<typename Host> struct Binding {
+        Host host{};
+        std::optional<u8> guest{};
+        u16 access_index{};
+        bool dirty{};
+        bool is_volatile{};
+        bool host_saved{}; // for a non-volatile host register, whether its value is saved in the frame of the block
         bool Occupied() const
         {
             return guest.has_value();
         }
+        bool operator==(Binding const&) const = default;
     };
-
-    std::array<Binding, reg_alloc_num_gprs> gpr_bindings;
-    std::array<Binding, reg_alloc_num_vprs> vpr_bindings;
-    std::array<Binding*, 32> guest_to_host;
-    std::array<Binding*, 32> guest128_to_host;
-    typename decltype(gpr_bindings)::iterator next_free_binding_it{ gpr_bindings.begin() };
+    using GprBinding = Binding<HostGpr64>;
+    using VprBinding = Binding<HostGpr128>;
+
+    // A guest register may be bound both as a GPR, for its lower 64 bits, and as a VPR, for all 128. The two then hold
+    // the same lower half, and at most one of them is dirty. Only VPR bindings change the upper half, which is thus
+    // known to be unchanged in memory for any guest register without a dirty VPR binding.
+    std::array<GprBinding, reg_alloc_num_gprs> gpr_bindings;
+    std::array<VprBinding, reg_alloc_num_vprs> vpr_bindings;
+    std::array<GprBinding*, 32> guest_to_host;
+    std::array<VprBinding*, 34> guest128_to_host; // the GPRs, then LO and HI
+    std::array<u64, 32> const_values; // of the guest registers in const_mask
+    u32 const_mask{}; // guest registers whose value is known at compile time
+    u64 live_gprs{}; // guest registers whose value may be read from the current instruction on
+    std::array<u8, 32> next_reads{}; // per guest register, how many instructions ahead it is next read
     JitCompiler& c;
     u16 host_access_index{};
-    bool nonvolatile_gprs_used{};
+    u16 instruction_access_index{}; // host_access_index at the start of the current instruction
+    bool nonvolatile_regs_used{};
     bool stack_is_aligned_for_call{};
 
-    void Flush(Binding const& b, bool restore) const;
+    template<typename B, size_t N> B& AcquireBinding(std::array<B, N>& bindings);
+    template<typename B, size_t N> B& ChooseVictim(std::array<B, N>& bindings);
+    void Flush(GprBinding const& b, bool restore) const;
+    void Flush(VprBinding const& b, bool restore) const;
     void FlushAndDestroyAllVolatile();
-    void FlushAndDestroyBinding(Binding& b, bool restore);
-    void FlushAndRestoreAll() const;
+    void FlushAndDestroyBinding(auto& b, bool restore);
+    void FlushAndRestoreAll(u32 dead_gprs) const;
     s32 GetGprMidPtrOffset(u32 guest) const;
     HostGpr64 GetGpr(u32 guest, bool make_dirty);
-    HostGpr128 GetVpr(u32, bool);
+    HostGpr128 GetVpr(u32 guest, bool make_dirty);
+    s32 GetVprMidPtrOffset(u32 guest) const;
+    bool NeedsWriteBack(GprBinding const& b) const;
+    bool NeedsWriteBack(VprBinding const& b) const;
+    void ReleaseFrame(bool frame_reserved) const;
+    void ReserveFrame();
     void Reset();
-    void ResetBinding(Binding& b);
+    void ResetBinding(GprBinding& b);
+    void ResetBinding(VprBinding& b);
     void RestoreHost(HostGpr64 host) const;
+    void RestoreHost(HostGpr128 host) const;
     void SaveHost(HostGpr64 host) const;
+    void SaveHost(HostGpr128 host) const;
 
 public:
+    // What an exit emitted mid-block writes back and restores on its way out, which is all its code depends on. Exits
+    // taken from points of the block with equal states can share their code; see GetExitState.
+    struct ExitState {
+        std::array<GprBinding, reg_alloc_num_gprs> gpr_bindings;
+        std::array<VprBinding, reg_alloc_num_vprs> vpr_bindings;
+        bool nonvolatile_regs_used;
+        bool operator==(ExitState const&) const = default;
+    };
+
     RegisterAllocator(JitCompiler& compiler);
 
+    // Passes the liveness of the guest registers at the instruction about to be emitted, which decides the registers
+    // to evict, and whether they need to be written back
+    void BeginInstruction(u64 live, std::array<u8, 32> const& next);
     void BlockEpilog();
     void BlockEpilogWithJmp(void (*func)());
+    // dead_gprs: guest registers that the code run next overwrites before reading, and that need not be written back
+    void BlockEpilogWithoutRet(u32 dead_gprs = 0) const;
+    // As above, for a state taken by GetExitState, possibly at another point of the block
+    void BlockEpilogWithoutRet(ExitState const& state) const;
     void BlockProlog();
+    // For emitters that write a guest register other than through GetDirtyGpr
+    void ClearConst(u32 guest);
+    // Writes back and releases every binding, for code that accesses the guest registers in memory, or makes calls
     void FlushAll();
+    // The value of a guest register, if it is known at compile time: set by SetConst since the start of the block, and
+    // not written since
+    std::optional<u64> GetConst(u32 guest) const;
     HostGpr64 GetDirtyGpr(u32 guest);
     HostGpr128 GetDirtyHi();
     HostGpr128 GetDirtyLo();
     HostGpr128 GetDirtyVpr(u32 guest);
+    ExitState GetExitState() const;
     HostGpr64 GetGpr(u32 guest);
     HostGpr128 GetHi();
     HostGpr128 GetLo();
     std::string GetStatus() const;
     HostGpr128 GetVpr(u32 guest);
+    // Ends an iteration of a loop back to the start of the block, on a run-time code path, once the caller has
+    // compared the cycle counter with the budget: writes back the bindings, and jumps to loop_head if below the
+    // budget. Otherwise, the frame is torn down, for the caller to return.
+    void LoopBackEdge(asmjit::Label loop_head) const;
+    // Emitted right before loop_head, where no guest register is bound. The frame is reserved up front, so that the
+    // stack is the same on every iteration.
+    void LoopHead();
+    // Writes a value known at compile time to a guest register, and remembers it for GetConst
+    void SetConst(u32 guest, u64 value);
     bool StackIsAlignedForCall() const;
 };
 
@@ -1,21 +1,108 @@
+#include "ee/cop1.hpp"
+#include "ee/jit.hpp"
+#include "ee/jit_profiler.hpp"
+#include "ee/mmi.hpp"
 #include "emulator.hpp"
+#include "jit_perf.hpp"
 #include "log.hpp"
 
+#include <charconv>
 #include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+static std::filesystem::path block_profile_path;
+static size_t block_profile_top_n = 100;
+
+static void dump_block_profile()
+{
+    Status status = ee::DumpBlockProfiles(block_profile_path, block_profile_top_n);
+    if (!status.Ok()) {
+        log_error("{}", status.Message());
+    }
+}
 
 int main(int argc, char* argv[])
 {
     // CLI arguments (mandatory for now):
     //   1: game path
     //   2: bios path
+    // Options:
+    //   --profile-blocks <file>: profile EE JIT blocks, and write the hottest ones to <file> on exit
+    //   --profile-blocks-top <n>: number of blocks to write (default 100)
+    //   --profile-blocks-host-time: also measure the host time spent in each block
+    //   --perf-map: write /tmp/perf-<pid>.map, naming JIT code for perf
+    //   --perf-jitdump: write /tmp/jit-<pid>.dump, for 'perf inject --jit'
+    //   --jit-compile-threshold <n>: interpret EE blocks <n> times before compiling them (0: always compile)
+    //   --jit-mmi-tier <avx|avx2|avx512>: compile MMI instructions for the given instruction sets, whatever the host's
+    //   --jit-fpu-clamp <none|results|full>: where compiled FPU instructions clamp floats to PS2 ones (default results)
+
+    std::vector<char const*> args;
+    bool profile_blocks = false, profile_blocks_host_time = false, perf_map = false, perf_jitdump = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--profile-blocks" && i + 1 < argc) {
+            profile_blocks = true;
+            block_profile_path = argv[++i];
+        } else if (arg == "--profile-blocks-top" && i + 1 < argc) {
+            std::string_view value = argv[++i];
+            if (std::from_chars(value.data(), value.data() + value.size(), block_profile_top_n).ec != std::errc{}) {
+                log_fatal("Invalid block count '{}' for --profile-blocks-top", value);
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--profile-blocks-host-time") {
+            profile_blocks_host_time = true;
+        } else if (arg == "--jit-compile-threshold" && i + 1 < argc) {
+            std::string_view value = argv[++i];
+            u32 threshold;
+            if (std::from_chars(value.data(), value.data() + value.size(), threshold).ec != std::errc{}) {
+                log_fatal("Invalid threshold '{}' for --jit-compile-threshold", value);
+                return EXIT_FAILURE;
+            }
+            ee::SetCompileThreshold(threshold);
+        } else if (arg == "--jit-mmi-tier" && i + 1 < argc) {
+            std::string_view value = argv[++i];
+            std::optional<ee::MmiTier> tier = ee::ParseMmiTier(value);
+            if (!tier) {
+                log_fatal("Invalid tier '{}' for --jit-mmi-tier", value);
+                return EXIT_FAILURE;
+            }
+            ee::ForceMmiTier(tier);
+        } else if (arg == "--jit-fpu-clamp" && i + 1 < argc) {
+            std::string_view value = argv[++i];
+            std::optional<ee::FpuClampMode> mode = ee::ParseFpuClampMode(value);
+            if (!mode) {
+                log_fatal("Invalid mode '{}' for --jit-fpu-clamp", value);
+                return EXIT_FAILURE;
+            }
+            ee::SetFpuClampMode(*mode);
+        } else if (arg == "--perf-map") {
+            perf_map = true;
+        } else if (arg == "--perf-jitdump") {
+            perf_jitdump = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (perf_map || perf_jitdump) {
+        Status status = jit_perf::open(perf_map, perf_jitdump);
+        if (!status.Ok()) {
+            log_fatal("{}", status.Message());
+            return EXIT_FAILURE;
+        }
+        std::atexit(jit_perf::close);
+    }
 
     if (!emulator::init()) {
         log_fatal("Failed to init emulator!");
         return EXIT_FAILURE;
     }
 
-    if (argc > 1) {
-        char const* game_path = argv[1];
+    if (args.size() > 0) {
+        char const* game_path = args[0];
         if (!emulator::load_game(game_path)) {
             log_fatal("Failed to load game at path {}", game_path);
             return EXIT_FAILURE;
@@ -24,8 +111,8 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
-    if (argc > 2) {
-        char const* bios_path = argv[2];
+    if (args.size() > 1) {
+        char const* bios_path = args[1];
         if (!emulator::load_bios(bios_path)) {
             log_fatal("Failed to load bios at path {}", bios_path);
             return EXIT_FAILURE;
@@ -34,5 +121,10 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (profile_blocks) {
+        ee::EnableBlockProfiling(profile_blocks_host_time);
+        std::atexit(dump_block_profile);
+    }
+
     emulator::run();
 }
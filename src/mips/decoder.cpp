@@ -4,6 +4,7 @@
 #include "ee/cop2.hpp"
 #include "ee/cpu.hpp"
 #include "ee/exceptions.hpp"
+#include "ee/interpreter.hpp"
 #include "ee/mmi.hpp"
 #include "ee/vu.hpp"
 #include "iop/cop0.hpp"
@@ -27,6 +28,7 @@ namespace mips {
 
 enum class Cpu {
     EE,
+    EEInterpreter,
     IOP,
 };
 
@@ -42,28 +44,39 @@ template<Cpu cpu, bool make_string> static void special(u32 instr);
 
 static std::string decode_result;
 
-#define INSTR(instr_name, ...)                                     \
-    {                                                              \
-        if constexpr (cpu == Cpu::EE) ee::instr_name(__VA_ARGS__); \
-        else iop::instr_name(__VA_ARGS__);                         \
+#define INSTR(instr_name, ...)                                                                  \
+    {                                                                                           \
+        if constexpr (cpu == Cpu::EE) ee::instr_name(__VA_ARGS__);                              \
+        else if constexpr (cpu == Cpu::EEInterpreter) ee::interpreter::instr_name(__VA_ARGS__); \
+        else iop::instr_name(__VA_ARGS__);                                                      \
     } // namespace mips
 
-#define INSTR_EE(instr_name, ...)                                      \
-    {                                                                  \
-        if constexpr (cpu == Cpu::EE) ee::instr_name(__VA_ARGS__);     \
-        else reserved_instruction<Cpu::IOP, make_string>(#instr_name); \
+#define INSTR_EE(instr_name, ...)                                                               \
+    {                                                                                           \
+        if constexpr (cpu == Cpu::EE) ee::instr_name(__VA_ARGS__);                              \
+        else if constexpr (cpu == Cpu::EEInterpreter) ee::interpreter::instr_name(__VA_ARGS__); \
+        else reserved_instruction<Cpu::IOP, make_string>(#instr_name);                          \
     } // namespace mips
 
-#define INSTR_IOP(instr_name, ...)                                                             \
+// EE instructions that only the JIT implements; the interpreter hands blocks containing them over to the JIT
+#define INSTR_EE_JIT_ONLY(instr_name, ...)                                                     \
     {                                                                                          \
-        if constexpr (cpu == Cpu::EE) reserved_instruction<Cpu::EE, make_string>(#instr_name); \
-        else iop::instr_name(__VA_ARGS__);                                                     \
+        if constexpr (cpu == Cpu::EE) ee::instr_name(__VA_ARGS__);                             \
+        else if constexpr (cpu == Cpu::EEInterpreter) ee::interpreter::jit_only_instruction(); \
+        else reserved_instruction<Cpu::IOP, make_string>(#instr_name);                         \
     } // namespace mips
 
-#define INSTR_VU(instr_name)                                           \
-    {                                                                  \
-        if constexpr (cpu == Cpu::EE) ee::vu::instr_name(instr);       \
-        else reserved_instruction<Cpu::IOP, make_string>(#instr_name); \
+#define INSTR_IOP(instr_name, ...)                                   \
+    {                                                                \
+        if constexpr (cpu == Cpu::IOP) iop::instr_name(__VA_ARGS__); \
+        else reserved_instruction<cpu, make_string>(#instr_name);    \
+    } // namespace mips
+
+#define INSTR_VU(instr_name)                                                                   \
+    {                                                                                          \
+        if constexpr (cpu == Cpu::EE) ee::vu::instr_name(instr);                               \
+        else if constexpr (cpu == Cpu::EEInterpreter) ee::interpreter::jit_only_instruction(); \
+        else reserved_instruction<Cpu::IOP, make_string>(#instr_name);                         \
     } // namespace mips
 
 template<Cpu cpu, bool make_string> void cop0(u32 instr)
@@ -74,10 +87,10 @@ template<Cpu cpu, bool make_string> void cop0(u32 instr)
 
     case 8: { // BC0
         switch (instr >> 16 & 31) {
-        case 0:  INSTR_EE(bc0f, IMM16); break;
-        case 1:  INSTR_EE(bc0t, IMM16); break;
-        case 2:  INSTR_EE(bc0fl, IMM16); break;
-        case 3:  INSTR_EE(bc0tl, IMM16); break;
+        case 0:  INSTR_EE_JIT_ONLY(bc0f, IMM16); break;
+        case 1:  INSTR_EE_JIT_ONLY(bc0t, IMM16); break;
+        case 2:  INSTR_EE_JIT_ONLY(bc0fl, IMM16); break;
+        case 3:  INSTR_EE_JIT_ONLY(bc0tl, IMM16); break;
         default: reserved_instruction<cpu, make_string>(instr);
         }
     } break;
@@ -104,56 +117,55 @@ template<Cpu cpu, bool make_string> void cop1(u32 instr)
 {
     if constexpr (cpu == Cpu::IOP) {
         reserved_instruction<Cpu::IOP, make_string>(instr);
-    }
-    if constexpr (cpu == Cpu::EE) {
+    } else {
         switch (instr >> 21 & 31) {
-        case 0x00: INSTR_EE(mfc1, FS, RT); break;
-        case 0x02: INSTR_EE(cfc1, FS, RT); break;
-        case 0x04: INSTR_EE(mtc1, FS, RT); break;
-        case 0x06: INSTR_EE(ctc1, FS, RT); break;
+        case 0x00: INSTR_EE_JIT_ONLY(mfc1, FS, RT); break;
+        case 0x02: INSTR_EE_JIT_ONLY(cfc1, FS, RT); break;
+        case 0x04: INSTR_EE_JIT_ONLY(mtc1, FS, RT); break;
+        case 0x06: INSTR_EE_JIT_ONLY(ctc1, FS, RT); break;
 
         case 0x08: { // BC1
             switch (instr >> 16 & 31) {
-            case 0:  INSTR_EE(bc1f, IMM16); break;
-            case 1:  INSTR_EE(bc1t, IMM16); break;
-            case 2:  INSTR_EE(bc1fl, IMM16); break;
-            case 3:  INSTR_EE(bc1tl, IMM16); break;
+            case 0:  INSTR_EE_JIT_ONLY(bc1f, IMM16); break;
+            case 1:  INSTR_EE_JIT_ONLY(bc1t, IMM16); break;
+            case 2:  INSTR_EE_JIT_ONLY(bc1fl, IMM16); break;
+            case 3:  INSTR_EE_JIT_ONLY(bc1tl, IMM16); break;
             default: reserved_instruction<cpu, make_string>(instr);
             }
         } break;
 
         case 0x10: { // FPU.S
             switch (instr & 63) {
-            case 0x00: INSTR_EE(add_s, FD, FS, FT); break;
-            case 0x01: INSTR_EE(sub_s, FD, FS, FT); break;
-            case 0x02: INSTR_EE(mul_s, FD, FS, FT); break;
-            case 0x03: INSTR_EE(div_s, FD, FS, FT); break;
-            case 0x04: INSTR_EE(sqrt_s, FD, FS); break;
-            case 0x05: INSTR_EE(abs_s, FD, FS); break;
-            case 0x06: INSTR_EE(mov_s, FD, FS); break;
-            case 0x07: INSTR_EE(neg_s, FD, FS); break;
-            case 0x16: INSTR_EE(rsqrt_s, FD, FS); break;
-            case 0x18: INSTR_EE(adda_s, FS, FT); break;
-            case 0x19: INSTR_EE(suba_s, FS, FT); break;
-            case 0x1A: INSTR_EE(mula_s, FS, FT); break;
-            case 0x1C: INSTR_EE(madd_s, FD, FS, FT); break;
-            case 0x1D: INSTR_EE(msub_s, FD, FS, FT); break;
-            case 0x1E: INSTR_EE(madda_s, FS, FT); break;
-            case 0x1F: INSTR_EE(msuba_s, FS, FT); break;
-            case 0x24: INSTR_EE(cvt_w, FD, FS); break;
-            case 0x28: INSTR_EE(max_s, FD, FS, FT); break;
-            case 0x29: INSTR_EE(min_s, FD, FS, FT); break;
-            case 0x30: INSTR_EE(c_f, FS, FT); break;
-            case 0x32: INSTR_EE(c_eq, FS, FT); break;
-            case 0x34: INSTR_EE(c_lt, FS, FT); break;
-            case 0x36: INSTR_EE(c_le, FS, FT); break;
+            case 0x00: INSTR_EE_JIT_ONLY(add_s, FD, FS, FT); break;
+            case 0x01: INSTR_EE_JIT_ONLY(sub_s, FD, FS, FT); break;
+            case 0x02: INSTR_EE_JIT_ONLY(mul_s, FD, FS, FT); break;
+            case 0x03: INSTR_EE_JIT_ONLY(div_s, FD, FS, FT); break;
+            case 0x04: INSTR_EE_JIT_ONLY(sqrt_s, FD, FT); break;
+            case 0x05: INSTR_EE_JIT_ONLY(abs_s, FD, FS); break;
+            case 0x06: INSTR_EE_JIT_ONLY(mov_s, FD, FS); break;
+            case 0x07: INSTR_EE_JIT_ONLY(neg_s, FD, FS); break;
+            case 0x16: INSTR_EE_JIT_ONLY(rsqrt_s, FD, FS, FT); break;
+            case 0x18: INSTR_EE_JIT_ONLY(adda_s, FS, FT); break;
+            case 0x19: INSTR_EE_JIT_ONLY(suba_s, FS, FT); break;
+            case 0x1A: INSTR_EE_JIT_ONLY(mula_s, FS, FT); break;
+            case 0x1C: INSTR_EE_JIT_ONLY(madd_s, FD, FS, FT); break;
+            case 0x1D: INSTR_EE_JIT_ONLY(msub_s, FD, FS, FT); break;
+            case 0x1E: INSTR_EE_JIT_ONLY(madda_s, FS, FT); break;
+            case 0x1F: INSTR_EE_JIT_ONLY(msuba_s, FS, FT); break;
+            case 0x24: INSTR_EE_JIT_ONLY(cvt_w, FD, FS); break;
+            case 0x28: INSTR_EE_JIT_ONLY(max_s, FD, FS, FT); break;
+            case 0x29: INSTR_EE_JIT_ONLY(min_s, FD, FS, FT); break;
+            case 0x30: INSTR_EE_JIT_ONLY(c_f, FS, FT); break;
+            case 0x32: INSTR_EE_JIT_ONLY(c_eq, FS, FT); break;
+            case 0x34: INSTR_EE_JIT_ONLY(c_lt, FS, FT); break;
+            case 0x36: INSTR_EE_JIT_ONLY(c_le, FS, FT); break;
             default:   reserved_instruction<cpu, make_string>(instr);
             }
         } break;
 
         case 0x14: { // FPU.W
             if ((instr & 63) == 32) {
-                INSTR_EE(cvt_s, FD, FS);
+                INSTR_EE_JIT_ONLY(cvt_s, FD, FS);
             } else {
                 reserved_instruction<cpu, make_string>(instr);
             }
@@ -166,7 +178,7 @@ template<Cpu cpu, bool make_string> void cop1(u32 instr)
 
 template<Cpu cpu, bool make_string> void cop2(u32 instr)
 {
-    if constexpr (cpu == Cpu::EE) {
+    if constexpr (cpu != Cpu::IOP) {
         u32 fmt = instr >> 21 & 31;
         if (fmt >= 16) { // Special1
             switch (instr & 63) {
@@ -268,16 +280,16 @@ template<Cpu cpu, bool make_string> void cop2(u32 instr)
             }
         } else {
             switch (fmt) {
-            case 1: INSTR_EE(qmfc2); break;
-            case 2: INSTR_EE(cfc2); break;
-            case 5: INSTR_EE(qmtc2); break;
-            case 6: INSTR_EE(ctc2); break;
+            case 1: INSTR_EE_JIT_ONLY(qmfc2); break;
+            case 2: INSTR_EE_JIT_ONLY(cfc2); break;
+            case 5: INSTR_EE_JIT_ONLY(qmtc2); break;
+            case 6: INSTR_EE_JIT_ONLY(ctc2); break;
             case 8: { // BC2
                 switch (instr >> 16 & 31) {
-                case 0:  INSTR_EE(bc2f); break;
-                case 1:  INSTR_EE(bc2t); break;
-                case 2:  INSTR_EE(bc2fl); break;
-                case 3:  INSTR_EE(bc2tl); break;
+                case 0:  INSTR_EE_JIT_ONLY(bc2f); break;
+                case 1:  INSTR_EE_JIT_ONLY(bc2t); break;
+                case 2:  INSTR_EE_JIT_ONLY(bc2fl); break;
+                case 3:  INSTR_EE_JIT_ONLY(bc2tl); break;
                 default: reserved_instruction<cpu, make_string>(instr);
                 }
             } break;
@@ -368,12 +380,12 @@ template<Cpu cpu, bool make_string> void decode(u32 instr)
     case 0x2D: INSTR_EE(sdr, RS, RT, IMM16); break;
     case 0x2E: INSTR(swr, RS, RT, IMM16); break;
     case 0x2F: INSTR_EE(cache); break;
-    case 0x31: INSTR_EE(lwc1, FT, BASE, IMM16); break;
+    case 0x31: INSTR_EE_JIT_ONLY(lwc1, FT, BASE, IMM16); break;
     case 0x33: INSTR_EE(pref); break;
-    case 0x36: INSTR_EE(lqc2); break;
+    case 0x36: INSTR_EE_JIT_ONLY(lqc2); break;
     case 0x37: INSTR_EE(ld, RS, RT, IMM16); break;
-    case 0x39: INSTR_EE(swc1, FT, BASE, IMM16); break;
-    case 0x3E: INSTR_EE(sqc2); break;
+    case 0x39: INSTR_EE_JIT_ONLY(swc1, FT, BASE, IMM16); break;
+    case 0x3E: INSTR_EE_JIT_ONLY(sqc2); break;
     case 0x3F: INSTR_EE(sd, RS, RT, IMM16); break;
     default:   reserved_instruction<cpu, make_string>(instr);
     }
@@ -384,6 +396,11 @@ void decode_ee(u32 instr)
     decode<Cpu::EE, false>(instr);
 }
 
+void decode_ee_interpreter(u32 instr)
+{
+    decode<Cpu::EEInterpreter, false>(instr);
+}
+
 void decode_iop(u32 instr)
 {
     decode<Cpu::IOP, false>(instr);
@@ -403,132 +420,132 @@ template<Cpu cpu, bool make_string> void mmi(u32 instr)
     } else {
         auto mmi0 = [](u32 instr) {
             switch (instr >> 6 & 31) {
-            case 0x00: INSTR_EE(paddw, RS, RT, RD); break;
-            case 0x01: INSTR_EE(psubw, RS, RT, RD); break;
-            case 0x02: INSTR_EE(pcgtw, RS, RT, RD); break;
-            case 0x03: INSTR_EE(pmaxw, RS, RT, RD); break;
-            case 0x04: INSTR_EE(paddh, RS, RT, RD); break;
-            case 0x05: INSTR_EE(psubh, RS, RT, RD); break;
-            case 0x06: INSTR_EE(pcgth, RS, RT, RD); break;
-            case 0x07: INSTR_EE(pmaxh, RS, RT, RD); break;
-            case 0x08: INSTR_EE(paddb, RS, RT, RD); break;
-            case 0x09: INSTR_EE(psubb, RS, RT, RD); break;
-            case 0x0A: INSTR_EE(pcgtb, RS, RT, RD); break;
-            case 0x10: INSTR_EE(paddsw, RS, RT, RD); break;
-            case 0x11: INSTR_EE(psubsw, RS, RT, RD); break;
-            case 0x12: INSTR_EE(pextlw, RS, RT, RD); break;
-            case 0x13: INSTR_EE(ppacw, RS, RT, RD); break;
-            case 0x14: INSTR_EE(paddsh, RS, RT, RD); break;
-            case 0x15: INSTR_EE(psubsh, RS, RT, RD); break;
-            case 0x16: INSTR_EE(pextlh, RS, RT, RD); break;
-            case 0x17: INSTR_EE(ppach, RS, RT, RD); break;
-            case 0x18: INSTR_EE(paddsb, RS, RT, RD); break;
-            case 0x19: INSTR_EE(psubsb, RS, RT, RD); break;
-            case 0x1A: INSTR_EE(pextlb, RS, RT, RD); break;
-            case 0x1B: INSTR_EE(ppacb, RS, RT, RD); break;
-            case 0x1E: INSTR_EE(pext5, RT, RD); break;
-            case 0x1F: INSTR_EE(ppac5, RT, RD); break;
+            case 0x00: INSTR_EE_JIT_ONLY(paddw, RS, RT, RD); break;
+            case 0x01: INSTR_EE_JIT_ONLY(psubw, RS, RT, RD); break;
+            case 0x02: INSTR_EE_JIT_ONLY(pcgtw, RS, RT, RD); break;
+            case 0x03: INSTR_EE_JIT_ONLY(pmaxw, RS, RT, RD); break;
+            case 0x04: INSTR_EE_JIT_ONLY(paddh, RS, RT, RD); break;
+            case 0x05: INSTR_EE_JIT_ONLY(psubh, RS, RT, RD); break;
+            case 0x06: INSTR_EE_JIT_ONLY(pcgth, RS, RT, RD); break;
+            case 0x07: INSTR_EE_JIT_ONLY(pmaxh, RS, RT, RD); break;
+            case 0x08: INSTR_EE_JIT_ONLY(paddb, RS, RT, RD); break;
+            case 0x09: INSTR_EE_JIT_ONLY(psubb, RS, RT, RD); break;
+            case 0x0A: INSTR_EE_JIT_ONLY(pcgtb, RS, RT, RD); break;
+            case 0x10: INSTR_EE_JIT_ONLY(paddsw, RS, RT, RD); break;
+            case 0x11: INSTR_EE_JIT_ONLY(psubsw, RS, RT, RD); break;
+            case 0x12: INSTR_EE_JIT_ONLY(pextlw, RS, RT, RD); break;
+            case 0x13: INSTR_EE_JIT_ONLY(ppacw, RS, RT, RD); break;
+            case 0x14: INSTR_EE_JIT_ONLY(paddsh, RS, RT, RD); break;
+            case 0x15: INSTR_EE_JIT_ONLY(psubsh, RS, RT, RD); break;
+            case 0x16: INSTR_EE_JIT_ONLY(pextlh, RS, RT, RD); break;
+            case 0x17: INSTR_EE_JIT_ONLY(ppach, RS, RT, RD); break;
+            case 0x18: INSTR_EE_JIT_ONLY(paddsb, RS, RT, RD); break;
+            case 0x19: INSTR_EE_JIT_ONLY(psubsb, RS, RT, RD); break;
+            case 0x1A: INSTR_EE_JIT_ONLY(pextlb, RS, RT, RD); break;
+            case 0x1B: INSTR_EE_JIT_ONLY(ppacb, RS, RT, RD); break;
+            case 0x1E: INSTR_EE_JIT_ONLY(pext5, RT, RD); break;
+            case 0x1F: INSTR_EE_JIT_ONLY(ppac5, RT, RD); break;
             default:   reserved_instruction<cpu, make_string>(instr);
             }
         };
 
         auto mmi1 = [](u32 instr) {
             switch (instr >> 6 & 31) {
-            case 0x01: INSTR_EE(pabsw, RT, RD); break;
-            case 0x02: INSTR_EE(pceqw, RS, RT, RD); break;
-            case 0x03: INSTR_EE(pminw, RS, RT, RD); break;
-            case 0x04: INSTR_EE(padsbh, RS, RT, RD); break;
-            case 0x05: INSTR_EE(pabsh, RT, RD); break;
-            case 0x06: INSTR_EE(pceqh, RS, RT, RD); break;
-            case 0x07: INSTR_EE(pminh, RS, RT, RD); break;
-            case 0x0A: INSTR_EE(pceqb, RS, RT, RD); break;
-            case 0x10: INSTR_EE(padduw, RS, RT, RD); break;
-            case 0x11: INSTR_EE(psubuw, RS, RT, RD); break;
-            case 0x12: INSTR_EE(pextuw, RS, RT, RD); break;
-            case 0x14: INSTR_EE(padduh, RS, RT, RD); break;
-            case 0x15: INSTR_EE(psubuh, RS, RT, RD); break;
-            case 0x16: INSTR_EE(pextuh, RS, RT, RD); break;
-            case 0x18: INSTR_EE(paddub, RS, RT, RD); break;
-            case 0x19: INSTR_EE(psubub, RS, RT, RD); break;
-            case 0x1A: INSTR_EE(pextub, RS, RT, RD); break;
-            case 0x1B: INSTR_EE(qfsrv, RS, RT, RD); break;
+            case 0x01: INSTR_EE_JIT_ONLY(pabsw, RT, RD); break;
+            case 0x02: INSTR_EE_JIT_ONLY(pceqw, RS, RT, RD); break;
+            case 0x03: INSTR_EE_JIT_ONLY(pminw, RS, RT, RD); break;
+            case 0x04: INSTR_EE_JIT_ONLY(padsbh, RS, RT, RD); break;
+            case 0x05: INSTR_EE_JIT_ONLY(pabsh, RT, RD); break;
+            case 0x06: INSTR_EE_JIT_ONLY(pceqh, RS, RT, RD); break;
+            case 0x07: INSTR_EE_JIT_ONLY(pminh, RS, RT, RD); break;
+            case 0x0A: INSTR_EE_JIT_ONLY(pceqb, RS, RT, RD); break;
+            case 0x10: INSTR_EE_JIT_ONLY(padduw, RS, RT, RD); break;
+            case 0x11: INSTR_EE_JIT_ONLY(psubuw, RS, RT, RD); break;
+            case 0x12: INSTR_EE_JIT_ONLY(pextuw, RS, RT, RD); break;
+            case 0x14: INSTR_EE_JIT_ONLY(padduh, RS, RT, RD); break;
+            case 0x15: INSTR_EE_JIT_ONLY(psubuh, RS, RT, RD); break;
+            case 0x16: INSTR_EE_JIT_ONLY(pextuh, RS, RT, RD); break;
+            case 0x18: INSTR_EE_JIT_ONLY(paddub, RS, RT, RD); break;
+            case 0x19: INSTR_EE_JIT_ONLY(psubub, RS, RT, RD); break;
+            case 0x1A: INSTR_EE_JIT_ONLY(pextub, RS, RT, RD); break;
+            case 0x1B: INSTR_EE_JIT_ONLY(qfsrv, RS, RT, RD); break;
             default:   reserved_instruction<cpu, make_string>(instr);
             }
         };
 
         auto mmi2 = [](u32 instr) {
             switch (instr >> 6 & 31) {
-            case 0x00: INSTR_EE(pmaddw, RS, RT, RD); break;
-            case 0x02: INSTR_EE(psllvw, RS, RT, RD); break;
-            case 0x03: INSTR_EE(psrlvw, RS, RT, RD); break;
-            case 0x04: INSTR_EE(pmsubw, RS, RT, RD); break;
-            case 0x08: INSTR_EE(pmfhi, RD); break;
-            case 0x09: INSTR_EE(pmflo, RD); break;
-            case 0x0A: INSTR_EE(pinth, RS, RT, RD); break;
-            case 0x0C: INSTR_EE(pmultw, RS, RT, RD); break;
-            case 0x0D: INSTR_EE(pdivw, RS, RT); break;
-            case 0x0E: INSTR_EE(pcpyld, RS, RT, RD); break;
-            case 0x10: INSTR_EE(pmaddh, RS, RT, RD); break;
-            case 0x11: INSTR_EE(phmadh, RS, RT, RD); break;
-            case 0x12: INSTR_EE(pand, RS, RT, RD); break;
-            case 0x13: INSTR_EE(pxor, RS, RT, RD); break;
-            case 0x14: INSTR_EE(pmsubh, RS, RT, RD); break;
-            case 0x15: INSTR_EE(phmsbh, RS, RT, RD); break;
-            case 0x1A: INSTR_EE(pexeh, RT, RD); break;
-            case 0x1B: INSTR_EE(prevh, RT, RD); break;
-            case 0x1C: INSTR_EE(pmulth, RS, RT, RD); break;
-            case 0x1D: INSTR_EE(pdivbw, RS, RT); break;
-            case 0x1E: INSTR_EE(pexew, RT, RD); break;
-            case 0x1F: INSTR_EE(prot3w, RT, RD); break;
+            case 0x00: INSTR_EE_JIT_ONLY(pmaddw, RS, RT, RD); break;
+            case 0x02: INSTR_EE_JIT_ONLY(psllvw, RS, RT, RD); break;
+            case 0x03: INSTR_EE_JIT_ONLY(psrlvw, RS, RT, RD); break;
+            case 0x04: INSTR_EE_JIT_ONLY(pmsubw, RS, RT, RD); break;
+            case 0x08: INSTR_EE_JIT_ONLY(pmfhi, RD); break;
+            case 0x09: INSTR_EE_JIT_ONLY(pmflo, RD); break;
+            case 0x0A: INSTR_EE_JIT_ONLY(pinth, RS, RT, RD); break;
+            case 0x0C: INSTR_EE_JIT_ONLY(pmultw, RS, RT, RD); break;
+            case 0x0D: INSTR_EE_JIT_ONLY(pdivw, RS, RT); break;
+            case 0x0E: INSTR_EE_JIT_ONLY(pcpyld, RS, RT, RD); break;
+            case 0x10: INSTR_EE_JIT_ONLY(pmaddh, RS, RT, RD); break;
+            case 0x11: INSTR_EE_JIT_ONLY(phmadh, RS, RT, RD); break;
+            case 0x12: INSTR_EE_JIT_ONLY(pand, RS, RT, RD); break;
+            case 0x13: INSTR_EE_JIT_ONLY(pxor, RS, RT, RD); break;
+            case 0x14: INSTR_EE_JIT_ONLY(pmsubh, RS, RT, RD); break;
+            case 0x15: INSTR_EE_JIT_ONLY(phmsbh, RS, RT, RD); break;
+            case 0x1A: INSTR_EE_JIT_ONLY(pexeh, RT, RD); break;
+            case 0x1B: INSTR_EE_JIT_ONLY(prevh, RT, RD); break;
+            case 0x1C: INSTR_EE_JIT_ONLY(pmulth, RS, RT, RD); break;
+            case 0x1D: INSTR_EE_JIT_ONLY(pdivbw, RS, RT); break;
+            case 0x1E: INSTR_EE_JIT_ONLY(pexew, RT, RD); break;
+            case 0x1F: INSTR_EE_JIT_ONLY(prot3w, RT, RD); break;
             default:   reserved_instruction<cpu, make_string>(instr);
             }
         };
 
         auto mmi3 = [](u32 instr) {
             switch (instr >> 6 & 31) {
-            case 0x00: INSTR_EE(pmadduw, RS, RT, RD); break;
-            case 0x03: INSTR_EE(psravw, RS, RT, RD); break;
-            case 0x08: INSTR_EE(pmthi, RS); break;
-            case 0x09: INSTR_EE(pmtlo, RS); break;
-            case 0x0A: INSTR_EE(pinteh, RS, RT, RD); break;
-            case 0x0C: INSTR_EE(pmultuw, RS, RT, RD); break;
-            case 0x0D: INSTR_EE(pdivuw, RS, RT); break;
-            case 0x0E: INSTR_EE(pcpyud, RS, RT, RD); break;
-            case 0x12: INSTR_EE(por, RS, RT, RD); break;
-            case 0x13: INSTR_EE(pnor, RS, RT, RD); break;
-            case 0x1A: INSTR_EE(pexch, RT, RD); break;
-            case 0x1B: INSTR_EE(pcpyh, RT, RD); break;
-            case 0x1E: INSTR_EE(pexcw, RT, RD); break;
+            case 0x00: INSTR_EE_JIT_ONLY(pmadduw, RS, RT, RD); break;
+            case 0x03: INSTR_EE_JIT_ONLY(psravw, RS, RT, RD); break;
+            case 0x08: INSTR_EE_JIT_ONLY(pmthi, RS); break;
+            case 0x09: INSTR_EE_JIT_ONLY(pmtlo, RS); break;
+            case 0x0A: INSTR_EE_JIT_ONLY(pinteh, RS, RT, RD); break;
+            case 0x0C: INSTR_EE_JIT_ONLY(pmultuw, RS, RT, RD); break;
+            case 0x0D: INSTR_EE_JIT_ONLY(pdivuw, RS, RT); break;
+            case 0x0E: INSTR_EE_JIT_ONLY(pcpyud, RS, RT, RD); break;
+            case 0x12: INSTR_EE_JIT_ONLY(por, RS, RT, RD); break;
+            case 0x13: INSTR_EE_JIT_ONLY(pnor, RS, RT, RD); break;
+            case 0x1A: INSTR_EE_JIT_ONLY(pexch, RT, RD); break;
+            case 0x1B: INSTR_EE_JIT_ONLY(pcpyh, RT, RD); break;
+            case 0x1E: INSTR_EE_JIT_ONLY(pexcw, RT, RD); break;
             default:   reserved_instruction<cpu, make_string>(instr);
             }
         };
 
         switch (instr & 63) {
-        case 0x00: INSTR_EE(madd, RS, RT, RD); break;
-        case 0x01: INSTR_EE(maddu, RS, RT, RD); break;
-        case 0x04: INSTR_EE(plzcw, RS, RD); break;
+        case 0x00: INSTR_EE_JIT_ONLY(madd, RS, RT, RD); break;
+        case 0x01: INSTR_EE_JIT_ONLY(maddu, RS, RT, RD); break;
+        case 0x04: INSTR_EE_JIT_ONLY(plzcw, RS, RD); break;
         case 0x08: mmi0(instr); break;
         case 0x09: mmi2(instr); break;
-        case 0x10: INSTR_EE(mfhi1, RD); break;
-        case 0x11: INSTR_EE(mthi1, RS); break;
-        case 0x12: INSTR_EE(mflo1, RD); break;
-        case 0x13: INSTR_EE(mtlo1, RS); break;
-        case 0x18: INSTR_EE(mult1, RS, RT, RD); break;
-        case 0x19: INSTR_EE(multu1, RS, RT, RD); break;
-        case 0x1A: INSTR_EE(div1, RS, RT); break;
-        case 0x1B: INSTR_EE(divu1, RS, RT); break;
-        case 0x20: INSTR_EE(madd1, RS, RT, RD); break;
-        case 0x21: INSTR_EE(maddu1, RS, RT, RD); break;
+        case 0x10: INSTR_EE_JIT_ONLY(mfhi1, RD); break;
+        case 0x11: INSTR_EE_JIT_ONLY(mthi1, RS); break;
+        case 0x12: INSTR_EE_JIT_ONLY(mflo1, RD); break;
+        case 0x13: INSTR_EE_JIT_ONLY(mtlo1, RS); break;
+        case 0x18: INSTR_EE_JIT_ONLY(mult1, RS, RT, RD); break;
+        case 0x19: INSTR_EE_JIT_ONLY(multu1, RS, RT, RD); break;
+        case 0x1A: INSTR_EE_JIT_ONLY(div1, RS, RT); break;
+        case 0x1B: INSTR_EE_JIT_ONLY(divu1, RS, RT); break;
+        case 0x20: INSTR_EE_JIT_ONLY(madd1, RS, RT, RD); break;
+        case 0x21: INSTR_EE_JIT_ONLY(maddu1, RS, RT, RD); break;
         case 0x28: mmi1(instr); break;
         case 0x29: mmi3(instr); break;
-        case 0x30: INSTR_EE(pmfhl, RD, FMT); break;
-        case 0x31: INSTR_EE(pmthl, RS, FMT); break;
-        case 0x34: INSTR_EE(psllh, RT, RD, SA); break;
-        case 0x36: INSTR_EE(psrlh, RT, RD, SA); break;
-        case 0x37: INSTR_EE(psrah, RT, RD, SA); break;
-        case 0x3C: INSTR_EE(psllw, RT, RD, SA); break;
-        case 0x3E: INSTR_EE(psrlw, RT, RD, SA); break;
-        case 0x3F: INSTR_EE(psraw, RT, RD, SA); break;
+        case 0x30: INSTR_EE_JIT_ONLY(pmfhl, RD, FMT); break;
+        case 0x31: INSTR_EE_JIT_ONLY(pmthl, RS, FMT); break;
+        case 0x34: INSTR_EE_JIT_ONLY(psllh, RT, RD, SA); break;
+        case 0x36: INSTR_EE_JIT_ONLY(psrlh, RT, RD, SA); break;
+        case 0x37: INSTR_EE_JIT_ONLY(psrah, RT, RD, SA); break;
+        case 0x3C: INSTR_EE_JIT_ONLY(psllw, RT, RD, SA); break;
+        case 0x3E: INSTR_EE_JIT_ONLY(psrlw, RT, RD, SA); break;
+        case 0x3F: INSTR_EE_JIT_ONLY(psraw, RT, RD, SA); break;
         default:   reserved_instruction<cpu, make_string>(instr);
         }
     }
@@ -561,7 +578,7 @@ template<Cpu cpu, bool make_string> void reserved_instruction(auto instr)
 {
     if constexpr (make_string) {
         (void)instr;
-    } else if constexpr (cpu == Cpu::EE) {
+    } else if constexpr (cpu == Cpu::EE || cpu == Cpu::EEInterpreter) {
         ee::reserved_instruction_exception();
     } else {
         iop::reserved_instruction_exception();
@@ -48,6 +48,8 @@ constexpr std::string_view gpr_index_to_name(u32 idx)
 }
 
 void decode_ee(u32 instr);
+// Executes an EE instruction directly, rather than emitting code for it
+void decode_ee_interpreter(u32 instr);
 void decode_iop(u32 instr);
 std::string disassemble(u32 instr);
 
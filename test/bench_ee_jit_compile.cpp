@@ -0,0 +1,134 @@
+// Measures how fast the EE JIT compiles blocks, in blocks per second and host nanoseconds per guest instruction.
+// The guest program is a run of identical loops in RDRAM, compiled through kseg0 without being run, each a block of
+// loads, stores and ALU instructions that ends on a branch back to its start. BenchEeJitCompileCompilerBackend is the
+// same benchmark built to emit through asmjit's Compiler (see enable_ee_jit_assembler_backend), to compare the two
+// backends. A second program of MMI loops is compiled once per MMI tier, forced whatever the host supports, which also
+// exercises the code generation of every tier.
+
+#include "build_options.hpp"
+#include "ee/ee.hpp"
+#include "ee/jit.hpp"
+#include "ee/mmi.hpp"
+#include "ee/mmu.hpp"
+#include "log.hpp"
+#include "numtypes.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <span>
+#include <string_view>
+
+namespace {
+
+constexpr u32 guest_program_vaddr = 0x8000'0000;
+constexpr u32 guest_program_size = 64 * 1024;
+constexpr u32 num_iterations = 20;
+
+constexpr u32 i_type(u32 op, u32 rs, u32 rt, u32 imm)
+{
+    return op << 26 | rs << 21 | rt << 16 | (imm & 0xFFFF);
+}
+
+constexpr u32 r_type(u32 funct, u32 rs, u32 rt, u32 rd, u32 sa = 0)
+{
+    return rs << 21 | rt << 16 | rd << 11 | sa << 6 | funct;
+}
+
+constexpr u32 mmi_type(u32 funct, u32 sa, u32 rs, u32 rt, u32 rd)
+{
+    return 0x1C << 26 | r_type(funct, rs, rt, rd, sa);
+}
+
+enum : u32 { a0 = 4, a1 = 5, t0 = 8, t1, t2, t3, t4, t5, t6, t7, s0 };
+
+constexpr std::array guest_block = {
+    i_type(0x0F, 0, s0, 0x8010), // lui s0, 0x8010
+    i_type(0x23, s0, t0, 0), // lw t0, 0(s0)
+    i_type(0x23, s0, t1, 4), // lw t1, 4(s0)
+    r_type(0x21, t0, t1, t2), // addu t2, t0, t1
+    r_type(0x00, 0, t2, t3, 2), // sll t3, t2, 2
+    i_type(0x09, t3, t4, 100), // addiu t4, t3, 100
+    r_type(0x26, t4, t0, t5), // xor t5, t4, t0
+    r_type(0x2A, t5, t1, t6), // slt t6, t5, t1
+    i_type(0x2B, s0, t5, 8), // sw t5, 8(s0)
+    r_type(0x2D, t6, t2, t7), // daddu t7, t6, t2
+    r_type(0x25, t7, t4, a0), // or a0, t7, t4
+    i_type(0x0C, a0, a1, 0xFF), // andi a1, a0, 0xFF
+    i_type(0x3F, s0, a0, 16), // sd a0, 16(s0)
+    i_type(0x09, t0, t0, 1), // addiu t0, t0, 1
+    i_type(0x05, t0, t1, u32(-15)), // bne t0, t1, <start of the block>
+    i_type(0x2B, s0, t0, 0), // sw t0, 0(s0)
+};
+
+// The MMI instructions whose code depends on the MMI tier
+constexpr std::array guest_mmi_block = {
+    i_type(0x0F, 0, s0, 0x8010), // lui s0, 0x8010
+    i_type(0x1E, s0, t0, 0), // lq t0, 0(s0)
+    i_type(0x1E, s0, t1, 16), // lq t1, 16(s0)
+    mmi_type(0x09, 0x00, t0, t1, t2), // pmaddw t2, t0, t1
+    mmi_type(0x29, 0x0C, t0, t1, t3), // pmultuw t3, t0, t1
+    mmi_type(0x09, 0x0D, t2, t3, 0), // pdivw t2, t3
+    mmi_type(0x29, 0x0D, t3, t2, 0), // pdivuw t3, t2
+    mmi_type(0x09, 0x02, t1, t2, t4), // psllvw t4, t2, t1
+    mmi_type(0x29, 0x03, t1, t3, t5), // psravw t5, t3, t1
+    mmi_type(0x08, 0x1E, 0, t4, t6), // pext5 t6, t4
+    mmi_type(0x08, 0x1F, 0, t6, t7), // ppac5 t7, t6
+    mmi_type(0x08, 0x1B, t5, t7, t4), // ppacb t4, t5, t7
+    mmi_type(0x08, 0x17, t4, t6, t5), // ppach t5, t4, t6
+    i_type(0x1F, s0, t5, 32), // sq t5, 32(s0)
+    i_type(0x05, t5, t0, u32(-15)), // bne t5, t0, <start of the block>
+    i_type(0x1F, s0, t2, 48), // sq t2, 48(s0)
+};
+
+static_assert(sizeof(guest_mmi_block) == sizeof(guest_block));
+
+constexpr u32 num_blocks = guest_program_size / sizeof(guest_block);
+
+void MeasureCompile(std::span<u32 const> guest_code, std::string_view name)
+{
+    for (u32 i = 0; i < num_blocks; ++i) {
+        std::memcpy(ee::rdram.data() + i * guest_code.size_bytes(), guest_code.data(), guest_code.size_bytes());
+    }
+
+    std::chrono::nanoseconds time{};
+    u64 blocks = 0, guest_instructions = 0;
+    for (u32 i = 0; i < num_iterations; ++i) {
+        ee::InvalidateAll();
+        auto time_begin = std::chrono::steady_clock::now();
+        for (u32 block = 0; block < num_blocks; ++block) {
+            ee::pc = guest_program_vaddr + block * u32(guest_code.size_bytes());
+            guest_instructions += ee::CompileBlockAtPc();
+        }
+        time += std::chrono::steady_clock::now() - time_begin;
+        blocks += num_blocks;
+    }
+
+    double ns = double(time.count());
+    log_info("JIT compile ({}): {} blocks, {} guest instructions, {:.0f} blocks/s, {:.1f} ns/guest instruction", name,
+      blocks, guest_instructions, double(blocks) / ns * 1e9, ns / double(guest_instructions));
+}
+
+} // namespace
+
+int main()
+{
+    ee::init();
+    Status status = ee::InitJit();
+    if (!status.Ok()) {
+        log_fatal("Failed to init EE JIT: {}", status.Message());
+        return EXIT_FAILURE;
+    }
+    log_info("JIT compile: {} backend", enable_ee_jit_assembler_backend ? "Assembler" : "Compiler");
+    MeasureCompile(guest_block, "scalar");
+    for (ee::MmiTier tier : { ee::MmiTier::Avx, ee::MmiTier::Avx2, ee::MmiTier::Avx512 }) {
+        ee::ForceMmiTier(tier);
+        MeasureCompile(guest_mmi_block, std::format("MMI, {}", ee::MmiTierName(tier)));
+    }
+    ee::ForceMmiTier(std::nullopt);
+
+    ee::TearDownJit();
+    return EXIT_SUCCESS;
+}
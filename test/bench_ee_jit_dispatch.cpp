@@ -0,0 +1,107 @@
+// Measures the per-block overhead of dispatching between EE JIT blocks.
+// The guest program is a run of NOPs in RDRAM, executed through kseg0, so that the host time is dominated by block
+// entry and exit. Compare builds with enable_ee_jit_asm_dispatcher and enable_ee_jit_block_linking toggled to see the
+// cost of each dispatch path.
+// Blocks are interpreted until they have run ee_jit_compile_threshold times, and the interpreter ends blocks at the
+// end of their pool while compiled blocks go on, so the program is run until it only enters compiled code, and the
+// blocks it enters are counted with the block profiler rather than assumed.
+
+#include "build_options.hpp"
+#include "ee/ee.hpp"
+#include "ee/jit.hpp"
+#include "ee/jit_profiler.hpp"
+#include "ee/mmu.hpp"
+#include "log.hpp"
+#include "numtypes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+namespace {
+
+constexpr u32 guest_program_vaddr = 0x8000'0000;
+constexpr u32 guest_program_size = 64 * 1024;
+constexpr u32 max_warm_up_runs = 1'000;
+constexpr u32 num_iterations = 20'000;
+
+u32 run_guest_program()
+{
+    ee::pc = guest_program_vaddr;
+    return ee::RunJit(guest_program_size / 4);
+}
+
+// Runs the program until a run of it neither interprets nor compiles a block, so that every block it enters has been
+// compiled, if by a compile worker, then installed
+bool warm_up()
+{
+    for (u32 i = 0; i < max_warm_up_runs; ++i) {
+        ee::TierStats before = ee::GetTierStats();
+        run_guest_program();
+        ee::TierStats after = ee::GetTierStats();
+        if (after.interpreted_blocks == before.interpreted_blocks && after.compiled_blocks == before.compiled_blocks) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The blocks entered by a warmed-up run of the program. Profiling recompiles every block with a prolog that counts its
+// executions, and so does turning it off again; the blocks entered do not depend on it.
+u64 count_blocks_per_run()
+{
+    ee::EnableBlockProfiling(false);
+    if (!warm_up()) {
+        return 0;
+    }
+    ee::ResetBlockProfiles();
+    run_guest_program();
+    u64 blocks = 0;
+    for (ee::BlockProfile const& profile : ee::GetBlockProfiles()) {
+        blocks += profile.executions;
+    }
+    ee::DisableBlockProfiling();
+    return blocks;
+}
+
+} // namespace
+
+int main()
+{
+    ee::init();
+    Status status = ee::InitJit();
+    if (!status.Ok()) {
+        log_fatal("Failed to init EE JIT: {}", status.Message());
+        return EXIT_FAILURE;
+    }
+    std::fill_n(ee::rdram.begin(), guest_program_size, u8(0)); // sll r0, r0, 0
+
+    u64 blocks_per_run = count_blocks_per_run();
+    if (blocks_per_run == 0 || !warm_up()) {
+        log_fatal("The guest program still runs in the interpreter after {} runs", max_warm_up_runs);
+        return EXIT_FAILURE;
+    }
+
+    ee::TierStats stats_begin = ee::GetTierStats();
+    auto time_begin = std::chrono::steady_clock::now();
+    u64 guest_cycles = 0;
+    for (u32 i = 0; i < num_iterations; ++i) {
+        guest_cycles += run_guest_program();
+    }
+    auto time_end = std::chrono::steady_clock::now();
+    ee::TierStats stats_end = ee::GetTierStats();
+    if (stats_end.interpreted_blocks != stats_begin.interpreted_blocks
+        || stats_end.compiled_blocks != stats_begin.compiled_blocks) {
+        log_warn("JIT dispatch: blocks were interpreted or compiled while measuring");
+    }
+
+    double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_begin).count());
+    double blocks = double(blocks_per_run) * num_iterations;
+    log_info("JIT dispatch: asm dispatcher {}, block linking {}", enable_ee_jit_asm_dispatcher ? "on" : "off",
+      enable_ee_jit_block_linking ? "on" : "off");
+    log_info("JIT dispatch: {} blocks per run, {} blocks, {} guest cycles, {:.2f} ns/block", blocks_per_run,
+      u64(blocks), guest_cycles, ns / blocks);
+
+    ee::TearDownJit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "ee/cop1.hpp"
+#include "ee/ee.hpp"
+#include "ee/jit.hpp"
+#include "ee/mmu.hpp"
+#include "numtypes.hpp"
+
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+using namespace ee;
+
+namespace {
+
+constexpr u32 guest_program_vaddr = 0x8001'0000;
+
+constexpr u32 fpu_type(u32 funct, u32 ft, u32 fs, u32 fd)
+{
+    return 0x11 << 26 | 0x10 << 21 | ft << 16 | fs << 11 | fd << 6 | funct; // COP1, fmt S
+}
+
+enum : u32 { fs = 1, ft = 2, fd = 3 };
+enum : u32 { add_s_funct = 0x00, mul_s_funct = 0x02 };
+
+constexpr u32 f32_max = 0x7F7F'FFFF;
+constexpr u32 f32_min_normal = 0x0080'0000;
+constexpr u32 f32_half = 0x3F00'0000;
+constexpr u32 host_inf = 0x7F80'0000;
+constexpr u32 sign = 0x8000'0000;
+
+struct ClampCase {
+    std::string_view name;
+    u32 funct;
+    u32 fs_bits, ft_bits;
+    std::array<u32, 3> fd_bits; // per FpuClampMode
+};
+
+constexpr std::array clamp_cases = {
+    // Overflows to an Infinity on the host; the PS2 has none, and saturates at the largest magnitude
+    ClampCase{ "add overflow", add_s_funct, f32_max, f32_max, { host_inf, f32_max, f32_max } },
+    ClampCase{ "negative add overflow", add_s_funct, sign | f32_max, sign | f32_max,
+      { sign | host_inf, sign | f32_max, sign | f32_max } },
+    ClampCase{ "mul overflow", mul_s_funct, f32_max, f32_max, { host_inf, f32_max, f32_max } },
+    ClampCase{ "negative mul overflow", mul_s_funct, sign | f32_max, f32_max,
+      { sign | host_inf, sign | f32_max, sign | f32_max } },
+    // An operand with an exponent of 255 is a NaN on the host, but a number beyond the host's range on the PS2;
+    // clamped first, it cancels out
+    ClampCase{ "add of exponent 255", add_s_funct, 0x7FFF'FFFF, sign | f32_max, { 0x7FFF'FFFF, f32_max, 0 } },
+    // Underflows to a denormal on the host, which the PS2 flushes to zero, keeping the sign
+    ClampCase{ "mul underflow", mul_s_funct, sign | f32_min_normal, f32_half, { sign | 0x0040'0000, sign, sign } },
+};
+
+class EeCop1 : public testing::Test {
+protected:
+    static void SetUpTestSuite()
+    {
+        ee::init();
+        ASSERT_TRUE(InitJit().Ok());
+    }
+
+    static void TearDownTestSuite()
+    {
+        TearDownJit();
+    }
+
+    void SetUp() override
+    {
+        clamp_mode = GetFpuClampMode();
+    }
+
+    void TearDown() override
+    {
+        SetFpuClampMode(clamp_mode);
+    }
+
+    // Runs the instruction in a block of its own, which ends on a branch to itself. The block is compiled on this
+    // thread, rather than interpreted until a compile worker is done with it.
+    static u32 Run(ClampCase const& test, FpuClampMode mode)
+    {
+        std::array<u32, 3> program = {
+            fpu_type(test.funct, ft, fs, fd),
+            0x1000'FFFF, // beq zero, zero, <this instruction>
+            0, // nop
+        };
+        std::memcpy(rdram.data() + (guest_program_vaddr & 0x1FFF'FFFF), program.data(), sizeof(program));
+        SetFpuClampMode(mode);
+        InvalidateAll();
+        fpr = {};
+        fpr[fs] = test.fs_bits;
+        fpr[ft] = test.ft_bits;
+        pc = guest_program_vaddr;
+        EXPECT_EQ(CompileBlockAtPc(), program.size());
+        pc = guest_program_vaddr;
+        RunJit(1);
+        return fpr[fd];
+    }
+
+    FpuClampMode clamp_mode;
+};
+
+TEST_F(EeCop1, ResultsFollowTheClampMode)
+{
+    for (ClampCase const& test : clamp_cases) {
+        SCOPED_TRACE(test.name);
+        for (FpuClampMode mode : { FpuClampMode::None, FpuClampMode::Results, FpuClampMode::Full }) {
+            SCOPED_TRACE(FpuClampModeName(mode));
+            EXPECT_EQ(Run(test, mode), test.fd_bits[std::to_underlying(mode)]);
+        }
+    }
+}
+
+} // namespace
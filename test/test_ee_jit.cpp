@@ -0,0 +1,172 @@
+#include "ee/cop0.hpp"
+#include "ee/ee.hpp"
+#include "ee/jit.hpp"
+#include "ee/mmu.hpp"
+#include "numtypes.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <span>
+
+using namespace ee;
+
+namespace {
+
+constexpr u32 guest_program_vaddr = 0x8001'0000;
+// Far enough from the blocks that no block follows a jump to it into a superblock
+constexpr u32 guest_exit_vaddr = 0x8004'0000;
+
+constexpr u32 i_type(u32 op, u32 rs, u32 rt, u32 imm)
+{
+    return op << 26 | rs << 21 | rt << 16 | (imm & 0xFFFF);
+}
+
+constexpr u32 r_type(u32 funct, u32 rs, u32 rt, u32 rd)
+{
+    return rs << 21 | rt << 16 | rd << 11 | funct;
+}
+
+constexpr u32 j_type(u32 op, u32 target)
+{
+    return op << 26 | (target >> 2 & 0x3FF'FFFF);
+}
+
+enum : u32 { zero = 0, v0 = 2, v1, t0 = 8, t1, t2, t3, ra = 31 };
+
+class EeJit : public testing::Test {
+protected:
+    static void SetUpTestSuite()
+    {
+        ee::init();
+        ASSERT_TRUE(InitJit().Ok());
+    }
+
+    static void TearDownTestSuite()
+    {
+        TearDownJit();
+    }
+
+    void SetUp() override
+    {
+        InvalidateAll();
+        InvalidateReturnStack();
+        gpr = {};
+        lo = {};
+        hi = {};
+    }
+
+    // Writing to a page of RDRAM invalidates the blocks compiled from it, so every program goes in before the first
+    // block is compiled
+    static void WriteProgram(u32 vaddr, std::span<u32 const> program)
+    {
+        std::memcpy(rdram.data() + (vaddr & 0x1FFF'FFFF), program.data(), program.size_bytes());
+    }
+
+    // Compiles the block at vaddr on this thread, rather than interpreting it until a compile worker is done with it
+    static void CompileBlock(u32 vaddr, u32 num_instructions)
+    {
+        pc = vaddr;
+        ASSERT_EQ(CompileBlockAtPc(), num_instructions);
+    }
+};
+
+// Blocks address the guest state relative to the middle of gpr, where the dispatcher and block prologs point
+// guest_gpr_base_ptr_reg
+TEST_F(EeJit, GuestStateOffsetsAreRelativeToTheMiddleOfGpr)
+{
+    u8 const* base = reinterpret_cast<u8 const*>(gpr.data() + gpr.size() / 2);
+    EXPECT_EQ(get_offset_to_guest_gpr_base_ptr(&gpr[16]), 0);
+    EXPECT_EQ(get_offset_to_guest_gpr_base_ptr(&gpr[0]), -256);
+    EXPECT_EQ(base + get_offset_to_guest_gpr_base_ptr(&pc), reinterpret_cast<u8 const*>(&pc));
+    EXPECT_EQ(base + get_offset_to_guest_gpr_base_ptr(&cycle_counter), reinterpret_cast<u8 const*>(&cycle_counter));
+}
+
+TEST_F(EeJit, BlockUpdatesPcAndCycleCounter)
+{
+    constexpr u32 program[] = {
+        i_type(0x09, zero, t0, 5), // addiu t0, zero, 5
+        i_type(0x09, t0, t1, 7), // addiu t1, t0, 7
+        j_type(0x02, guest_exit_vaddr), // j <exit>
+        0, // nop
+    };
+    WriteProgram(guest_program_vaddr, program);
+    CompileBlock(guest_program_vaddr, 4);
+    u32 count = cop0.count;
+    pc = guest_program_vaddr;
+    EXPECT_EQ(RunJit(1), 4u); // the block runs to its end, whatever its cycles
+    EXPECT_EQ(cycle_counter, 4u);
+    EXPECT_EQ(cop0.count, count + 4);
+    EXPECT_EQ(pc, guest_exit_vaddr);
+    EXPECT_EQ(u64(gpr[t0]), 5u);
+    EXPECT_EQ(u64(gpr[t1]), 12u);
+}
+
+// LO and HI are written back at the end of a block, and loaded again by the next
+TEST_F(EeJit, MultResultRoundTripsThroughLoAndHi)
+{
+    constexpr u32 move_vaddr = 0x8002'0000;
+    constexpr u32 multiply[] = {
+        i_type(0x09, zero, t0, u32(-3)), // addiu t0, zero, -3
+        i_type(0x09, zero, t1, 7), // addiu t1, zero, 7
+        r_type(0x18, t0, t1, zero), // mult t0, t1
+        j_type(0x02, move_vaddr), // j <move_vaddr>
+        0, // nop
+    };
+    constexpr u32 move_from_lo_hi[] = {
+        r_type(0x12, zero, zero, t2), // mflo t2
+        r_type(0x10, zero, zero, t3), // mfhi t3
+        j_type(0x02, guest_exit_vaddr), // j <exit>
+        0, // nop
+    };
+    WriteProgram(guest_program_vaddr, multiply);
+    WriteProgram(move_vaddr, move_from_lo_hi);
+    CompileBlock(guest_program_vaddr, 5);
+    CompileBlock(move_vaddr, 4);
+    lo = u128(0x1111) << 64; // LO1 and HI1, which MULT leaves alone
+    hi = u128(0x2222) << 64;
+    pc = guest_program_vaddr;
+    RunJit(6);
+    EXPECT_EQ(pc, guest_exit_vaddr);
+    EXPECT_EQ(u64(lo), u64(-21));
+    EXPECT_EQ(u64(hi), ~0_u64);
+    EXPECT_EQ(u64(lo >> 64), 0x1111u);
+    EXPECT_EQ(u64(hi >> 64), 0x2222u);
+    EXPECT_EQ(u64(gpr[t2]), u64(-21));
+    EXPECT_EQ(u64(gpr[t3]), ~0_u64);
+}
+
+// The call pushes its return address onto the return stack, and the return jumps from there straight into the block
+// after the call
+TEST_F(EeJit, ReturnGoesThroughTheReturnStack)
+{
+    constexpr u32 function_vaddr = 0x8002'0000;
+    constexpr u32 return_vaddr = guest_program_vaddr + 8;
+    constexpr u32 caller[] = {
+        j_type(0x03, function_vaddr), // jal <function_vaddr>
+        0, // nop
+        i_type(0x09, v0, v1, 1), // addiu v1, v0, 1
+        j_type(0x02, guest_exit_vaddr), // j <exit>
+        0, // nop
+    };
+    constexpr u32 function[] = {
+        i_type(0x09, zero, v0, 42), // addiu v0, zero, 42
+        r_type(0x08, ra, zero, zero), // jr ra
+        0, // nop
+    };
+    WriteProgram(guest_program_vaddr, caller);
+    WriteProgram(function_vaddr, function);
+    CompileBlock(guest_program_vaddr, 2);
+    CompileBlock(function_vaddr, 3);
+    CompileBlock(return_vaddr, 3);
+    TierStats stats = GetTierStats();
+    pc = guest_program_vaddr;
+    RunJit(6);
+    EXPECT_EQ(pc, guest_exit_vaddr);
+    EXPECT_EQ(u64(gpr[ra]), return_vaddr);
+    EXPECT_EQ(u64(gpr[v0]), 42u);
+    EXPECT_EQ(u64(gpr[v1]), 43u);
+    EXPECT_EQ(GetTierStats().interpreted_blocks, stats.interpreted_blocks);
+}
+
+} // namespace
@@ -0,0 +1,149 @@
+#include "ee/ee.hpp"
+#include "ee/jit.hpp"
+#include "ee/mmi.hpp"
+#include "ee/mmu.hpp"
+#include "numtypes.hpp"
+
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstring>
+#include <optional>
+
+using namespace ee;
+
+namespace {
+
+constexpr u32 guest_program_vaddr = 0x8001'0000;
+
+constexpr u32 i_type(u32 op, u32 rs, u32 rt, u32 imm)
+{
+    return op << 26 | rs << 21 | rt << 16 | (imm & 0xFFFF);
+}
+
+constexpr u32 r_type(u32 funct, u32 rs, u32 rt, u32 rd, u32 sa = 0)
+{
+    return rs << 21 | rt << 16 | rd << 11 | sa << 6 | funct;
+}
+
+constexpr u32 mmi_type(u32 funct, u32 sa, u32 rs, u32 rt, u32 rd)
+{
+    return 0x1C << 26 | r_type(funct, rs, rt, rd, sa);
+}
+
+enum : u32 { a0 = 4, a1, t0 = 8, t1, t2, t3, t4, t5, t6, t7 };
+
+// The MMI instructions whose code depends on the MMI tier, as in the compile benchmark, in one block that ends on a
+// branch to itself
+constexpr std::array guest_mmi_block = {
+    mmi_type(0x09, 0x00, t0, t1, t2), // pmaddw t2, t0, t1
+    mmi_type(0x29, 0x0C, t0, t1, t3), // pmultuw t3, t0, t1
+    mmi_type(0x09, 0x0D, t2, t3, 0), // pdivw t2, t3
+    mmi_type(0x09, 0x08, 0, 0, a0), // pmfhi a0
+    mmi_type(0x09, 0x09, 0, 0, a1), // pmflo a1
+    mmi_type(0x29, 0x0D, t3, t2, 0), // pdivuw t3, t2
+    mmi_type(0x09, 0x02, t1, t2, t4), // psllvw t4, t2, t1
+    mmi_type(0x29, 0x03, t1, t3, t5), // psravw t5, t3, t1
+    mmi_type(0x08, 0x1E, 0, t4, t6), // pext5 t6, t4
+    mmi_type(0x08, 0x1F, 0, t6, t7), // ppac5 t7, t6
+    mmi_type(0x08, 0x1B, t5, t7, t4), // ppacb t4, t5, t7
+    mmi_type(0x08, 0x17, t4, t6, t5), // ppach t5, t4, t6
+    i_type(0x04, 0, 0, u32(-1)), // beq zero, zero, <this instruction>
+    r_type(0x00, 0, 0, 0), // nop
+};
+
+// Operands with the sign bits, extremes and shift amounts past 31 that the code of the tiers handles differently
+constexpr std::array<u32, 4> t0_words = { 0x8000'0000, 0xFFFF'FFFF, 0x1234'5678, 0x7FFF'FFFF };
+constexpr std::array<u32, 4> t1_words = { 0xFFFF'FFFF, 0x8000'0000, 0x0000'0023, 0xFFFF'FFF0 };
+constexpr std::array<u32, 4> lo_words = { 0x0000'0001, 0x8765'4321, 0xFFFF'FFFF, 0x0000'0000 };
+constexpr std::array<u32, 4> hi_words = { 0x7FFF'FFFF, 0x0000'0000, 0x8000'0000, 0xDEAD'BEEF };
+
+struct ExpectedRegister {
+    char const* name;
+    u128 const& value;
+    std::array<u32, 4> words;
+};
+
+// Worked out from the definitions of the instructions, independently of the code of any tier
+std::array const expected_registers = {
+    ExpectedRegister{ "t0", gpr[t0], t0_words },
+    ExpectedRegister{ "t1", gpr[t1], t1_words },
+    ExpectedRegister{ "t2", gpr[t2], { 0x8000'0001, 0x7FFF'FFFF, 0x7D27'D267, 0x8000'0003 } },
+    ExpectedRegister{ "t3", gpr[t3], { 0x8000'0000, 0x7FFF'FFFF, 0x7D27'D268, 0x0000'0002 } },
+    ExpectedRegister{ "t4", gpr[t4], { 0x00FF'0000, 0x00FF'0038, 0xFFFF'FFFF, 0x0000'A44D } },
+    ExpectedRegister{ "t5", gpr[t5], { 0xF8F8'0000, 0xF8F8'C8C0, 0x0038'0000, 0xA44D'FFFF } },
+    ExpectedRegister{ "t6", gpr[t6], { 0x0000'0000, 0x80F8'F8F8, 0x8020'C8C0, 0x80F8'F8F8 } },
+    ExpectedRegister{ "t7", gpr[t7], { 0x0000'0000, 0x0000'FFFF, 0x0000'9338, 0x0000'FFFF } },
+    ExpectedRegister{ "a0, HI of pdivw", gpr[a0], { 0x8000'0001, 0xFFFF'FFFF, 0x7D27'D267, 0x0000'0000 } },
+    ExpectedRegister{ "a1, LO of pdivw", gpr[a1], { 0x0000'0000, 0x0000'0000, 0x0000'0000, 0x0000'0000 } },
+    ExpectedRegister{ "lo", lo, { 0x0000'0000, 0x0000'0000, 0x0000'0001, 0x0000'0000 } },
+    ExpectedRegister{ "hi", hi, { 0x8000'0000, 0xFFFF'FFFF, 0x0000'0001, 0x0000'0000 } },
+};
+
+u128 Words(std::array<u32, 4> const& words)
+{
+    u128 value;
+    std::memcpy(&value, words.data(), sizeof(value));
+    return value;
+}
+
+std::array<u32, 4> Words(u128 value)
+{
+    std::array<u32, 4> words;
+    std::memcpy(words.data(), &value, sizeof(value));
+    return words;
+}
+
+class EeMmi : public testing::Test {
+protected:
+    static void SetUpTestSuite()
+    {
+        ee::init();
+        ASSERT_TRUE(InitJit().Ok());
+        std::memcpy(rdram.data() + (guest_program_vaddr & 0x1FFF'FFFF), guest_mmi_block.data(),
+          sizeof(guest_mmi_block));
+    }
+
+    static void TearDownTestSuite()
+    {
+        ForceMmiTier(std::nullopt);
+        TearDownJit();
+    }
+
+    // Compiles the block on this thread, rather than interpreting it until a compile worker is done with it, and runs
+    // it once
+    static void RunBlock(MmiTier tier)
+    {
+        ForceMmiTier(tier);
+        InvalidateAll();
+        gpr = {};
+        gpr[t0] = Words(t0_words);
+        gpr[t1] = Words(t1_words);
+        lo = Words(lo_words);
+        hi = Words(hi_words);
+        pc = guest_program_vaddr;
+        ASSERT_EQ(CompileBlockAtPc(), guest_mmi_block.size());
+        pc = guest_program_vaddr;
+        RunJit(1); // the block runs to its end, whatever its cycles
+    }
+};
+
+TEST_F(EeMmi, EveryTierComputesTheExpectedValues)
+{
+    ForceMmiTier(std::nullopt);
+    MmiTier host_tier = GetMmiTier();
+    for (MmiTier tier : { MmiTier::Avx, MmiTier::Avx2, MmiTier::Avx512 }) {
+        if (tier > host_tier) {
+            continue;
+        }
+        SCOPED_TRACE(MmiTierName(tier));
+        RunBlock(tier);
+        EXPECT_EQ(pc, guest_program_vaddr + 4 * (guest_mmi_block.size() - 2));
+        for (ExpectedRegister const& reg : expected_registers) {
+            SCOPED_TRACE(reg.name);
+            EXPECT_EQ(Words(reg.value), reg.words);
+        }
+    }
+}
+
+} // namespace
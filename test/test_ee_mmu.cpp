@@ -0,0 +1,314 @@
+#include "ee/cop0.hpp"
+#include "ee/ee.hpp"
+#include "ee/exceptions.hpp"
+#include "ee/mmu.hpp"
+#include "numtypes.hpp"
+
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstring>
+#include <optional>
+
+using namespace ee;
+
+namespace {
+
+constexpr u32 tlb_mod_exc_code = 1;
+constexpr u32 tlb_load_exc_code = 2;
+constexpr u32 tlb_store_exc_code = 3;
+constexpr u32 refill_vector = 0x8000'0000; // with BEV and EXL clear
+constexpr u32 common_vector = 0x8000'0180;
+
+// An even/odd pair of 4 KiB pages in kuseg, and the physical pages that the tests map them to
+constexpr u32 vpage_pair = 0x0040'0000;
+constexpr u32 other_vpage_pair = 0x0060'0000;
+constexpr std::array<u32, 4> ppage = { 0x0010'0000, 0x0020'0000, 0x0030'0000, 0x0040'0000 };
+
+// A page of the IO register range that no device maps yet, and so only the catch-all word handlers of the range
+constexpr u32 io_test_paddr = 0x1000'8000;
+constexpr u32 unmapped_paddr = 0x1400'0000;
+constexpr u32 kseg1 = 0xA000'0000;
+
+// Of the last call to the IO handlers of the test
+u32 io_paddr;
+u32 io_width;
+u64 io_data;
+
+template<typename Int> Int ReadTestIo(u32 paddr)
+{
+    io_paddr = paddr;
+    io_width = sizeof(Int);
+    return Int(0x0123'4567'89AB'CDEF);
+}
+
+template<typename Int> void WriteTestIo(u32 paddr, Int data)
+{
+    io_paddr = paddr;
+    io_width = sizeof(Int);
+    io_data = u64(data);
+}
+
+// Every width but 128 bits
+constexpr IoHandlers test_io_handlers = {
+    .read8 = ReadTestIo<u8>,
+    .read16 = ReadTestIo<u16>,
+    .read32 = ReadTestIo<u32>,
+    .read64 = ReadTestIo<u64>,
+    .read128 = nullptr,
+    .write8 = WriteTestIo<u8>,
+    .write16 = WriteTestIo<u16>,
+    .write32 = WriteTestIo<u32>,
+    .write64 = WriteTestIo<u64>,
+    .write128 = nullptr,
+};
+
+// EntryLo bits
+constexpr u32 lo_g = 1;
+constexpr u32 lo_v = 2;
+constexpr u32 lo_d = 4;
+constexpr u32 lo_vd = lo_v | lo_d;
+
+class EeMmu : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        cop0.status.raw = 0;
+        tlb_entries = {};
+        exception_occurred = false;
+        init_memory_map();
+        rebuild_vtlb();
+        for (u32 i = 0; i < ppage.size(); ++i) {
+            StorePhysical(ppage[i], 0x1111'1111 * (i + 1));
+            StorePhysical(ppage[i] + 0x1000, 0x1111'1111 * (i + 1) + 1);
+        }
+    }
+
+    static void StorePhysical(u32 paddr, u32 value) { std::memcpy(&rdram[paddr], &value, 4); }
+
+    static u32 LoadPhysical(u32 paddr)
+    {
+        u32 value;
+        std::memcpy(&value, &rdram[paddr], 4);
+        return value;
+    }
+
+    // As the MTC0 to EntryHi that selects the ASID
+    static void SetAsid(u8 asid)
+    {
+        cop0.entry_hi.asid = asid;
+        cop0.on_write_to_entry_hi();
+    }
+
+    // As the MTC0s to EntryLo0, EntryLo1 and EntryHi, and the TLBWI, that a guest writes a 4 KiB entry with. The entry
+    // is global if both flags have G set.
+    static void WriteTlbEntry(u32 index, u32 vaddr, u8 asid, u32 even_paddr, u32 odd_paddr, u32 even_flags = lo_vd,
+      u32 odd_flags = lo_vd)
+    {
+        cop0.entry_lo[0].raw = even_paddr >> 12 << 6 | even_flags;
+        cop0.entry_lo[1].raw = odd_paddr >> 12 << 6 | odd_flags;
+        cop0.page_mask = 0;
+        cop0.entry_hi.raw = vaddr & ~0x1FFF;
+        SetAsid(asid);
+        tlb_entries[index].write();
+    }
+
+    // As an OS does at boot: every entry valid, away from the pages that the tests use
+    static void FillTlb()
+    {
+        for (u32 i = 0; i < tlb_entries.size(); ++i) {
+            WriteTlbEntry(i, 0x0100'0000 + i * 0x2000, 0, ppage[3], ppage[3]);
+        }
+    }
+
+    // The word at vaddr, or nullopt if reading it raised an exception
+    static std::optional<u32> Load(u32 vaddr)
+    {
+        exception_occurred = false;
+        cop0.status.exl = 0;
+        u32 value = virtual_read<u32>(vaddr);
+        return exception_occurred ? std::nullopt : std::optional{ value };
+    }
+
+    // Whether storing to vaddr succeeded, rather than raising an exception
+    static bool Store(u32 vaddr, u32 value)
+    {
+        exception_occurred = false;
+        cop0.status.exl = 0;
+        virtual_write(vaddr, value);
+        return !exception_occurred;
+    }
+};
+
+} // namespace
+
+TEST_F(EeMmu, UnwrittenTlbEntriesAreInvalid)
+{
+    EXPECT_EQ(Load(vpage_pair), std::nullopt);
+    EXPECT_EQ(cop0.cause.exc_code, tlb_load_exc_code);
+    EXPECT_EQ(pc, common_vector);
+}
+
+TEST_F(EeMmu, EntryTranslatesBothPagesOfItsPair)
+{
+    WriteTlbEntry(0, vpage_pair, 0, ppage[0], ppage[1]);
+    EXPECT_EQ(Load(vpage_pair + 0x10), LoadPhysical(ppage[0] + 0x10));
+    EXPECT_EQ(Load(vpage_pair + 0x1000), LoadPhysical(ppage[1]));
+    EXPECT_EQ(Load(other_vpage_pair), std::nullopt);
+}
+
+TEST_F(EeMmu, EntryOverwrittenWithHigherPrecedence)
+{
+    FillTlb();
+    WriteTlbEntry(5, vpage_pair, 0, ppage[0], ppage[0]);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[0]));
+
+    // An earlier entry that matches takes over the pages
+    WriteTlbEntry(2, vpage_pair, 0, ppage[1], ppage[1]);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[1]));
+
+    // Moved elsewhere, it hands them back to the later entry
+    WriteTlbEntry(2, other_vpage_pair, 0, ppage[2], ppage[2]);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[0]));
+    EXPECT_EQ(Load(other_vpage_pair), LoadPhysical(ppage[2]));
+}
+
+TEST_F(EeMmu, EntryOverwrittenWithLowerPrecedence)
+{
+    FillTlb();
+    WriteTlbEntry(2, vpage_pair, 0, ppage[0], ppage[0]);
+
+    // A later entry that matches too is shadowed
+    WriteTlbEntry(5, vpage_pair, 0, ppage[1], ppage[1]);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[0]));
+
+    // Until the earlier entry moves away
+    WriteTlbEntry(2, other_vpage_pair, 0, ppage[2], ppage[2]);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[1]));
+
+    // A miss, once neither matches
+    WriteTlbEntry(5, other_vpage_pair + 0x2000, 0, ppage[2], ppage[2]);
+    EXPECT_EQ(Load(vpage_pair), std::nullopt);
+    EXPECT_EQ(pc, refill_vector);
+}
+
+TEST_F(EeMmu, AsidSwitchKeepsGlobalEntries)
+{
+    FillTlb();
+    WriteTlbEntry(1, vpage_pair, 1, ppage[0], ppage[0]);
+    WriteTlbEntry(2, other_vpage_pair, 0, ppage[1], ppage[1], lo_vd | lo_g, lo_vd | lo_g);
+    WriteTlbEntry(3, vpage_pair, 2, ppage[2], ppage[2]);
+
+    SetAsid(1);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[0]));
+    EXPECT_EQ(Load(other_vpage_pair), LoadPhysical(ppage[1]));
+
+    SetAsid(2);
+    EXPECT_EQ(Load(vpage_pair), LoadPhysical(ppage[2]));
+    EXPECT_EQ(Load(other_vpage_pair), LoadPhysical(ppage[1]));
+
+    SetAsid(3);
+    EXPECT_EQ(Load(vpage_pair), std::nullopt);
+    EXPECT_EQ(pc, refill_vector);
+    EXPECT_EQ(Load(other_vpage_pair), LoadPhysical(ppage[1]));
+
+    // A full rebuild agrees with the incremental updates
+    rebuild_vtlb();
+    EXPECT_EQ(Load(vpage_pair), std::nullopt);
+    EXPECT_EQ(Load(other_vpage_pair), LoadPhysical(ppage[1]));
+}
+
+TEST_F(EeMmu, StoreToCleanPageRaisesTlbModification)
+{
+    WriteTlbEntry(0, vpage_pair, 0, ppage[0], ppage[1], lo_v, lo_d);
+    u32 original = LoadPhysical(ppage[0]);
+    EXPECT_EQ(Load(vpage_pair), original);
+
+    EXPECT_FALSE(Store(vpage_pair, 0xDEAD'BEEF));
+    EXPECT_EQ(cop0.cause.exc_code, tlb_mod_exc_code);
+    EXPECT_EQ(cop0.bad_v_addr, vpage_pair);
+    EXPECT_EQ(pc, common_vector);
+    EXPECT_EQ(LoadPhysical(ppage[0]), original);
+
+    // V clear: TLB invalid, for stores as for loads
+    EXPECT_FALSE(Store(vpage_pair + 0x1000, 0xDEAD'BEEF));
+    EXPECT_EQ(cop0.cause.exc_code, tlb_store_exc_code);
+
+    // Rewritten with D set, the page takes stores
+    WriteTlbEntry(0, vpage_pair, 0, ppage[0], ppage[1]);
+    EXPECT_TRUE(Store(vpage_pair, 0xDEAD'BEEF));
+    EXPECT_EQ(LoadPhysical(ppage[0]), 0xDEAD'BEEF);
+}
+
+TEST_F(EeMmu, BiosIsMirroredAcrossItsWindow)
+{
+    bios[0x100] = 0x5A;
+    for (u32 paddr : { 0x1FC0'0100u, 0x1C00'0100u, 0x1C40'0100u, 0x1F80'0100u }) {
+        EXPECT_EQ(virtual_read<u8>(kseg1 + paddr), 0x5A) << std::hex << paddr;
+        PhysicalMapping mapping = get_physical_mapping(paddr);
+        EXPECT_EQ(mapping.host, &bios[0x100]);
+        EXPECT_TRUE(mapping.read_only);
+    }
+    EXPECT_EQ(get_physical_mapping(0x1BFF'F000).host, nullptr); // below the window
+
+    // ROM: writes are dropped, through any mirror
+    EXPECT_TRUE(Store(kseg1 + 0x1C40'0100, 0));
+    EXPECT_EQ(bios[0x100], 0x5A);
+}
+
+TEST_F(EeMmu, IoAccessesReachTheHandlerOfTheirWidth)
+{
+    map_io(io_test_paddr, 0x1000, test_io_handlers);
+    EXPECT_EQ(virtual_read<u8>(kseg1 + io_test_paddr + 1), 0xEF);
+    EXPECT_EQ(io_width, 1u);
+    EXPECT_EQ(io_paddr, io_test_paddr + 1);
+    EXPECT_EQ(virtual_read<u16>(kseg1 + io_test_paddr + 2), 0xCDEF);
+    EXPECT_EQ(io_width, 2u);
+    EXPECT_EQ(virtual_read<u32>(kseg1 + io_test_paddr + 4), 0x89AB'CDEFu);
+    EXPECT_EQ(io_width, 4u);
+    EXPECT_EQ(virtual_read<u64>(kseg1 + io_test_paddr + 8), 0x0123'4567'89AB'CDEFu);
+    EXPECT_EQ(io_width, 8u);
+
+    virtual_write(kseg1 + io_test_paddr + 0x10, u8(0x12));
+    EXPECT_EQ(io_width, 1u);
+    EXPECT_EQ(io_data, 0x12u);
+    virtual_write(kseg1 + io_test_paddr + 0x10, u16(0x1234));
+    EXPECT_EQ(io_width, 2u);
+    virtual_write(kseg1 + io_test_paddr + 0x10, u32(0x1234'5678));
+    EXPECT_EQ(io_width, 4u);
+    EXPECT_EQ(io_data, 0x1234'5678u);
+    virtual_write(kseg1 + io_test_paddr + 0x10, u64(0x1234'5678'9ABC'DEF0));
+    EXPECT_EQ(io_width, 8u);
+    EXPECT_EQ(io_paddr, io_test_paddr + 0x10);
+    EXPECT_EQ(io_data, 0x1234'5678'9ABC'DEF0u);
+}
+
+TEST_F(EeMmu, IoPagesFallBackToEarlierMappings)
+{
+    // Mapped later, the test handlers take precedence over the catch-all word handlers, but only on their own page
+    map_io(io_test_paddr, 0x1000, test_io_handlers);
+    EXPECT_EQ(get_physical_mapping(io_test_paddr + 0xFFC).io_handlers->read8, test_io_handlers.read8);
+    IoHandlers const* catch_all = get_physical_mapping(io_test_paddr + 0x1000).io_handlers;
+    ASSERT_NE(catch_all, nullptr);
+    EXPECT_EQ(catch_all->read8, nullptr);
+    EXPECT_NE(catch_all->read32, nullptr);
+
+    io_width = 0;
+    EXPECT_EQ(virtual_read<u32>(kseg1 + io_test_paddr + 0x1000), 0u);
+    virtual_write(kseg1 + io_test_paddr + 0x1000, u32(1));
+    EXPECT_EQ(io_width, 0u);
+}
+
+TEST_F(EeMmu, UnmappedPhysicalMemoryReadsAsZero)
+{
+    PhysicalMapping mapping = get_physical_mapping(unmapped_paddr);
+    EXPECT_EQ(mapping.host, nullptr);
+    EXPECT_EQ(mapping.io_handlers, nullptr);
+    EXPECT_EQ(virtual_read<u8>(kseg1 + unmapped_paddr), 0u);
+    EXPECT_EQ(virtual_read<u16>(kseg1 + unmapped_paddr), 0u);
+    EXPECT_EQ(virtual_read<u32>(kseg1 + unmapped_paddr), 0u);
+    EXPECT_EQ(virtual_read<u64>(kseg1 + unmapped_paddr), 0u);
+    EXPECT_TRUE(virtual_read<u128>(kseg1 + unmapped_paddr) == 0);
+    EXPECT_TRUE(Store(kseg1 + unmapped_paddr, 1)); // dropped, without an exception
+    EXPECT_EQ(virtual_read<u32>(kseg1 + unmapped_paddr), 0u);
+}